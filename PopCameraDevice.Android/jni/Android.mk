@@ -80,6 +80,14 @@ LOCAL_SRC_FILES  := \
 $(LOCAL_PATH)/$(SRC)/Source/PopCameraDevice.cpp \
 $(LOCAL_PATH)/$(SRC)/Source/TestDevice.cpp \
 $(LOCAL_PATH)/$(SRC)/Source/TCameraDevice.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/PixelResize.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/PixelConvert.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/PixelCopy.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/FramePlanes.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/Trace.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/DeviceStats.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/CallbackDispatcher.cpp \
+$(LOCAL_PATH)/$(SRC)/Source/FrameQueue.cpp \
 
 # soy lib files
 LOCAL_SRC_FILES  += \
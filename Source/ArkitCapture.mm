@@ -5,6 +5,7 @@
 #include "Json11/json11.hpp"
 #include "PopCameraDevice.h"
 #include "JsonFunctions.h"
+#include "Trace.h"
 
 //  gr: make this a proper check, quickly disabling for build here
 #define ENABLE_IOS14    (__IPHONE_OS_VERSION_MAX_ALLOWED >= 140000)
@@ -1173,7 +1174,7 @@ void Arkit::TFrameDevice::PushFrame(AVDepthData* DepthData,SoyTime Timestamp,jso
 {
 	if ( !DepthData )
 		return;
-	Soy::TScopeTimerPrint Timer("PushFrame(AVDepthData",5);
+	TRACE_SCOPE("PushFrame(AVDepthData)");
 	auto DepthPixels = Avf::GetDepthPixelBuffer(DepthData);
 	
 	Avf::GetMeta( DepthData, Meta );
@@ -1186,7 +1187,7 @@ void Arkit::TFrameDevice::PushFrame(CVPixelBufferRef PixelBuffer,SoyTime Timesta
 {
 	if ( !PixelBuffer )
 		return;
-	Soy::TScopeTimerPrint Timer("PushFrame(CVPixelBufferRef",5);
+	TRACE_SCOPE("PushFrame(CVPixelBufferRef)");
 	float3x3 Transform;
 	auto DoRetain = true;
 	std::shared_ptr<AvfDecoderRenderer> Renderer;
@@ -1207,7 +1208,7 @@ void Arkit::TFrameDevice::PushFrame(CVPixelBufferRef PixelBuffer,SoyTime Timesta
 
 void Arkit::TFrameDevice::PushGeometryFrame(const TAnchorGeometry& Geometry)
 {
-	Soy::TScopeTimerPrint Timer(__PRETTY_FUNCTION__,5);
+	TRACE_SCOPE(__PRETTY_FUNCTION__);
 
 	float3x3 Transform;
 	auto StreamName = GeometryStreamName;
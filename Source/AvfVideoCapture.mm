@@ -16,6 +16,7 @@
 #include <magic_enum/include/magic_enum/magic_enum.hpp>
 #include "PopCameraDevice.h"
 #include "JsonFunctions.h"
+#include "Trace.h"
 
 
 namespace Avf
@@ -779,7 +780,7 @@ AvfMediaExtractor::AvfMediaExtractor(std::shared_ptr<Opengl::TContext>& OpenglCo
 void AvfMediaExtractor::OnSampleBuffer(CMSampleBufferRef sampleBufferRef,size_t StreamIndex,json11::Json::object& Meta,bool DoRetain)
 {
 	//	gr: I think stalling too long here can make USB bus crash (killing bluetooth, hid, audio etc)
-	Soy::TScopeTimerPrint Timer("AvfMediaExtractor::OnSampleBuffer",5);
+	TRACE_SCOPE("AvfMediaExtractor::OnSampleBuffer");
 	
 	//Soy::Assert( sampleBufferRef != nullptr, "Expected sample buffer ref");
 	if ( !sampleBufferRef )
@@ -840,7 +841,7 @@ void AvfMediaExtractor::OnSampleBuffer(CVPixelBufferRef sampleBufferRef,SoyTime
 void AvfMediaExtractor::OnDepthFrame(AVDepthData* DepthData,CMTime CmTimestamp,size_t StreamIndex,bool DoRetain)
 {
 	//	gr: I think stalling too long here can make USB bus crash (killing bluetooth, hid, audio etc)
-	Soy::TScopeTimerPrint Timer(__PRETTY_FUNCTION__,5);
+	TRACE_SCOPE(__PRETTY_FUNCTION__);
 	
 	//Soy::Assert( sampleBufferRef != nullptr, "Expected sample buffer ref");
 	if ( !DepthData )
@@ -0,0 +1,205 @@
+#include "CallbackDispatcher.h"
+#include <SoyDebug.h>
+
+
+namespace PopCameraDevice
+{
+	//	registries being called on this thread, innermost first; lives on the stack in Call()
+	class TCallingScope
+	{
+	public:
+		const TCallbackRegistry*	mRegistry = nullptr;
+		TCallingScope*				mOuter = nullptr;
+	};
+	thread_local TCallingScope*	gInnermostCallingScope = nullptr;
+}
+
+
+PopCameraDevice::TCallbackDispatcher::TCallbackDispatcher(std::function<void()> Dispatch) :
+	mState		( std::make_shared<TState>() )
+{
+	mState->mDispatch = Dispatch;
+	auto State = mState;
+	mThread = std::thread( [State]()	{	Thread(State);	} );
+}
+
+PopCameraDevice::TCallbackDispatcher::~TCallbackDispatcher()
+{
+	{
+		std::lock_guard<std::mutex> Lock(mState->mLock);
+		mState->mRunning = false;
+	}
+	mState->mCondition.notify_all();
+
+	//	if a callback freed the device, we're being destroyed on our own thread.
+	//	The thread holds its own reference to the state, so it can return safely once detached
+	if ( mThread.get_id() == std::this_thread::get_id() )
+		mThread.detach();
+	else if ( mThread.joinable() )
+		mThread.join();
+}
+
+void PopCameraDevice::TCallbackDispatcher::Notify()
+{
+	auto& State = *mState;
+	{
+		std::lock_guard<std::mutex> Lock(State.mLock);
+		if ( State.mPendingNotifications == 0 )
+			State.mFirstPendingTime = std::chrono::steady_clock::now();
+		State.mPendingNotifications++;
+	}
+	State.mCondition.notify_one();
+}
+
+void PopCameraDevice::TCallbackDispatcher::Thread(std::shared_ptr<TState> pState)
+{
+	auto& State = *pState;
+	while ( true )
+	{
+		std::chrono::steady_clock::time_point PendingTime;
+		{
+			std::unique_lock<std::mutex> Lock(State.mLock);
+			State.mCondition.wait( Lock, [&State]()	{	return !State.mRunning || State.mPendingNotifications > 0;	} );
+			if ( !State.mRunning )
+				return;
+
+			State.mCoalescedCount += State.mPendingNotifications - 1;
+			State.mPendingNotifications = 0;
+			PendingTime = State.mFirstPendingTime;
+		}
+
+		auto Latency = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - PendingTime );
+		uint64_t LatencyUs = Latency.count();
+		State.mLastLatencyUs = LatencyUs;
+		if ( LatencyUs > State.mMaxLatencyUs )
+			State.mMaxLatencyUs = LatencyUs;
+		State.mDispatchCount++;
+
+		try
+		{
+			State.mDispatch();
+		}
+		catch(std::exception& e)
+		{
+			std::Debug << "Callback dispatcher exception; " << e.what() << std::endl;
+		}
+	}
+}
+
+void PopCameraDevice::TCallbackDispatcher::GetMeta(json11::Json::object& Meta)
+{
+	auto& State = *mState;
+	Meta["CallbackDispatches"] = static_cast<int>(State.mDispatchCount);
+	Meta["CallbackCoalesced"] = static_cast<int>(State.mCoalescedCount);
+	Meta["CallbackLatencyMs"] = State.mLastLatencyUs / 1000.0;
+	Meta["CallbackLatencyMaxMs"] = State.mMaxLatencyUs / 1000.0;
+}
+
+
+
+PopCameraDevice::TCallbackRegistry::~TCallbackRegistry()
+{
+	mCallbacks = nullptr;
+}
+
+uint32_t PopCameraDevice::TCallbackRegistry::Add(std::function<void()> Callback)
+{
+	std::lock_guard<std::mutex> Lock(mWriteLock);
+	std::unique_ptr<TCallbackList> NewList( mCurrentList ? new TCallbackList(*mCurrentList) : new TCallbackList() );
+
+	TCallback NewCallback;
+	NewCallback.mHandle = mHandleCounter++;
+	NewCallback.mFunction = Callback;
+	NewList->push_back(NewCallback);
+
+	Replace( std::move(NewList) );
+	return NewCallback.mHandle;
+}
+
+bool PopCameraDevice::TCallbackRegistry::Remove(uint32_t Handle)
+{
+	{
+		std::lock_guard<std::mutex> Lock(mWriteLock);
+		if ( !mCurrentList )
+			return false;
+
+		std::unique_ptr<TCallbackList> NewList( new TCallbackList() );
+		for ( auto& Callback : *mCurrentList )
+		{
+			if ( Callback.mHandle != Handle )
+				NewList->push_back(Callback);
+		}
+		if ( NewList->size() == mCurrentList->size() )
+			return false;
+
+		Replace( std::move(NewList) );
+	}
+
+	//	a callback removing itself (or another) can't wait for its own Call() to finish
+	if ( IsCallingOnThisThread() )
+		return true;
+
+	//	calls starting from now see the new list, so once the running ones finish the removed callback
+	//	is never called again. Wait outside the lock, so a callback on another thread can still Add/Remove
+	while ( mCallingCount > 0 )
+		std::this_thread::yield();
+
+	std::lock_guard<std::mutex> Lock(mWriteLock);
+	if ( mCallingCount == 0 )
+		mRetiredLists.clear();
+	return true;
+}
+
+bool PopCameraDevice::TCallbackRegistry::IsCallingOnThisThread() const
+{
+	for ( auto* Scope = gInnermostCallingScope;	Scope;	Scope = Scope->mOuter )
+	{
+		if ( Scope->mRegistry == this )
+			return true;
+	}
+	return false;
+}
+
+void PopCameraDevice::TCallbackRegistry::Replace(std::unique_ptr<TCallbackList> NewList)
+{
+	mRetiredLists.push_back( std::move(mCurrentList) );
+	mCurrentList = std::move(NewList);
+	mCallbacks = mCurrentList.get();
+
+	//	anyone who starts calling from now sees the new list, so if no-one is calling,
+	//	nothing can still be using the old ones.
+	//	If a callback is adding/removing, the old list lives until the next change
+	if ( mCallingCount == 0 )
+		mRetiredLists.clear();
+}
+
+void PopCameraDevice::TCallbackRegistry::Call()
+{
+	TCallingScope Scope;
+	Scope.mRegistry = this;
+	Scope.mOuter = gInnermostCallingScope;
+	gInnermostCallingScope = &Scope;
+
+	mCallingCount++;
+	auto* Callbacks = mCallbacks.load();
+	if ( Callbacks )
+	{
+		for ( auto& Callback : *Callbacks )
+		{
+			try
+			{
+				Callback.mFunction();
+			}
+			catch (std::exception& e)
+			{
+				std::Debug << "OnNewFrame callback exception; " << e.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::Debug << "OnNewFrame callback unknown exception" << std::endl;
+			}
+		}
+	}
+	mCallingCount--;
+	gInnermostCallingScope = Scope.mOuter;
+}
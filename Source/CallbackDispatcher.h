@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "Json11/json11.hpp"
+
+
+namespace PopCameraDevice
+{
+	class TCallbackDispatcher;
+	class TCallbackRegistry;
+}
+
+
+//	copy-on-write list of callbacks. Add/Remove copy the list and swap it in,
+//	so Call() (on the capture or dispatcher thread) takes no lock and doesn't allocate.
+//	Replaced lists are freed once no Call() is running
+class PopCameraDevice::TCallbackRegistry
+{
+public:
+	TCallbackRegistry()	{}
+	~TCallbackRegistry();
+
+	uint32_t				Add(std::function<void()> Callback);	//	returns handle for Remove
+	//	false if no such callback. Waits for any Call() still running it (so its data can be freed),
+	//	unless removed from inside a callback on this thread
+	bool					Remove(uint32_t Handle);
+	void					Call();
+
+private:
+	class TCallback
+	{
+	public:
+		uint32_t				mHandle = 0;
+		std::function<void()>	mFunction;
+	};
+	typedef std::vector<TCallback>	TCallbackList;
+
+	void					Replace(std::unique_ptr<TCallbackList> NewList);	//	call with mWriteLock held
+	bool					IsCallingOnThisThread() const;
+
+private:
+	std::atomic<TCallbackList*>	mCallbacks = nullptr;
+	std::atomic<int>			mCallingCount = 0;
+
+	std::mutex					mWriteLock;
+	std::unique_ptr<TCallbackList>				mCurrentList;
+	std::vector<std::unique_ptr<TCallbackList>>	mRetiredLists;	//	may still be being iterated
+	uint32_t					mHandleCounter = 1;
+};
+
+
+//	runs new-frame callbacks on its own thread, so a slow callback never stalls capture.
+//	Notifications which arrive while callbacks are running are coalesced into one more dispatch
+class PopCameraDevice::TCallbackDispatcher
+{
+public:
+	TCallbackDispatcher(std::function<void()> Dispatch);
+	~TCallbackDispatcher();
+
+	void					Notify();			//	called from the capture thread, never waits on callbacks
+	void					GetMeta(json11::Json::object& Meta);
+
+private:
+	//	shared with the thread, so if a callback frees the device (and us) the thread
+	//	can still finish its loop after being detached
+	class TState
+	{
+	public:
+		std::function<void()>	mDispatch;
+
+		std::mutex				mLock;
+		std::condition_variable	mCondition;
+		bool					mRunning = true;
+		size_t					mPendingNotifications = 0;
+		std::chrono::steady_clock::time_point	mFirstPendingTime;	//	oldest notification not yet dispatched
+
+		//	stats
+		std::atomic<size_t>		mDispatchCount = 0;
+		std::atomic<size_t>		mCoalescedCount = 0;	//	notifications folded into another dispatch
+		std::atomic<uint64_t>	mLastLatencyUs = 0;		//	push to callback start
+		std::atomic<uint64_t>	mMaxLatencyUs = 0;
+	};
+
+	static void				Thread(std::shared_ptr<TState> State);	//	never touches the dispatcher
+
+private:
+	std::shared_ptr<TState>	mState;
+	std::thread				mThread;	//	last, so the state exists before it starts
+};
@@ -0,0 +1,389 @@
+#include "DeviceStats.h"
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <magic_enum/include/magic_enum/magic_enum.hpp>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace PopCameraDevice
+{
+	double	NanoSecondsToMs(uint64_t Ns)	{	return static_cast<double>(Ns) / 1000000.0;	}
+
+	//	index of the highest set bit (Value must be non-zero); std::bit_width is c++20, android & linux build as c++17
+	size_t	GetTopBit(uint64_t Value)
+	{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+		unsigned long Index = 0;
+		_BitScanReverse64( &Index, Value );
+		return Index;
+#elif defined(__GNUC__) || defined(__clang__)
+		return 63 - __builtin_clzll(Value);
+#else
+		size_t TopBit = 0;
+		while ( Value >>= 1 )
+			TopBit++;
+		return TopBit;
+#endif
+	}
+
+	//	atomic max; another thread may raise it first, which is fine
+	void	UpdateMax(std::atomic<uint64_t>& Max,uint64_t Value)
+	{
+		auto Current = Max.load(std::memory_order_relaxed);
+		while ( Value > Current && !Max.compare_exchange_weak(Current, Value, std::memory_order_relaxed) )
+		{
+		}
+	}
+}
+
+
+PopCameraDevice::THistogram::THistogram()
+{
+	for ( auto& Bucket : mBuckets )
+		Bucket.store(0, std::memory_order_relaxed);
+}
+
+size_t PopCameraDevice::THistogram::GetBucket(uint64_t Value)
+{
+	const uint64_t SubBuckets = 1 << SubBucketBits;
+	if ( Value < SubBuckets )
+		return static_cast<size_t>(Value);
+
+	//	top bit picks the power of two, the next bits pick the sub-bucket
+	auto TopBit = GetTopBit(Value);
+	auto Shift = TopBit - SubBucketBits;
+	auto SubBucket = (Value >> Shift) & (SubBuckets-1);
+	return ((Shift+1) << SubBucketBits) + static_cast<size_t>(SubBucket);
+}
+
+uint64_t PopCameraDevice::THistogram::GetBucketUpperBound(size_t Bucket)
+{
+	const uint64_t SubBuckets = 1 << SubBucketBits;
+	if ( Bucket < SubBuckets )
+		return Bucket;
+
+	auto Shift = (Bucket >> SubBucketBits) - 1;
+	auto SubBucket = Bucket & (SubBuckets-1);
+	auto Lower = (SubBuckets + SubBucket) << Shift;
+	return Lower + ((uint64_t(1) << Shift) - 1);
+}
+
+void PopCameraDevice::THistogram::Add(uint64_t Value)
+{
+	mBuckets[GetBucket(Value)].fetch_add(1, std::memory_order_relaxed);
+	mTotal.fetch_add(Value, std::memory_order_relaxed);
+	UpdateMax(mMax, Value);
+	//	count last, so a reader never sees more counted than bucketed (except mid-update of another add)
+	mCount.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t PopCameraDevice::THistogram::GetMean() const
+{
+	uint64_t Count = mCount;
+	if ( Count == 0 )
+		return 0;
+	return mTotal / Count;
+}
+
+uint64_t PopCameraDevice::THistogram::GetPercentile(float Percentile) const
+{
+	//	counts may be moving whilst we read, so work from what's in the buckets
+	uint64_t Total = 0;
+	for ( auto& Bucket : mBuckets )
+		Total += Bucket.load(std::memory_order_relaxed);
+	if ( Total == 0 )
+		return 0;
+
+	Percentile = std::clamp( Percentile, 0.f, 1.f );
+	auto Target = std::max<uint64_t>( 1, static_cast<uint64_t>( std::ceil( Percentile * Total ) ) );
+	uint64_t Cumulative = 0;
+	for ( size_t b=0;	b<BucketCount;	b++ )
+	{
+		Cumulative += mBuckets[b].load(std::memory_order_relaxed);
+		if ( Cumulative >= Target )
+			return std::min( GetBucketUpperBound(b), GetMax() );
+	}
+	return GetMax();
+}
+
+void PopCameraDevice::THistogram::GetJson(json11::Json::object& Json) const
+{
+	Json["Count"] = static_cast<double>(GetCount());
+	Json["MeanMs"] = NanoSecondsToMs( GetMean() );
+	Json["P50Ms"] = NanoSecondsToMs( GetPercentile(0.50f) );
+	Json["P90Ms"] = NanoSecondsToMs( GetPercentile(0.90f) );
+	Json["P99Ms"] = NanoSecondsToMs( GetPercentile(0.99f) );
+	Json["MaxMs"] = NanoSecondsToMs( GetMax() );
+}
+
+
+PopCameraDevice::TStreamStats* PopCameraDevice::TDeviceStats::GetStream(const std::string& StreamName)
+{
+	//	0 marks an unclaimed slot. Slots are claimed in order, so stop at the first free one.
+	//	Two names with the same hash share stats, which is fine for the handful of streams a device has
+	auto NameHash = std::hash<std::string>()(StreamName) | 1;
+	for ( auto& Stream : mStreams )
+	{
+		auto SlotHash = Stream.mNameHash.load(std::memory_order_acquire);
+		if ( SlotHash == NameHash )
+			return &Stream;
+		if ( SlotHash == 0 )
+			break;
+	}
+
+	//	first frame of a new stream
+	std::lock_guard<std::mutex> Lock(mStreamsLock);
+	for ( auto& Stream : mStreams )
+	{
+		auto SlotHash = Stream.mNameHash.load(std::memory_order_acquire);
+		if ( SlotHash == NameHash )
+			return &Stream;
+		if ( SlotHash != 0 )
+			continue;
+		Stream.mName = StreamName;
+		Stream.mNameHash.store(NameHash, std::memory_order_release);
+		return &Stream;
+	}
+	return nullptr;
+}
+
+PopCameraDevice::TDeviceStats::TDeviceStats()
+{
+	for ( auto& Dropped : mDroppedFrames )
+		Dropped.store(0, std::memory_order_relaxed);
+}
+
+uint64_t PopCameraDevice::TDeviceStats::GetStageDuration(const TFrameStageTimes& Stages,TFrameStage::Type Stage)
+{
+	auto EndNs = Stages[Stage];
+	if ( EndNs == 0 )
+		return 0;
+
+	//	skip stages the backend didn't stamp
+	for ( int s=static_cast<int>(Stage)-1;	s>=0;	s-- )
+	{
+		auto StartNs = Stages[s];
+		if ( StartNs == 0 )
+			continue;
+		return (EndNs > StartNs) ? EndNs - StartNs : 0;
+	}
+	return 0;
+}
+
+void PopCameraDevice::TDeviceStats::AddStageDuration(const TFrameStageTimes& Stages,TFrameStage::Type Stage)
+{
+	if ( Stages[Stage] == 0 )
+		return;
+	mStageDuration[Stage].Add( GetStageDuration(Stages, Stage) );
+}
+
+void PopCameraDevice::TDeviceStats::OnFramePushed(const std::string& StreamName,const TFrameStageTimes& Stages)
+{
+	mPushedFrames++;
+	AddStageDuration( Stages, TFrameStage::BackendCallback );
+	AddStageDuration( Stages, TFrameStage::Enqueue );
+
+	auto* pStream = GetStream(StreamName);
+	if ( !pStream )
+		return;
+	auto& Stream = *pStream;
+	Stream.mFrames++;
+
+	auto PushTimeNs = Stages[TFrameStage::Enqueue];
+	auto LastPushNs = Stream.mLastPushNs.exchange(PushTimeNs);
+	if ( LastPushNs == 0 || PushTimeNs <= LastPushNs )
+		return;
+
+	//	moving average over ~8 frames. Two threads pushing the same stream at once just lose a sample
+	auto IntervalNs = PushTimeNs - LastPushNs;
+	uint64_t Average = Stream.mIntervalNs.load(std::memory_order_relaxed);
+	Average = (Average == 0) ? IntervalNs : Average - (Average/8) + (IntervalNs/8);
+	Stream.mIntervalNs.store(Average, std::memory_order_relaxed);
+}
+
+void PopCameraDevice::TDeviceStats::OnFramePopped(const TFrameStageTimes& Stages)
+{
+	mPoppedFrames++;
+	AddStageDuration( Stages, TFrameStage::Dequeue );
+}
+
+void PopCameraDevice::TDeviceStats::OnFrameCopied(const TFrameStageTimes& Stages)
+{
+	//	peeked frames are copied without being dequeued, and may be copied again
+	if ( Stages[TFrameStage::Dequeue] == 0 )
+		return;
+	AddStageDuration( Stages, TFrameStage::Copied );
+
+	auto CaptureNs = Stages[TFrameStage::Capture];
+	auto CopiedNs = Stages[TFrameStage::Copied];
+	if ( CaptureNs != 0 && CopiedNs >= CaptureNs )
+		mCaptureToCopied.Add( CopiedNs - CaptureNs );
+}
+
+void PopCameraDevice::TDeviceStats::OnFramesDropped(TDropReason::Type Reason,size_t Count)
+{
+	if ( Count == 0 )
+		return;
+	mDroppedFrames[Reason].fetch_add(Count, std::memory_order_relaxed);
+}
+
+void PopCameraDevice::TDeviceStats::OnCallbacks(uint64_t DurationNs)
+{
+	mCallbackDuration.Add(DurationNs);
+}
+
+void PopCameraDevice::TDeviceStats::OnCopy(size_t Bytes,uint64_t DurationNs)
+{
+	mCopiedBytes.fetch_add(Bytes, std::memory_order_relaxed);
+	mCopyDurationNs.fetch_add(DurationNs, std::memory_order_relaxed);
+}
+
+void PopCameraDevice::TDeviceStats::GetJson(json11::Json::object& Json)
+{
+	//	json numbers are doubles, so counters are written as doubles rather than truncated to int
+	Json["PushedFrames"] = static_cast<double>(mPushedFrames);
+	Json["PoppedFrames"] = static_cast<double>(mPoppedFrames);
+
+	json11::Json::object Dropped;
+	for ( size_t r=0;	r<TDropReason::Count;	r++ )
+	{
+		auto Reason = static_cast<TDropReason::Type>(r);
+		Dropped[std::string(magic_enum::enum_name(Reason))] = static_cast<double>(mDroppedFrames[r]);
+	}
+	Json["DroppedFrames"] = Dropped;
+
+	json11::Json::object Streams;
+	{
+		std::lock_guard<std::mutex> Lock(mStreamsLock);
+		for ( auto& Stream : mStreams )
+		{
+			if ( Stream.mNameHash == 0 )
+				break;
+			json11::Json::object StreamJson;
+			StreamJson["Frames"] = static_cast<double>(Stream.mFrames);
+			uint64_t IntervalNs = Stream.mIntervalNs;
+			StreamJson["Fps"] = IntervalNs ? 1000000000.0 / static_cast<double>(IntervalNs) : 0.0;
+			auto Name = Stream.mName.empty() ? std::string("Default") : Stream.mName;
+			Streams[Name] = StreamJson;
+		}
+	}
+	Json["Streams"] = Streams;
+
+	json11::Json::object Latency;
+	mStageDuration[TFrameStage::Dequeue].GetJson(Latency);
+	Json["PushToPopLatency"] = Latency;
+
+	//	time spent reaching each stage from the one before, to see whether latency is in the sdk, backend, queue or copy
+	json11::Json::object StageLatency;
+	for ( size_t s=TFrameStage::Capture+1;	s<TFrameStage::Count;	s++ )
+	{
+		auto Stage = static_cast<TFrameStage::Type>(s);
+		json11::Json::object StageJson;
+		mStageDuration[s].GetJson(StageJson);
+		StageLatency[std::string(magic_enum::enum_name(Stage))] = StageJson;
+	}
+	json11::Json::object TotalJson;
+	mCaptureToCopied.GetJson(TotalJson);
+	StageLatency["CaptureToCopied"] = TotalJson;
+	Json["StageLatency"] = StageLatency;
+
+	json11::Json::object Callbacks;
+	mCallbackDuration.GetJson(Callbacks);
+	Json["CallbackDuration"] = Callbacks;
+
+	uint64_t CopiedBytes = mCopiedBytes;
+	uint64_t CopyDurationNs = mCopyDurationNs;
+	Json["CopiedBytes"] = static_cast<double>(CopiedBytes);
+	double CopySecs = static_cast<double>(CopyDurationNs) / 1000000000.0;
+	Json["CopyMBPerSecond"] = (CopyDurationNs > 0) ? (static_cast<double>(CopiedBytes) / (1024.0*1024.0)) / CopySecs : 0.0;
+}
+
+
+void PopCameraDevice::DeviceStats_UnitTests()
+{
+	auto Expect = [](bool Condition,const char* Description)
+	{
+		if ( Condition )
+			return;
+		std::stringstream Error;
+		Error << "DeviceStats test failed: " << Description;
+		throw std::runtime_error(Error.str());
+	};
+
+	//	every value must land in a bucket whose bound is >= it, and buckets must be in order
+	uint64_t PrevBucket = 0;
+	for ( uint64_t Value=0;	Value<100000;	Value++ )
+	{
+		auto Bucket = THistogram::GetBucket(Value);
+		Expect( Bucket < THistogram::BucketCount, "bucket out of range" );
+		Expect( Bucket >= PrevBucket, "buckets out of order" );
+		Expect( THistogram::GetBucketUpperBound(Bucket) >= Value, "value above its bucket's bound" );
+		Expect( Bucket == 0 || THistogram::GetBucketUpperBound(Bucket-1) < Value, "value below its bucket's lower bound" );
+		PrevBucket = Bucket;
+	}
+	Expect( THistogram::GetBucket(~uint64_t(0)) < THistogram::BucketCount, "max value out of range" );
+
+	//	1..1000us uniformly, percentiles should be within a bucket (25%)
+	THistogram Histogram;
+	Expect( Histogram.GetPercentile(0.5f) == 0, "empty histogram should report 0" );
+	for ( uint64_t Us=1;	Us<=1000;	Us++ )
+		Histogram.Add( Us * 1000 );
+	auto P50 = Histogram.GetPercentile(0.5f);
+	auto P99 = Histogram.GetPercentile(0.99f);
+	Expect( Histogram.GetCount() == 1000, "wrong count" );
+	Expect( P50 >= 500000 && P50 <= 500000*5/4, "p50 out of range" );
+	Expect( P99 >= 990000 && P99 <= 1000000, "p99 out of range" );
+	Expect( Histogram.GetMax() == 1000000, "wrong max" );
+
+	//	unstamped stages are skipped over
+	TFrameStageTimes Stages = {};
+	Stages[TFrameStage::Capture] = 1000;
+	Stages[TFrameStage::Enqueue] = 1500;
+	Stages[TFrameStage::Dequeue] = 4000;
+	Expect( TDeviceStats::GetStageDuration(Stages, TFrameStage::BackendCallback) == 0, "unstamped stage should have no duration" );
+	Expect( TDeviceStats::GetStageDuration(Stages, TFrameStage::Enqueue) == 500, "enqueue should be measured from capture" );
+	Expect( TDeviceStats::GetStageDuration(Stages, TFrameStage::Dequeue) == 2500, "wrong dequeue duration" );
+	Stages[TFrameStage::BackendCallback] = 1200;
+	Expect( TDeviceStats::GetStageDuration(Stages, TFrameStage::Enqueue) == 300, "enqueue should be measured from callback" );
+
+	//	streams are tracked by name, with fps from push intervals
+	TDeviceStats Stats;
+	auto Push = [&](const char* StreamName,uint64_t PushTimeNs)
+	{
+		TFrameStageTimes PushStages = {};
+		PushStages[TFrameStage::Enqueue] = PushTimeNs;
+		Stats.OnFramePushed( StreamName, PushStages );
+	};
+	for ( uint64_t f=1;	f<=10;	f++ )
+	{
+		Push("Colour", f * 33333333 );
+		Push("Depth", f * 11111111 );
+	}
+	Stats.OnFramesDropped( TDropReason::Culled, 3 );
+	json11::Json::object Json;
+	Stats.GetJson(Json);
+	auto Parsed = json11::Json(Json);
+	Expect( Parsed["PushedFrames"].number_value() == 20, "wrong pushed count" );
+	Expect( Parsed["DroppedFrames"]["Culled"].number_value() == 3, "wrong drop count" );
+	auto ColourFps = Parsed["Streams"]["Colour"]["Fps"].number_value();
+	auto DepthFps = Parsed["Streams"]["Depth"]["Fps"].number_value();
+	Expect( ColourFps > 29 && ColourFps < 31, "wrong colour fps" );
+	Expect( DepthFps > 89 && DepthFps < 91, "wrong depth fps" );
+
+	//	a copy is only counted for frames which were dequeued
+	Stats.OnFramePopped(Stages);
+	Stats.OnFrameCopied(Stages);
+	Stages[TFrameStage::Copied] = 5000;
+	Stats.OnFrameCopied(Stages);
+	Json.clear();
+	Stats.GetJson(Json);
+	Parsed = json11::Json(Json);
+	Expect( Parsed["StageLatency"]["Dequeue"]["Count"].number_value() == 1, "wrong dequeue count" );
+	Expect( Parsed["StageLatency"]["Copied"]["Count"].number_value() == 1, "wrong copied count" );
+	Expect( Parsed["StageLatency"]["CaptureToCopied"]["MaxMs"].number_value() == 0.004, "wrong capture to copied" );
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <string>
+#include "Json11/json11.hpp"
+
+
+namespace PopCameraDevice
+{
+	class THistogram;
+	class TStreamStats;
+	class TDeviceStats;
+
+	void	DeviceStats_UnitTests();
+
+	//	why a frame never reached the caller
+	namespace TDropReason
+	{
+		enum Type
+		{
+			Culled,			//	oldest frames removed to make room (DropOldest)
+			Rejected,		//	new frame discarded as the queue was full (DropNewest)
+			Replaced,		//	unread frame replaced by a newer one (LatestOnly)
+			BlockTimeout,	//	BlockProducer gave up waiting for space
+			Skipped,		//	caller skipped to the latest frame
+			Count
+		};
+	}
+
+	//	points in a frame's life, stamped on the steady_clock (GetHostTimeNs) so latency can be split by stage
+	namespace TFrameStage
+	{
+		enum Type
+		{
+			Capture,			//	host time the sensor captured it (TFrame::mHostTimeNs)
+			BackendCallback,	//	backend's capture callback was entered (eg. before the kinect depth->colour transform). 0 if the backend doesn't stamp it
+			Enqueue,			//	PushFrame queued it
+			Dequeue,			//	caller popped it (not set for peeked frames)
+			Copied,				//	planes copied (or locked) for the caller
+			Count
+		};
+	}
+	typedef std::array<uint64_t,TFrameStage::Count>	TFrameStageTimes;	//	0 = not reached/unknown
+}
+
+
+//	lock-free histogram of nanosecond durations. Buckets are powers of two, each split
+//	into 4 linear sub-buckets, so percentiles are accurate to within 25%
+class PopCameraDevice::THistogram
+{
+public:
+	static constexpr size_t	SubBucketBits = 2;
+	static constexpr size_t	BucketCount = 64 << SubBucketBits;
+
+	THistogram();			//	atomics in arrays aren't zeroed by default before c++20
+
+	void					Add(uint64_t Value);
+	uint64_t				GetCount() const	{	return mCount;	}
+	uint64_t				GetMax() const		{	return mMax;	}
+	uint64_t				GetMean() const;
+	uint64_t				GetPercentile(float Percentile) const;	//	0..1, returns the bucket's upper bound (capped to max)
+	void					GetJson(json11::Json::object& Json) const;	//	writes Count, MeanMs, P50Ms, P90Ms, P99Ms, MaxMs
+
+	static size_t			GetBucket(uint64_t Value);
+	static uint64_t			GetBucketUpperBound(size_t Bucket);
+
+private:
+	std::array<std::atomic<uint64_t>,BucketCount>	mBuckets;
+	std::atomic<uint64_t>	mCount = 0;
+	std::atomic<uint64_t>	mTotal = 0;
+	std::atomic<uint64_t>	mMax = 0;
+};
+
+
+class PopCameraDevice::TStreamStats
+{
+public:
+	std::atomic<size_t>		mNameHash = 0;		//	non-zero once the slot is claimed
+	std::string				mName;				//	only written (under the streams lock) before the hash is published
+	std::atomic<uint64_t>	mFrames = 0;
+	std::atomic<uint64_t>	mLastPushNs = 0;
+	std::atomic<uint64_t>	mIntervalNs = 0;	//	moving average of time between frames
+};
+
+
+//	counters updated on the capture & caller threads without locks, read by GetStatsJson
+class PopCameraDevice::TDeviceStats
+{
+public:
+	static constexpr size_t	MaxStreams = 8;
+
+	TDeviceStats();
+
+	void					OnFramePushed(const std::string& StreamName,const TFrameStageTimes& Stages);
+	void					OnFramePopped(const TFrameStageTimes& Stages);
+	void					OnFrameCopied(const TFrameStageTimes& Stages);
+	void					OnFramesDropped(TDropReason::Type Reason,size_t Count);
+	void					OnCallbacks(uint64_t DurationNs);
+	void					OnCopy(size_t Bytes,uint64_t DurationNs);
+
+	void					GetJson(json11::Json::object& Json);
+
+	//	time from the last stamped stage before Stage, 0 if either is unknown
+	static uint64_t			GetStageDuration(const TFrameStageTimes& Stages,TFrameStage::Type Stage);
+
+private:
+	TStreamStats*			GetStream(const std::string& StreamName);	//	null if there are too many streams
+	void					AddStageDuration(const TFrameStageTimes& Stages,TFrameStage::Type Stage);
+
+private:
+	std::atomic<uint64_t>	mPushedFrames = 0;
+	std::atomic<uint64_t>	mPoppedFrames = 0;
+	std::array<std::atomic<uint64_t>,TDropReason::Count>	mDroppedFrames;
+	std::atomic<uint64_t>	mCopiedBytes = 0;
+	std::atomic<uint64_t>	mCopyDurationNs = 0;
+	std::array<THistogram,TFrameStage::Count>	mStageDuration;	//	Capture is unused, it's the first stage
+	THistogram				mCaptureToCopied;
+	THistogram				mCallbackDuration;
+
+	std::mutex				mStreamsLock;	//	only taken to claim a slot for a new stream
+	std::array<TStreamStats,MaxStreams>	mStreams;
+};
@@ -0,0 +1,852 @@
+#include "FramePlanes.h"
+#include "PixelCopy.h"
+#include "PixelConvert.h"
+#include "PixelResize.h"
+#include <SoyMedia.h>
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <vector>
+#include <sstream>
+
+
+namespace PopCameraDevice
+{
+	//	what output does to a frame's planes
+	class TOutputSteps
+	{
+	public:
+		bool			mConvert = false;
+		bool			mResize = false;
+		bool			mResizeConverted = false;	//	planes can't be resized (eg. packed 422) so the converted image is resized instead
+		SoyPixelsMeta	mImageMeta;					//	output image; size, and format if converting
+	};
+
+	TOutputSteps	GetOutputSteps(ArrayBridge<TPlaneView>& Planes,const TOutputParams& Output);
+	void			GetOutputMetas(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,ArrayBridge<SoyPixelsMeta>&& Metas);
+	//	writes the first Rows rows of an output plane
+	void			WriteOutputPlane(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,const TOutputParams& Output,size_t PlaneIndex,const SoyPixelsMeta& OutputMeta,uint8_t* Dst,size_t Rows);
+	//	per-thread image between resizing & converting, only allocated when it needs to grow
+	uint8_t*		GetScratchBuffer(size_t Size);
+
+	//	the planes the output is made from; split (and cropped) when processing. Returns if they need converting or resizing
+	bool			GetOutputPlaneViews(ArrayBridge<SoyPixelsImpl*>& Textures,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output,BufferArray<TPlaneView,10>& Planes);
+	//	bytes CopyPlane writes into DstSize; cropped planes are packed in whole rows
+	size_t			GetCopySize(const TPlaneView& Plane,size_t DstSize);
+	void			CopyPlane(const TPlaneView& Plane,uint8_t* Dst,size_t CopySize);
+	//	bytes of each plane CopyPlanesToArena writes, OutputMetas are only used when processing.
+	//	Throws if a frame descriptor can't describe every plane
+	size_t			GetArenaPlaneSizes(ArrayBridge<TPlaneView>& Planes,bool Process,ArrayBridge<SoyPixelsMeta>& OutputMetas,std::array<size_t,PopCameraDevice_MaxPlanes>& PlaneSizes);
+	json11::Json::object	GetPlaneJson(const SoyPixelsMeta& PlaneMeta,const TRoi& Roi);
+	//	area of the source an output plane comes from; converted output is from the whole image
+	const TRoi&		GetOutputPlaneRoi(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,size_t PlaneIndex);
+	void			SetFrameInfoRoi(PopCameraDevice_FrameInfo& FrameInfo,const TRoi& Roi);
+	bool			IsPacked422(SoyPixelsFormat::Type Format);
+}
+
+
+void PopCameraDevice::GetObjectJson(json11::Json::object& Json,const SoyPixelsMeta& PlaneMeta)
+{
+	Json["Width"] = static_cast<int>(PlaneMeta.GetWidth());
+	Json["Height"] = static_cast<int>(PlaneMeta.GetHeight());
+	Json["Format"] = SoyPixelsFormat::ToString(PlaneMeta.GetFormat());
+	Json["DataSize"] = static_cast<int>(PlaneMeta.GetDataSize());
+	Json["Channels"] = PlaneMeta.GetChannels();
+}
+
+json11::Json::object PopCameraDevice::GetPlaneJson(const SoyPixelsMeta& PlaneMeta,const TRoi& Roi)
+{
+	json11::Json::object Json;
+	GetObjectJson(Json, PlaneMeta);
+	if ( !Roi.IsEmpty() )
+		Json["Roi"] = GetJson(Roi);
+	return Json;
+}
+
+json11::Json::array PopCameraDevice::GetJson(const TRoi& Roi)
+{
+	return json11::Json::array{ static_cast<int>(Roi.mX), static_cast<int>(Roi.mY), static_cast<int>(Roi.mWidth), static_cast<int>(Roi.mHeight) };
+}
+
+void PopCameraDevice::SetFrameInfoRoi(PopCameraDevice_FrameInfo& FrameInfo,const TRoi& Roi)
+{
+	FrameInfo.RoiX = static_cast<int32_t>(Roi.mX);
+	FrameInfo.RoiY = static_cast<int32_t>(Roi.mY);
+	FrameInfo.RoiWidth = static_cast<int32_t>(Roi.mWidth);
+	FrameInfo.RoiHeight = static_cast<int32_t>(Roi.mHeight);
+}
+
+void PopCameraDevice::GetJson(json11::Json::object& Json,SoyPixelsMeta PixelMeta)
+{
+	//	output all plane info
+	BufferArray<SoyPixelsMeta, 3> PlaneMetas;
+	PixelMeta.GetPlanes(GetArrayBridge(PlaneMetas));
+
+	json11::Json::array Planes;
+	for (auto p = 0; p < PlaneMetas.GetSize(); p++)
+	{
+		auto& PlaneMeta = PlaneMetas[p];
+		json11::Json::object PlaneMetaObject;
+		GetObjectJson(PlaneMetaObject, PlaneMeta);
+		Planes.push_back(PlaneMetaObject);
+	}
+
+	Json["Planes"] = Planes;
+}
+
+
+void PopCameraDevice::GetPlaneInfo(PopCameraDevice_PlaneInfo& Info,const SoyPixelsMeta& PlaneMeta)
+{
+	Info.Width = static_cast<int32_t>(PlaneMeta.GetWidth());
+	Info.Height = static_cast<int32_t>(PlaneMeta.GetHeight());
+	Info.Channels = static_cast<int32_t>(PlaneMeta.GetChannels());
+	Info.DataSize = static_cast<int32_t>(PlaneMeta.GetDataSize());
+	Info.RowStride = static_cast<int32_t>(PlaneMeta.GetRowDataSize());
+	Info.Format = static_cast<int32_t>(PlaneMeta.GetFormat());
+	Soy::StringToBuffer(SoyPixelsFormat::ToString(PlaneMeta.GetFormat()), Info.FormatName, std::size(Info.FormatName));
+}
+
+
+void PopCameraDevice::TPlaneLayout::Init(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes)
+{
+	mMeta = Meta;
+	mDataSize = DataSize;
+	mSplitPlanes = SplitPlanes;
+	mPlaneCount = 0;
+
+	//	whole texture as one plane (assuming its not split)
+	if ( !SplitPlanes )
+	{
+		mPlaneMetas[0] = Meta;
+		mPlaneOffsets[0] = 0;
+		mPlaneSizes[0] = DataSize;
+		mPlaneCount = 1;
+		return;
+	}
+
+	//	same split as SoyPixelsImpl::SplitPlanes, without creating pixel objects
+	BufferArray<std::tuple<size_t,size_t,SoyPixelsMeta>,10> PlaneOffsetSizeAndMetas;
+	Meta.SplitPlanes( DataSize, GetArrayBridge(PlaneOffsetSizeAndMetas) );
+	if ( PlaneOffsetSizeAndMetas.GetSize() > MaxPlanes )
+	{
+		std::stringstream Error;
+		Error << Meta << " splits into " << PlaneOffsetSizeAndMetas.GetSize() << " planes, max " << MaxPlanes;
+		throw Soy::AssertException(Error);
+	}
+	for ( auto p=0;	p<PlaneOffsetSizeAndMetas.GetSize();	p++ )
+	{
+		auto& PlaneOffsetSizeAndMeta = PlaneOffsetSizeAndMetas[p];
+		mPlaneOffsets[p] = std::get<0>(PlaneOffsetSizeAndMeta);
+		mPlaneSizes[p] = std::get<1>(PlaneOffsetSizeAndMeta);
+		mPlaneMetas[p] = std::get<2>(PlaneOffsetSizeAndMeta);
+	}
+	mPlaneCount = PlaneOffsetSizeAndMetas.GetSize();
+}
+
+size_t PopCameraDevice::TPlaneLayout::GetDataSize() const
+{
+	size_t DataSize = 0;
+	for ( size_t p=0;	p<mPlaneCount;	p++ )
+		DataSize += mPlaneSizes[p];
+	return DataSize;
+}
+
+bool PopCameraDevice::TPlaneLayout::IsLayoutFor(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes) const
+{
+	return mPlaneCount > 0 && mMeta == Meta && mDataSize == DataSize && mSplitPlanes == SplitPlanes;
+}
+
+
+void PopCameraDevice::TPlaneLayoutCache::GetLayout(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes,TPlaneLayout& Layout)
+{
+	{
+		std::lock_guard<std::mutex> Lock(mLock);
+		for ( size_t l=0;	l<mLayoutCount;	l++ )
+		{
+			if ( !mLayouts[l].IsLayoutFor(Meta, DataSize, SplitPlanes) )
+				continue;
+			Layout = mLayouts[l];
+			return;
+		}
+	}
+
+	//	work out outside the lock, if another thread adds the same layout meanwhile we just have a duplicate
+	Layout.Init( Meta, DataSize, SplitPlanes );
+
+	std::lock_guard<std::mutex> Lock(mLock);
+	if ( mLayoutCount < MaxLayouts )
+	{
+		mLayouts[mLayoutCount++] = Layout;
+		return;
+	}
+	mLayouts[mNextReplace] = Layout;
+	mNextReplace = (mNextReplace + 1) % MaxLayouts;
+}
+
+
+void PopCameraDevice::GetPlaneViews(ArrayBridge<SoyPixelsImpl*>& Textures,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,ArrayBridge<TPlaneView>&& Planes)
+{
+	TPlaneLayout Layout;
+	for ( auto t=0;	t<Textures.GetSize();	t++ )
+	{
+		auto& Texture = *Textures[t];
+		auto& Pixels = Texture.GetPixelsArray();
+		auto DataSize = Pixels.GetDataSize();
+		if ( LayoutCache )
+			LayoutCache->GetLayout( Texture.GetMeta(), DataSize, SplitPlanes, Layout );
+		else
+			Layout.Init( Texture.GetMeta(), DataSize, SplitPlanes );
+
+		for ( size_t p=0;	p<Layout.mPlaneCount;	p++ )
+		{
+			TPlaneView Plane;
+			Plane.mMeta = Layout.mPlaneMetas[p];
+			Plane.mPixels = Pixels.GetArray() + Layout.mPlaneOffsets[p];
+			Plane.mDataSize = Layout.mPlaneSizes[p];
+			Planes.PushBack(Plane);
+		}
+	}
+}
+
+
+bool PopCameraDevice::IsPacked422(SoyPixelsFormat::Type Format)
+{
+	switch ( Format )
+	{
+	case SoyPixelsFormat::YYuv_8888:
+	case SoyPixelsFormat::YUY2:
+	case SoyPixelsFormat::uyvy_8888:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void PopCameraDevice::CropPlaneViews(ArrayBridge<TPlaneView>& Planes,const TRoi& Roi)
+{
+	if ( Planes.IsEmpty() || Roi.IsEmpty() )
+		return;
+
+	auto ImageWidth = Planes[0].mMeta.GetWidth();
+	auto ImageHeight = Planes[0].mMeta.GetHeight();
+	if ( Roi.mX >= ImageWidth || Roi.mY >= ImageHeight )
+	{
+		std::stringstream Error;
+		Error << "Roi " << Roi.mX << "," << Roi.mY << " " << Roi.mWidth << "x" << Roi.mHeight << " outside " << ImageWidth << "x" << ImageHeight << " image";
+		throw Soy::AssertException(Error);
+	}
+
+	//	expand to whole samples of the most subsampled plane, so a chroma pixel is never split
+	size_t AlignX = 1;
+	size_t AlignY = 1;
+	for ( auto p=0;	p<Planes.GetSize();	p++ )
+	{
+		auto& Meta = Planes[p].mMeta;
+		if ( Meta.GetWidth() == 0 || Meta.GetHeight() == 0 )
+			throw Soy::AssertException("Cannot crop an empty plane");
+		AlignX = std::max( AlignX, (ImageWidth + Meta.GetWidth() - 1) / Meta.GetWidth() );
+		AlignY = std::max( AlignY, (ImageHeight + Meta.GetHeight() - 1) / Meta.GetHeight() );
+		if ( IsPacked422( Meta.GetFormat() ) )
+			AlignX = std::max<size_t>( AlignX, 2 );
+	}
+	auto Left = (Roi.mX / AlignX) * AlignX;
+	auto Top = (Roi.mY / AlignY) * AlignY;
+	auto Right = std::min( ((Roi.mX + Roi.mWidth + AlignX - 1) / AlignX) * AlignX, ImageWidth );
+	auto Bottom = std::min( ((Roi.mY + Roi.mHeight + AlignY - 1) / AlignY) * AlignY, ImageHeight );
+
+	for ( auto p=0;	p<Planes.GetSize();	p++ )
+	{
+		auto& Plane = Planes[p];
+		auto PlaneWidth = Plane.mMeta.GetWidth();
+		auto PlaneHeight = Plane.mMeta.GetHeight();
+		//	edges round outwards, so odd sized images keep their last chroma sample
+		TRoi PlaneRoi;
+		PlaneRoi.mX = Left * PlaneWidth / ImageWidth;
+		PlaneRoi.mY = Top * PlaneHeight / ImageHeight;
+		PlaneRoi.mWidth = (Right * PlaneWidth + ImageWidth - 1) / ImageWidth - PlaneRoi.mX;
+		PlaneRoi.mHeight = (Bottom * PlaneHeight + ImageHeight - 1) / ImageHeight - PlaneRoi.mY;
+
+		auto Stride = Plane.GetRowStride();
+		auto PixelBytes = Plane.mMeta.GetRowDataSize() / PlaneWidth;
+		SoyPixelsMeta CroppedMeta( PlaneRoi.mWidth, PlaneRoi.mHeight, Plane.mMeta.GetFormat() );
+		auto Offset = PlaneRoi.mY * Stride + PlaneRoi.mX * PixelBytes;
+		auto DataSize = (PlaneRoi.mHeight - 1) * Stride + CroppedMeta.GetRowDataSize();
+		if ( Offset + DataSize > Plane.mDataSize )
+		{
+			std::stringstream Error;
+			Error << "Plane " << p << " (" << Plane.mDataSize << " bytes) too small to crop " << CroppedMeta << " at " << PlaneRoi.mX << "," << PlaneRoi.mY;
+			throw Soy::AssertException(Error);
+		}
+
+		//	a view of a view is still relative to the texture
+		PlaneRoi.mX += Plane.mRoi.mX;
+		PlaneRoi.mY += Plane.mRoi.mY;
+		Plane.mMeta = CroppedMeta;
+		Plane.mPixels += Offset;
+		Plane.mDataSize = DataSize;
+		Plane.mRowStride = Stride;
+		Plane.mRoi = PlaneRoi;
+	}
+}
+
+
+size_t PopCameraDevice::GetCopySize(const TPlaneView& Plane,size_t DstSize)
+{
+	auto RowBytes = Plane.mMeta.GetRowDataSize();
+	if ( Plane.GetRowStride() == RowBytes )
+		return std::min( DstSize, Plane.mDataSize );
+	auto Rows = RowBytes ? std::min( Plane.mMeta.GetHeight(), DstSize / RowBytes ) : 0;
+	return Rows * RowBytes;
+}
+
+void PopCameraDevice::CopyPlane(const TPlaneView& Plane,uint8_t* Dst,size_t CopySize)
+{
+	auto RowBytes = Plane.mMeta.GetRowDataSize();
+	auto Stride = Plane.GetRowStride();
+	if ( Stride == RowBytes )
+	{
+		CopyPixels( Dst, Plane.mPixels, CopySize );
+		return;
+	}
+	CopyPixelRows( Dst, RowBytes, Plane.mPixels, Stride, RowBytes, CopySize / RowBytes );
+}
+
+
+size_t PopCameraDevice::CopyPlanes(ArrayBridge<TPlaneView>&& PlaneSrcs,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneDsts,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo)
+{
+	json11::Json::array PlaneMetas;
+	size_t CopiedBytes = 0;
+	
+	for (auto p = 0; p <PlaneSrcs.GetSize(); p++)
+	{
+		auto& PlaneSrc = PlaneSrcs[p];
+		//	gr: get meta first, even if there's no buffer (for peek!)
+		auto& PlaneMeta = PlaneSrc.mMeta;
+		if ( JsonMeta )
+			PlaneMetas.push_back( GetPlaneJson( PlaneMeta, PlaneSrc.mRoi ) );
+		if ( FrameInfo && p < PopCameraDevice_MaxPlanes )
+		{
+			GetPlaneInfo( FrameInfo->Planes[p], PlaneMeta );
+			FrameInfo->PlaneCount = p+1;
+		}
+	
+		//	is there a buffer for this plane?
+		if (p >= PlaneDsts.GetSize())
+			continue;
+		auto* pPlaneDstArray = PlaneDsts[p];
+		if (!pPlaneDstArray)
+			continue;
+		
+		auto& PlaneDstArray = *pPlaneDstArray;
+		
+		//	copy as much as possible
+		auto CopySize = GetCopySize( PlaneSrc, PlaneDstArray.GetDataSize() );
+		PlaneDstArray.SetSize(CopySize, false);
+		CopyPlane( PlaneSrc, PlaneDstArray.GetArray(), CopySize );
+		CopiedBytes += CopySize;
+	}
+	if ( JsonMeta )
+		(*JsonMeta)["Planes"] = PlaneMetas;
+	return CopiedBytes;
+}
+
+PopCameraDevice::TOutputSteps PopCameraDevice::GetOutputSteps(ArrayBridge<TPlaneView>& Planes,const TOutputParams& Output)
+{
+	TOutputSteps Steps;
+	if ( Planes.IsEmpty() )
+		return Steps;
+
+	Steps.mConvert = IsConversionNeeded( Planes, Output.mFormat );
+	Steps.mImageMeta = Steps.mConvert ? GetConvertedMeta( Planes, Output.mFormat ) : Planes[0].mMeta;
+	if ( !Output.IsResize() )
+		return Steps;
+
+	auto ResizedMeta = GetResizedMeta( Steps.mImageMeta, Output.mWidth, Output.mHeight );
+	if ( ResizedMeta == Steps.mImageMeta )
+		return Steps;
+
+	if ( IsResizeNeeded( Planes, Output.mWidth, Output.mHeight ) )
+		Steps.mResize = true;
+	else if ( Steps.mConvert )
+		Steps.mResize = Steps.mResizeConverted = true;
+	else
+		return Steps;	//	eg. depth stays at its own size
+	Steps.mImageMeta = ResizedMeta;
+	return Steps;
+}
+
+const PopCameraDevice::TRoi& PopCameraDevice::GetOutputPlaneRoi(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,size_t PlaneIndex)
+{
+	return Steps.mConvert ? Planes[0].mRoi : Planes[PlaneIndex].mRoi;
+}
+
+void PopCameraDevice::GetOutputMetas(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,ArrayBridge<SoyPixelsMeta>&& Metas)
+{
+	if ( Steps.mConvert )
+	{
+		Metas.PushBack( Steps.mImageMeta );
+		return;
+	}
+
+	for ( auto p=0;	p<Planes.GetSize();	p++ )
+	{
+		auto& PlaneMeta = Planes[p].mMeta;
+		Metas.PushBack( Steps.mResize ? GetResizedPlaneMeta( Planes[0].mMeta, Steps.mImageMeta, PlaneMeta ) : PlaneMeta );
+	}
+}
+
+uint8_t* PopCameraDevice::GetScratchBuffer(size_t Size)
+{
+	thread_local std::vector<uint8_t> Scratch;
+	if ( Scratch.size() < Size )
+		Scratch.resize( Size );
+	return Scratch.data();
+}
+
+void PopCameraDevice::WriteOutputPlane(ArrayBridge<TPlaneView>& Planes,const TOutputSteps& Steps,const TOutputParams& Output,size_t PlaneIndex,const SoyPixelsMeta& OutputMeta,uint8_t* Dst,size_t Rows)
+{
+	auto DstStride = OutputMeta.GetRowDataSize();
+	if ( !Steps.mConvert )
+	{
+		ResizePlane( Planes[PlaneIndex], OutputMeta, Dst, DstStride, Rows, Output.mResizeFilter );
+		return;
+	}
+	if ( !Steps.mResize )
+	{
+		ConvertPixels( Planes, Output.mFormat, Dst, DstStride, Rows );
+		return;
+	}
+
+	if ( Steps.mResizeConverted )
+	{
+		//	convert the whole image, then resize that
+		TPlaneView Converted;
+		Converted.mMeta = GetConvertedMeta( Planes, Output.mFormat );
+		Converted.mDataSize = Converted.mMeta.GetDataSize();
+		Converted.mPixels = GetScratchBuffer( Converted.mDataSize );
+		ConvertPixels( Planes, Output.mFormat, Converted.mPixels, Converted.mMeta.GetRowDataSize(), Converted.mMeta.GetHeight() );
+		ResizePlane( Converted, OutputMeta, Dst, DstStride, Rows, Output.mResizeFilter );
+		return;
+	}
+
+	//	resize each plane, then convert the smaller planes
+	BufferArray<TPlaneView,10> ResizedPlanes;
+	size_t ScratchSize = 0;
+	for ( auto p=0;	p<Planes.GetSize();	p++ )
+	{
+		TPlaneView Resized;
+		Resized.mMeta = GetResizedPlaneMeta( Planes[0].mMeta, Steps.mImageMeta, Planes[p].mMeta );
+		Resized.mDataSize = Resized.mMeta.GetDataSize();
+		ScratchSize += Resized.mDataSize;
+		ResizedPlanes.PushBack( Resized );
+	}
+	auto* Scratch = GetScratchBuffer( ScratchSize );
+	for ( auto p=0;	p<ResizedPlanes.GetSize();	p++ )
+	{
+		auto& Resized = ResizedPlanes[p];
+		Resized.mPixels = Scratch;
+		Scratch += Resized.mDataSize;
+		ResizePlane( Planes[p], Resized.mMeta, Resized.mPixels, Resized.mMeta.GetRowDataSize(), Resized.mMeta.GetHeight(), Output.mResizeFilter );
+	}
+	auto ResizedPlanesBridge = GetArrayBridge(ResizedPlanes);
+	ConvertPixels( ResizedPlanesBridge, Output.mFormat, Dst, DstStride, Rows );
+}
+
+bool PopCameraDevice::IsOutputProcessed(ArrayBridge<TPlaneView>& Planes,const TOutputParams& Output)
+{
+	auto Steps = GetOutputSteps( Planes, Output );
+	return Steps.mConvert || Steps.mResize;
+}
+
+size_t PopCameraDevice::CopyOutputPlanes(ArrayBridge<TPlaneView>&& PlaneSrcs,const TOutputParams& Output,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneDsts,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo)
+{
+	auto Steps = GetOutputSteps( PlaneSrcs, Output );
+	if ( !Steps.mConvert && !Steps.mResize )
+		return CopyPlanes( std::move(PlaneSrcs), PlaneDsts, JsonMeta, FrameInfo );
+
+	BufferArray<SoyPixelsMeta,10> OutputMetas;
+	GetOutputMetas( PlaneSrcs, Steps, GetArrayBridge(OutputMetas) );
+
+	json11::Json::array PlaneMetas;
+	size_t CopiedBytes = 0;
+	for ( auto p=0;	p<OutputMetas.GetSize();	p++ )
+	{
+		auto& OutputMeta = OutputMetas[p];
+		if ( JsonMeta )
+			PlaneMetas.push_back( GetPlaneJson( OutputMeta, GetOutputPlaneRoi( PlaneSrcs, Steps, p ) ) );
+		if ( FrameInfo && p < PopCameraDevice_MaxPlanes )
+		{
+			GetPlaneInfo( FrameInfo->Planes[p], OutputMeta );
+			FrameInfo->PlaneCount = p+1;
+		}
+
+		auto* pPlaneDstArray = p < PlaneDsts.GetSize() ? PlaneDsts[p] : nullptr;
+		if ( !pPlaneDstArray )
+			continue;
+
+		//	write as many whole rows as fit
+		auto& PlaneDstArray = *pPlaneDstArray;
+		auto RowBytes = OutputMeta.GetRowDataSize();
+		auto Rows = RowBytes ? std::min( OutputMeta.GetHeight(), PlaneDstArray.GetDataSize() / RowBytes ) : 0;
+		PlaneDstArray.SetSize( Rows * RowBytes, false );
+		if ( Rows == 0 )
+			continue;
+		WriteOutputPlane( PlaneSrcs, Steps, Output, p, OutputMeta, PlaneDstArray.GetArray(), Rows );
+		CopiedBytes += Rows * RowBytes;
+	}
+	if ( JsonMeta )
+		(*JsonMeta)["Planes"] = PlaneMetas;
+	return CopiedBytes;
+}
+
+size_t PopCameraDevice::CopyPlanes(TPixelBuffer& PixelBuffer,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneBuffers,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output)
+{
+	//	gr: we're losing this transform. go back through PixelBuffer implementations
+	//		to see if we explicitly sometimes reveal this transform ONLY on locking the 
+	//		pixel buffer, or if it always comes from preexisting meta
+	float3x3 Transform;
+	BufferArray<SoyPixelsImpl*, 10> Textures;
+	PixelBuffer.Lock(GetArrayBridge(Textures), Transform);
+	try
+	{
+		BufferArray<TPlaneView,10> Planes;
+		auto TexturesBridge = GetArrayBridge(Textures);
+		auto Process = GetOutputPlaneViews( TexturesBridge, SplitPlanes, LayoutCache, Output, Planes );
+
+		//	image space crop for the whole frame; planes list their own
+		TRoi Roi = Planes.IsEmpty() ? TRoi() : Planes[0].mRoi;
+		if ( JsonMeta && !Roi.IsEmpty() )
+			(*JsonMeta)["Roi"] = GetJson(Roi);
+		if ( FrameInfo )
+			SetFrameInfoRoi( *FrameInfo, Roi );
+
+		size_t CopiedBytes = 0;
+		if ( Process )
+			CopiedBytes = CopyOutputPlanes( GetArrayBridge(Planes), *Output, PlaneBuffers, JsonMeta, FrameInfo );
+		else
+			CopiedBytes = CopyPlanes( GetArrayBridge(Planes), PlaneBuffers, JsonMeta, FrameInfo );
+		PixelBuffer.Unlock();
+		return CopiedBytes;
+	}
+	catch (...)
+	{
+		PixelBuffer.Unlock();
+		throw;
+	}
+}
+
+
+bool PopCameraDevice::GetOutputPlaneViews(ArrayBridge<SoyPixelsImpl*>& Textures,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output,BufferArray<TPlaneView,10>& Planes)
+{
+	//	conversion, resizing & cropping work on the split planes
+	bool Process = Output && !Output->IsPassthrough();
+	GetPlaneViews( Textures, SplitPlanes || Process, LayoutCache, GetArrayBridge(Planes) );
+	if ( !Process )
+		return false;
+
+	auto PlanesBridge = GetArrayBridge(Planes);
+	CropPlaneViews( PlanesBridge, Output->mRoi );
+	if ( IsOutputProcessed( PlanesBridge, *Output ) )
+		return true;
+
+	//	not converted or resized (eg. depth), so output as normal. Cropped planes can only be output split
+	if ( !SplitPlanes && Output->mRoi.IsEmpty() )
+	{
+		Planes.Clear(false);
+		GetPlaneViews( Textures, SplitPlanes, LayoutCache, GetArrayBridge(Planes) );
+	}
+	return false;
+}
+
+
+size_t PopCameraDevice::GetArenaPlaneSizes(ArrayBridge<TPlaneView>& Planes,bool Process,ArrayBridge<SoyPixelsMeta>& OutputMetas,std::array<size_t,PopCameraDevice_MaxPlanes>& PlaneSizes)
+{
+	auto PlaneCount = Process ? OutputMetas.GetSize() : Planes.GetSize();
+	if ( PlaneCount > PopCameraDevice_MaxPlanes )
+	{
+		std::stringstream Error;
+		Error << "Frame has " << PlaneCount << " planes, a frame descriptor only holds " << PopCameraDevice_MaxPlanes;
+		throw Soy::AssertException(Error);
+	}
+
+	size_t DataSize = 0;
+	for ( auto p=0;	p<PlaneCount;	p++ )
+	{
+		if ( Process )
+			PlaneSizes[p] = OutputMetas[p].GetRowDataSize() * OutputMetas[p].GetHeight();
+		else
+			PlaneSizes[p] = GetCopySize( Planes[p], std::numeric_limits<size_t>::max() );
+		DataSize += PlaneSizes[p];
+	}
+	return DataSize;
+}
+
+size_t PopCameraDevice::GetArenaDataSize(TPixelBuffer& PixelBuffer,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output)
+{
+	float3x3 Transform;
+	BufferArray<SoyPixelsImpl*, 10> Textures;
+	PixelBuffer.Lock(GetArrayBridge(Textures), Transform);
+	try
+	{
+		BufferArray<TPlaneView,10> Planes;
+		auto TexturesBridge = GetArrayBridge(Textures);
+		auto Process = GetOutputPlaneViews( TexturesBridge, SplitPlanes, LayoutCache, Output, Planes );
+
+		auto PlanesBridge = GetArrayBridge(Planes);
+		BufferArray<SoyPixelsMeta,10> OutputMetas;
+		if ( Process )
+			GetOutputMetas( PlanesBridge, GetOutputSteps( PlanesBridge, *Output ), GetArrayBridge(OutputMetas) );
+
+		std::array<size_t,PopCameraDevice_MaxPlanes> PlaneSizes;
+		auto OutputMetasBridge = GetArrayBridge(OutputMetas);
+		auto DataSize = GetArenaPlaneSizes( PlanesBridge, Process, OutputMetasBridge, PlaneSizes );
+		PixelBuffer.Unlock();
+		return DataSize;
+	}
+	catch (...)
+	{
+		PixelBuffer.Unlock();
+		throw;
+	}
+}
+
+void PopCameraDevice::CopyPlanesToArena(TPixelBuffer& PixelBuffer,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output,uint8_t* Arena,size_t ArenaSize,size_t& ArenaUsed,PopCameraDevice_FrameDescriptor& Descriptor,json11::Json::object& JsonMeta)
+{
+	float3x3 Transform;
+	BufferArray<SoyPixelsImpl*, 10> Textures;
+	PixelBuffer.Lock(GetArrayBridge(Textures), Transform);
+	try
+	{
+		BufferArray<TPlaneView,10> Planes;
+		auto TexturesBridge = GetArrayBridge(Textures);
+		auto Process = GetOutputPlaneViews( TexturesBridge, SplitPlanes, LayoutCache, Output, Planes );
+
+		auto PlanesBridge = GetArrayBridge(Planes);
+		TOutputSteps Steps;
+		BufferArray<SoyPixelsMeta,10> OutputMetas;
+		if ( Process )
+		{
+			Steps = GetOutputSteps( PlanesBridge, *Output );
+			GetOutputMetas( PlanesBridge, Steps, GetArrayBridge(OutputMetas) );
+		}
+
+		//	check everything fits before writing anything, rather than output part of a frame
+		std::array<size_t,PopCameraDevice_MaxPlanes> PlaneSizes;
+		auto OutputMetasBridge = GetArrayBridge(OutputMetas);
+		auto DataSize = GetArenaPlaneSizes( PlanesBridge, Process, OutputMetasBridge, PlaneSizes );
+		if ( DataSize > ArenaSize - ArenaUsed )
+		{
+			std::stringstream Error;
+			Error << "Frame needs " << DataSize << " bytes, only " << (ArenaSize - ArenaUsed) << " left in the arena";
+			throw Soy::AssertException(Error);
+		}
+
+		if ( !Planes.IsEmpty() && !Planes[0].mRoi.IsEmpty() )
+			JsonMeta["Roi"] = GetJson( Planes[0].mRoi );
+
+		json11::Json::array PlaneMetas;
+		auto PlaneCount = Process ? OutputMetas.GetSize() : Planes.GetSize();
+		for ( auto p=0;	p<PlaneCount;	p++ )
+		{
+			//	converting & resizing write straight into the arena
+			if ( Process )
+			{
+				auto& OutputMeta = OutputMetas[p];
+				PlaneMetas.push_back( GetPlaneJson( OutputMeta, GetOutputPlaneRoi( PlanesBridge, Steps, p ) ) );
+				if ( PlaneSizes[p] > 0 )
+					WriteOutputPlane( PlanesBridge, Steps, *Output, p, OutputMeta, Arena + ArenaUsed, OutputMeta.GetHeight() );
+			}
+			else
+			{
+				auto& Plane = Planes[p];
+				PlaneMetas.push_back( GetPlaneJson( Plane.mMeta, Plane.mRoi ) );
+				CopyPlane( Plane, Arena + ArenaUsed, PlaneSizes[p] );
+			}
+			Descriptor.PlaneOffsets[p] = static_cast<int32_t>(ArenaUsed);
+			Descriptor.PlaneSizes[p] = static_cast<int32_t>(PlaneSizes[p]);
+			Descriptor.PlaneCount = p+1;
+			ArenaUsed += PlaneSizes[p];
+		}
+		JsonMeta["Planes"] = PlaneMetas;
+		PixelBuffer.Unlock();
+	}
+	catch (...)
+	{
+		PixelBuffer.Unlock();
+		throw;
+	}
+}
+
+
+void PopCameraDevice::FramePlanes_UnitTests()
+{
+	auto Expect = [](bool Condition,const char* Description)
+	{
+		if ( Condition )
+			return;
+		std::stringstream Error;
+		Error << "FramePlanes test failed: " << Description;
+		throw std::runtime_error(Error.str());
+	};
+
+	//	views must match what SoyPixelsImpl::SplitPlanes gives, cached or not
+	SoyPixelsFormat::Type Formats[] = { SoyPixelsFormat::RGBA, SoyPixelsFormat::Yuv_8_88, SoyPixelsFormat::Yuv_8_8_8, SoyPixelsFormat::Depth16mm };
+	TPlaneLayoutCache LayoutCache;
+	for ( auto Format : Formats )
+	{
+		SoyPixels Pixels;
+		Pixels.mMeta = SoyPixelsMeta( 64, 32, Format );
+		Pixels.mArray.SetSize( Pixels.mMeta.GetDataSize() );
+		SoyPixelsImpl* Texture = &Pixels;
+		auto Textures = GetRemoteArray( &Texture, 1 );
+		auto TexturesBridge = GetArrayBridge(Textures);
+
+		BufferArray<std::shared_ptr<SoyPixelsImpl>,10> SplitPlanes;
+		Pixels.SplitPlanes( GetArrayBridge(SplitPlanes) );
+
+		for ( auto* Cache : { static_cast<TPlaneLayoutCache*>(nullptr), &LayoutCache, &LayoutCache } )
+		{
+			BufferArray<TPlaneView,10> Planes;
+			GetPlaneViews( TexturesBridge, true, Cache, GetArrayBridge(Planes) );
+			Expect( Planes.GetSize() == SplitPlanes.GetSize(), "plane count differs from SplitPlanes" );
+			for ( auto p=0;	p<Planes.GetSize();	p++ )
+			{
+				auto& SplitPlane = *SplitPlanes[p];
+				Expect( Planes[p].mMeta == SplitPlane.GetMeta(), "plane meta differs from SplitPlanes" );
+				Expect( Planes[p].mPixels == SplitPlane.GetPixelsArray().GetArray(), "plane pixels differ from SplitPlanes" );
+				Expect( Planes[p].mDataSize == SplitPlane.GetPixelsArray().GetDataSize(), "plane size differs from SplitPlanes" );
+			}
+		}
+
+		BufferArray<TPlaneView,10> WholePlanes;
+		GetPlaneViews( TexturesBridge, false, &LayoutCache, GetArrayBridge(WholePlanes) );
+		Expect( WholePlanes.GetSize() == 1, "unsplit should be one plane" );
+		Expect( WholePlanes[0].mMeta == Pixels.mMeta && WholePlanes[0].mDataSize == Pixels.mArray.GetDataSize(), "unsplit plane should be the whole texture" );
+	}
+
+	//	resized output keeps the planes, scaled together; converted output is one plane
+	{
+		SoyPixels Pixels;
+		Pixels.mMeta = SoyPixelsMeta( 64, 32, SoyPixelsFormat::Yuv_8_88 );
+		Pixels.mArray.SetSize( Pixels.mMeta.GetDataSize() );
+		for ( auto i=0;	i<Pixels.mArray.GetSize();	i++ )
+			Pixels.mArray[i] = static_cast<uint8_t>(i*7);
+		SoyPixelsImpl* Texture = &Pixels;
+		auto Textures = GetRemoteArray( &Texture, 1 );
+		auto TexturesBridge = GetArrayBridge(Textures);
+		BufferArray<TPlaneView,10> Planes;
+		GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(Planes) );
+
+		auto CopyOutput = [&](const TOutputParams& Output,PopCameraDevice_FrameInfo& FrameInfo)
+		{
+			Array<uint8_t> Dst0, Dst1;
+			Dst0.SetSize( Pixels.mMeta.GetDataSize() );
+			Dst1.SetSize( Pixels.mMeta.GetDataSize() );
+			auto Bridge0 = GetArrayBridge(Dst0);
+			auto Bridge1 = GetArrayBridge(Dst1);
+			BufferArray<ArrayBridge<uint8_t>*,2> Dsts;
+			Dsts.PushBack( &Bridge0 );
+			Dsts.PushBack( &Bridge1 );
+			auto DstsBridge = GetArrayBridge(Dsts);
+			FrameInfo = {};
+			return CopyOutputPlanes( GetArrayBridge(Planes), Output, DstsBridge, nullptr, &FrameInfo );
+		};
+
+		TOutputParams Resize;
+		Resize.mWidth = 32;
+		PopCameraDevice_FrameInfo FrameInfo;
+		auto PlanesBridge = GetArrayBridge(Planes);
+		Expect( IsOutputProcessed( PlanesBridge, Resize ), "resize should be processed" );
+		auto Copied = CopyOutput( Resize, FrameInfo );
+		Expect( FrameInfo.PlaneCount == 2, "resized nv12 should stay 2 planes" );
+		Expect( FrameInfo.Planes[0].Width == 32 && FrameInfo.Planes[0].Height == 16, "resized luma should be 32x16" );
+		Expect( FrameInfo.Planes[1].Width == 16 && FrameInfo.Planes[1].Height == 8, "resized chroma should be 16x8" );
+		Expect( Copied == 32*16 + 16*8*2, "resized planes should be copied whole" );
+
+		TOutputParams ResizeRgba = Resize;
+		ResizeRgba.mFormat = SoyPixelsFormat::RGBA;
+		Copied = CopyOutput( ResizeRgba, FrameInfo );
+		Expect( FrameInfo.PlaneCount == 1 && FrameInfo.Planes[0].Width == 32 && FrameInfo.Planes[0].Height == 16, "resized & converted should be one 32x16 plane" );
+		Expect( Copied == 32*16*4, "resized rgba should be copied whole" );
+
+		TOutputParams Same;
+		Same.mWidth = 64;
+		Expect( !IsOutputProcessed( PlanesBridge, Same ), "same size shouldn't be processed" );
+	}
+
+	//	crops widen to whole chroma samples, and copy packed to just that area
+	{
+		SoyPixels Pixels;
+		Pixels.mMeta = SoyPixelsMeta( 64, 32, SoyPixelsFormat::Yuv_8_88 );
+		Pixels.mArray.SetSize( Pixels.mMeta.GetDataSize() );
+		for ( auto i=0;	i<Pixels.mArray.GetSize();	i++ )
+			Pixels.mArray[i] = static_cast<uint8_t>(i*7);
+		SoyPixelsImpl* Texture = &Pixels;
+		auto Textures = GetRemoteArray( &Texture, 1 );
+		auto TexturesBridge = GetArrayBridge(Textures);
+		BufferArray<TPlaneView,10> Planes;
+		GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(Planes) );
+
+		TRoi Roi;
+		Roi.mX = 5;
+		Roi.mY = 3;
+		Roi.mWidth = 10;
+		Roi.mHeight = 7;
+		auto PlanesBridge = GetArrayBridge(Planes);
+		CropPlaneViews( PlanesBridge, Roi );
+		auto& Luma = Planes[0];
+		auto& Chroma = Planes[1];
+		Expect( Luma.mRoi.mX == 4 && Luma.mRoi.mY == 2 && Luma.mRoi.mWidth == 12 && Luma.mRoi.mHeight == 8, "nv12 luma crop should align to 2x2" );
+		Expect( Chroma.mRoi.mX == 2 && Chroma.mRoi.mY == 1 && Chroma.mRoi.mWidth == 6 && Chroma.mRoi.mHeight == 4, "nv12 chroma crop should be half the luma crop" );
+		Expect( Luma.mMeta.GetWidth() == 12 && Chroma.mMeta.GetHeight() == 4, "cropped meta should be the crop's size" );
+
+		Array<uint8_t> Dst0, Dst1;
+		Dst0.SetSize( Pixels.mMeta.GetDataSize() );
+		Dst1.SetSize( Pixels.mMeta.GetDataSize() );
+		auto Bridge0 = GetArrayBridge(Dst0);
+		auto Bridge1 = GetArrayBridge(Dst1);
+		BufferArray<ArrayBridge<uint8_t>*,2> Dsts;
+		Dsts.PushBack( &Bridge0 );
+		Dsts.PushBack( &Bridge1 );
+		auto DstsBridge = GetArrayBridge(Dsts);
+		auto Copied = CopyPlanes( GetArrayBridge(Planes), DstsBridge, nullptr, nullptr );
+		Expect( Copied == 12*8 + 6*4*2, "cropped planes should copy just the crop" );
+		for ( auto y=0;	y<8;	y++ )
+			for ( auto x=0;	x<12;	x++ )
+				Expect( Dst0[y*12+x] == Pixels.mArray[(y+2)*64 + x+4], "cropped luma copied from the wrong pixels" );
+		auto* ChromaSrc = Pixels.mArray.GetArray() + 64*32;
+		for ( auto y=0;	y<4;	y++ )
+			for ( auto x=0;	x<12;	x++ )
+				Expect( Dst1[y*12+x] == ChromaSrc[(y+1)*64 + x+4], "cropped chroma copied from the wrong pixels" );
+
+		//	depth crops exactly
+		SoyPixels Depth;
+		Depth.mMeta = SoyPixelsMeta( 64, 32, SoyPixelsFormat::Depth16mm );
+		Depth.mArray.SetSize( Depth.mMeta.GetDataSize() );
+		Texture = &Depth;
+		BufferArray<TPlaneView,10> DepthPlanes;
+		GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(DepthPlanes) );
+		auto DepthBridge = GetArrayBridge(DepthPlanes);
+		CropPlaneViews( DepthBridge, Roi );
+		auto& DepthRoi = DepthPlanes[0].mRoi;
+		Expect( DepthRoi.mX == 5 && DepthRoi.mY == 3 && DepthRoi.mWidth == 10 && DepthRoi.mHeight == 7, "depth crop shouldn't be aligned" );
+		Expect( DepthPlanes[0].mPixels == Depth.mArray.GetArray() + 3*64*2 + 5*2, "depth crop starts at the wrong pixel" );
+
+		bool Threw = false;
+		try
+		{
+			TRoi Outside;
+			Outside.mX = 64;
+			Outside.mWidth = Outside.mHeight = 4;
+			Planes.Clear(false);
+			Texture = &Pixels;
+			GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(Planes) );
+			CropPlaneViews( PlanesBridge, Outside );
+		}
+		catch(std::exception&)
+		{
+			Threw = true;
+		}
+		Expect( Threw, "crop outside the image should throw" );
+	}
+}
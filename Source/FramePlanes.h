@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <Array.hpp>
+#include <SoyPixels.h>
+#include "Json11/json11.hpp"
+#include "PopCameraDevice.h"
+
+class TPixelBuffer;
+
+namespace PopCameraDevice
+{
+	class TPlaneView;
+	class TPlaneLayout;
+	class TPlaneLayoutCache;
+	class TOutputParams;
+	class TRoi;
+
+	namespace TResizeFilter
+	{
+		enum Type
+		{
+			Area,		//	average of the source pixels covered, for downscaling
+			Bilinear,	//	blend of the nearest 2x2 source pixels; sharper but aliases below half size
+		};
+	}
+}
+
+
+//	per-frame helpers which turn a frame's pixel buffer into the planes & plane meta the C API outputs
+namespace PopCameraDevice
+{
+	void	GetObjectJson(json11::Json::object& Json,const SoyPixelsMeta& PlaneMeta);	//	one plane's meta
+	void	GetJson(json11::Json::object& Json,SoyPixelsMeta PixelMeta);				//	writes Planes[] for each plane of the format
+	void	GetPlaneInfo(PopCameraDevice_PlaneInfo& Info,const SoyPixelsMeta& PlaneMeta);
+
+	//	views point into the textures' pixels, so are only valid whilst the pixel buffer is locked.
+	//	LayoutCache is optional, without it each texture's layout is worked out again
+	void	GetPlaneViews(ArrayBridge<SoyPixelsImpl*>& Textures,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,ArrayBridge<TPlaneView>&& Planes);
+	//	narrows split plane views to Roi (in the first plane's pixels) without copying; rows keep the texture's stride.
+	//	Roi is expanded to whole chroma samples (and pixel pairs for packed 422) so every plane covers the same area,
+	//	and clipped to the image. Throws if it doesn't overlap the image
+	void	CropPlaneViews(ArrayBridge<TPlaneView>& Planes,const TRoi& Roi);
+	json11::Json::array	GetJson(const TRoi& Roi);		//	[x,y,width,height]
+
+	//	JsonMeta and FrameInfo are optional, so the json isn't built when the caller doesn't want it.
+	//	Returns bytes copied
+	size_t	CopyPlanes(ArrayBridge<TPlaneView>&& PlaneSrcs,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneDsts,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo);
+	//	false if the planes are output as-is; eg. depth, or already the output format & size
+	bool	IsOutputProcessed(ArrayBridge<TPlaneView>& Planes,const TOutputParams& Output);
+	//	converts and/or resizes the planes as they're copied, in whole rows. Converted output is one plane, resized-only output keeps the planes
+	size_t	CopyOutputPlanes(ArrayBridge<TPlaneView>&& PlaneSrcs,const TOutputParams& Output,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneDsts,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo);
+	size_t	CopyPlanes(TPixelBuffer& PixelBuffer,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneBuffers,json11::Json::object* JsonMeta,PopCameraDevice_FrameInfo* FrameInfo,bool SplitPlanes,TPlaneLayoutCache* LayoutCache=nullptr,const TOutputParams* Output=nullptr);
+
+	//	copy all planes to the end of the arena, and describe them. Throws (before writing anything)
+	//	if they don't all fit, or there are more planes than a descriptor holds
+	void	CopyPlanesToArena(TPixelBuffer& PixelBuffer,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output,uint8_t* Arena,size_t ArenaSize,size_t& ArenaUsed,PopCameraDevice_FrameDescriptor& Descriptor,json11::Json::object& JsonMeta);
+
+	//	bytes CopyPlanesToArena will write for this buffer; throws if it can't be output
+	size_t	GetArenaDataSize(TPixelBuffer& PixelBuffer,bool SplitPlanes,TPlaneLayoutCache* LayoutCache,const TOutputParams* Output);
+
+	void	FramePlanes_UnitTests();
+}
+
+
+//	region of an image or plane, in its pixels. Empty means the whole thing
+class PopCameraDevice::TRoi
+{
+public:
+	bool		IsEmpty() const	{	return mWidth == 0 || mHeight == 0;	}
+
+public:
+	size_t		mX = 0;
+	size_t		mY = 0;
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+};
+
+
+//	how frames are output when they're copied out; the defaults output frames as they are
+class PopCameraDevice::TOutputParams
+{
+public:
+	bool					IsPassthrough() const	{	return mFormat == SoyPixelsFormat::Invalid && !IsResize() && mRoi.IsEmpty();	}
+	bool					IsResize() const		{	return mWidth != 0 || mHeight != 0;	}
+
+public:
+	SoyPixelsFormat::Type	mFormat = SoyPixelsFormat::Invalid;	//	convert to this (see PixelConvert.h)
+	size_t					mWidth = 0;								//	resize to this (see PixelResize.h). 0 keeps the aspect ratio from the other
+	size_t					mHeight = 0;
+	TResizeFilter::Type		mResizeFilter = TResizeFilter::Area;
+	TRoi					mRoi;									//	crop to this (in the image's pixels) before converting & resizing
+};
+
+
+//	non-owning plane of a locked texture; replaces SoyPixelsImpl::SplitPlanes()'s
+//	heap allocated SoyPixelsRemote's in the pop path
+class PopCameraDevice::TPlaneView
+{
+public:
+	size_t			GetRowStride() const	{	return mRowStride ? mRowStride : mMeta.GetRowDataSize();	}
+
+public:
+	SoyPixelsMeta	mMeta;
+	uint8_t*		mPixels = nullptr;
+	size_t			mDataSize = 0;		//	bytes from mPixels to the end of the last row
+	size_t			mRowStride = 0;		//	0 when rows are packed; cropped views keep the texture's stride
+	TRoi			mRoi;				//	area of the texture's plane this view was cropped to
+};
+
+
+//	where each plane is in a texture's pixels. This only depends on the meta & data size, so is the same for every frame
+class PopCameraDevice::TPlaneLayout
+{
+public:
+	static constexpr size_t	MaxPlanes = PopCameraDevice_MaxPlanes;
+
+	void			Init(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes);	//	throws if the data is too small for the planes
+	bool			IsLayoutFor(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes) const;
+	size_t			GetDataSize() const;	//	bytes of all the planes
+
+public:
+	SoyPixelsMeta	mMeta;
+	size_t			mDataSize = 0;
+	bool			mSplitPlanes = false;
+	size_t			mPlaneCount = 0;
+	std::array<SoyPixelsMeta,MaxPlanes>	mPlaneMetas;
+	std::array<size_t,MaxPlanes>		mPlaneOffsets = {};
+	std::array<size_t,MaxPlanes>		mPlaneSizes = {};
+};
+
+
+//	recent layouts, owned by the device. A device only outputs a few metas (eg. colour & depth),
+//	so this is a tiny array searched under a lock, rather than a map which would allocate
+class PopCameraDevice::TPlaneLayoutCache
+{
+public:
+	static constexpr size_t	MaxLayouts = 4;
+
+	void			GetLayout(const SoyPixelsMeta& Meta,size_t DataSize,bool SplitPlanes,TPlaneLayout& Layout);
+
+private:
+	std::mutex		mLock;
+	std::array<TPlaneLayout,MaxLayouts>	mLayouts;
+	size_t			mLayoutCount = 0;
+	size_t			mNextReplace = 0;	//	when full, replace round robin
+};
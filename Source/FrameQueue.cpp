@@ -0,0 +1,652 @@
+#include "FrameQueue.h"
+#include "TCameraDevice.h"
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <magic_enum/include/magic_enum/magic_enum.hpp>
+
+
+namespace PopCameraDevice
+{
+	std::atomic<size_t>	gGlobalMaxFrameBytes = 0;
+	std::atomic<size_t>	gGlobalQueuedFrameBytes = 0;
+}
+
+void PopCameraDevice::SetGlobalMaxFrameBytes(size_t MaxBytes)
+{
+	gGlobalMaxFrameBytes = MaxBytes;
+}
+
+size_t PopCameraDevice::GetGlobalMaxFrameBytes()
+{
+	return gGlobalMaxFrameBytes;
+}
+
+size_t PopCameraDevice::GetGlobalQueuedFrameBytes()
+{
+	return gGlobalQueuedFrameBytes;
+}
+
+
+size_t PopCameraDevice::TFrameQueue::Push(std::shared_ptr<TFrame> Frame)
+{
+	auto CullOldest = true;
+	switch ( mParams.mPolicy )
+	{
+		case TQueuePolicy::DropOldest:
+		case TQueuePolicy::LatestOnly:
+			break;
+
+		case TQueuePolicy::DropNewest:
+			CullOldest = false;
+			break;
+
+		case TQueuePolicy::BlockProducer:
+			//	if we time out, the new frame gets dropped
+			WaitForSpace( Frame->mDataSize );
+			CullOldest = false;
+			break;
+	}
+
+	return Enqueue( Frame, CullOldest );
+}
+
+bool PopCameraDevice::TFrameQueue::WaitForSpace(size_t NewFrameBytes)
+{
+	auto HasSpace = [&]()	{	return !IsFull( GetSize(), NewFrameBytes );	};
+	if ( HasSpace() )
+		return true;
+
+	std::unique_lock<std::mutex> Lock(mSpaceLock);
+	mBlockedProducers++;
+	auto Timeout = std::chrono::milliseconds(mParams.mBlockTimeoutMs);
+	auto Result = mSpaceCondition.wait_for( Lock, Timeout, HasSpace );
+	mBlockedProducers--;
+	return Result;
+}
+
+bool PopCameraDevice::TFrameQueue::IsFull(size_t QueuedFrames,size_t NewFrameBytes)
+{
+	if ( QueuedFrames == 0 )
+		return false;
+
+	if ( QueuedFrames >= mMaxFrames )
+		return true;
+
+	if ( mParams.mMaxBytes != 0 && mQueuedBytes + NewFrameBytes > mParams.mMaxBytes )
+		return true;
+
+	//	under process-wide pressure each queue culls its own frames as it pushes
+	size_t GlobalMaxBytes = gGlobalMaxFrameBytes;
+	if ( GlobalMaxBytes != 0 && gGlobalQueuedFrameBytes + NewFrameBytes > GlobalMaxBytes )
+		return true;
+
+	return false;
+}
+
+void PopCameraDevice::TFrameQueue::OnFrameAdded(const TFrame& Frame)
+{
+	mQueuedBytes += Frame.mDataSize;
+	gGlobalQueuedFrameBytes += Frame.mDataSize;
+}
+
+void PopCameraDevice::TFrameQueue::OnFrameRemoved(const TFrame& Frame)
+{
+	OnFrameRemoved( Frame.mDataSize );
+}
+
+void PopCameraDevice::TFrameQueue::OnFrameRemoved(size_t DataSize)
+{
+	mQueuedBytes -= DataSize;
+	gGlobalQueuedFrameBytes -= DataSize;
+}
+
+void PopCameraDevice::TFrameQueue::OnFrameHeld(size_t DataSize)
+{
+	mQueuedBytes += DataSize;
+	gGlobalQueuedFrameBytes += DataSize;
+}
+
+void PopCameraDevice::TFrameQueue::OnFrameReleased(size_t DataSize)
+{
+	mQueuedBytes -= DataSize;
+	gGlobalQueuedFrameBytes -= DataSize;
+	OnFramePopped();
+}
+
+void PopCameraDevice::TFrameQueue::OnFramePopped()
+{
+	if ( mBlockedProducers == 0 )
+		return;
+
+	//	take the lock so we can't notify between the producer's check & wait
+	{
+		std::lock_guard<std::mutex> Lock(mSpaceLock);
+	}
+	mSpaceCondition.notify_all();
+}
+
+size_t PopCameraDevice::TFrameQueue::GetFrameBytes(const TFrame& Frame,const TGetFrameBytes& GetBytes)
+{
+	return GetBytes ? GetBytes(Frame) : Frame.mDataSize;
+}
+
+
+
+size_t PopCameraDevice::TFrameQueue_Mutex::Enqueue(std::shared_ptr<TFrame>& Frame,bool CullOldest)
+{
+	std::lock_guard<std::mutex> Lock(mFramesLock);
+	auto NewFrameBytes = Frame->mDataSize;
+	if ( !CullOldest && IsFull( mFrames.GetSize(), NewFrameBytes ) )
+		return 1;
+
+	size_t CullCount = 0;
+	while ( IsFull( mFrames.GetSize(), NewFrameBytes ) )
+	{
+		auto OldestFrame = mFrames.PopAt(0);
+		OnFrameRemoved( *OldestFrame );
+		CullCount++;
+	}
+
+	OnFrameAdded( *Frame );
+	mFrames.PushBack(Frame);
+	return CullCount;
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameQueue_Mutex::Peek()
+{
+	std::lock_guard<std::mutex> Lock(mFramesLock);
+	if ( mFrames.IsEmpty() )
+		return nullptr;
+	return mFrames[0];
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameQueue_Mutex::Pop()
+{
+	std::shared_ptr<TFrame> Frame;
+	{
+		std::lock_guard<std::mutex> Lock(mFramesLock);
+		if ( mFrames.IsEmpty() )
+			return nullptr;
+		Frame = mFrames.PopAt(0);
+		OnFrameRemoved( *Frame );
+	}
+	OnFramePopped();
+	return Frame;
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameQueue_Mutex::PopLatest(size_t& SkippedCount)
+{
+	SkippedCount = 0;
+	std::shared_ptr<TFrame> Frame;
+	{
+		std::lock_guard<std::mutex> Lock(mFramesLock);
+		if ( mFrames.IsEmpty() )
+			return nullptr;
+
+		for ( auto i=0;	i<mFrames.GetSize();	i++ )
+			OnFrameRemoved( *mFrames[i] );
+		SkippedCount = mFrames.GetSize()-1;
+		Frame = mFrames.PopBack();
+		mFrames.Clear(false);
+	}
+	OnFramePopped();
+	return Frame;
+}
+
+void PopCameraDevice::TFrameQueue_Mutex::PopMany(ArrayBridge<std::shared_ptr<TFrame>>& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetBytes)
+{
+	size_t PoppedBytes = 0;
+	size_t PopCount = 0;
+	{
+		std::lock_guard<std::mutex> Lock(mFramesLock);
+		while ( PopCount < mFrames.GetSize() && PopCount < MaxFrames )
+		{
+			auto& Frame = *mFrames[PopCount];
+			auto FrameBytes = GetFrameBytes( Frame, GetBytes );
+			if ( FrameBytes > MaxBytes - PoppedBytes )
+				break;
+			PoppedBytes += FrameBytes;
+			OnFrameRemoved( Frame );
+			Frames.PushBack( mFrames[PopCount] );
+			PopCount++;
+		}
+		mFrames.RemoveBlock( 0, PopCount );
+	}
+	if ( PopCount > 0 )
+		OnFramePopped();
+}
+
+size_t PopCameraDevice::TFrameQueue_Mutex::GetSize()
+{
+	std::lock_guard<std::mutex> Lock(mFramesLock);
+	return mFrames.GetSize();
+}
+
+
+
+PopCameraDevice::TFrameRing::TFrameRing(const TFrameQueueParams& Params) :
+	TFrameQueue		( Params ),
+	mHead			( 0 ),
+	mTail			( 0 ),
+	mPeekedState	( NoPeekedFrame ),
+	mPeekedDataSize	( 0 )
+{
+	//	always have more slots than frames, so the slot we're about to write to
+	//	has (almost always) been released by whoever claimed it
+	size_t SlotCount = 2;
+	while ( SlotCount <= mMaxFrames )
+		SlotCount <<= 1;
+
+	mSlots.reset( new TSlot[SlotCount] );
+	mSlotMask = SlotCount-1;
+	for ( auto i=0;	i<SlotCount;	i++ )
+		mSlots[i].mSequence.store(i,std::memory_order_relaxed);
+}
+
+bool PopCameraDevice::TFrameRing::TryPush(std::shared_ptr<TFrame>& Frame)
+{
+	auto Position = mTail.load(std::memory_order_relaxed);
+	auto& Slot = mSlots[Position & mSlotMask];
+	auto Sequence = Slot.mSequence.load(std::memory_order_acquire);
+
+	//	previous occupant hasn't been released yet
+	if ( Sequence != Position )
+		return false;
+
+	Slot.mFrame = std::move(Frame);
+	Slot.mSequence.store(Position+1,std::memory_order_release);
+	mTail.store(Position+1,std::memory_order_release);
+	return true;
+}
+
+bool PopCameraDevice::TFrameRing::TryPop(std::shared_ptr<TFrame>& Frame)
+{
+	auto Position = mHead.load(std::memory_order_relaxed);
+	while ( true )
+	{
+		auto& Slot = mSlots[Position & mSlotMask];
+		auto Sequence = Slot.mSequence.load(std::memory_order_acquire);
+		auto Difference = static_cast<int64_t>(Sequence) - static_cast<int64_t>(Position+1);
+
+		//	empty
+		if ( Difference < 0 )
+			return false;
+
+		//	someone else (consumer or culling producer) got here first, try again from the new head
+		if ( Difference > 0 )
+		{
+			Position = mHead.load(std::memory_order_relaxed);
+			continue;
+		}
+
+		//	claim the slot. On failure Position is updated to the current head
+		if ( !mHead.compare_exchange_weak(Position,Position+1,std::memory_order_relaxed) )
+			continue;
+
+		Frame = std::move(Slot.mFrame);
+		Slot.mSequence.store(Position + mSlotMask + 1,std::memory_order_release);
+		return true;
+	}
+}
+
+bool PopCameraDevice::TFrameRing::TryCullPeeked(size_t& DataSize)
+{
+	//	the frame itself stays with the consumer (who may be using it) until it sees it's been culled
+	int Expected = Peeked;
+	if ( !mPeekedState.compare_exchange_strong(Expected,PeekedCulled,std::memory_order_acq_rel) )
+		return false;
+	DataSize = mPeekedDataSize.load(std::memory_order_relaxed);
+	return true;
+}
+
+bool PopCameraDevice::TFrameRing::TakePeeked(std::shared_ptr<TFrame>& Frame)
+{
+	if ( !mPeekedFrame )
+		return false;
+
+	//	if the producer got there first, it's already uncounted; just let go of it
+	int Expected = Peeked;
+	bool Taken = mPeekedState.compare_exchange_strong(Expected,NoPeekedFrame,std::memory_order_acq_rel);
+	if ( Taken )
+		Frame = std::move(mPeekedFrame);
+	mPeekedFrame.reset();
+	mPeekedState.store(NoPeekedFrame,std::memory_order_release);
+	return Taken;
+}
+
+void PopCameraDevice::TFrameRing::SetPeeked(std::shared_ptr<TFrame>& Frame)
+{
+	mPeekedFrame = std::move(Frame);
+	mPeekedDataSize.store(mPeekedFrame->mDataSize,std::memory_order_relaxed);
+	mPeekedState.store(Peeked,std::memory_order_release);
+}
+
+size_t PopCameraDevice::TFrameRing::GetRingSize()
+{
+	//	read head first so tail is never behind it
+	auto Head = mHead.load(std::memory_order_acquire);
+	auto Tail = mTail.load(std::memory_order_acquire);
+	return static_cast<size_t>(Tail - Head);
+}
+
+size_t PopCameraDevice::TFrameRing::GetSize()
+{
+	auto Size = GetRingSize();
+	if ( mPeekedState.load(std::memory_order_acquire) == Peeked )
+		Size++;
+	return Size;
+}
+
+size_t PopCameraDevice::TFrameRing::Enqueue(std::shared_ptr<TFrame>& Frame,bool CullOldest)
+{
+	size_t CullCount = 0;
+	auto NewFrameBytes = Frame->mDataSize;
+
+	//	only the consumer can shrink the queue, so this check can't go stale in the wrong direction
+	//	(other queues can change the global byte count, but that's advisory)
+	if ( !CullOldest && IsFull( GetSize(), NewFrameBytes ) )
+		return 1;
+
+	//	drop oldest to make room; a peeked frame is older than anything in the ring
+	while ( IsFull( GetSize(), NewFrameBytes ) )
+	{
+		size_t PeekedDataSize = 0;
+		std::shared_ptr<TFrame> OldestFrame;
+		if ( TryCullPeeked(PeekedDataSize) )
+			OnFrameRemoved( PeekedDataSize );
+		else if ( TryPop(OldestFrame) )
+			OnFrameRemoved( *OldestFrame );
+		else
+			break;
+		CullCount++;
+	}
+
+	//	count the bytes before the frame is visible to the consumer, who may pop it straight away
+	auto& NewFrame = *Frame;
+	OnFrameAdded( NewFrame );
+
+	//	the only time this fails is if a consumer has claimed the slot we want
+	//	but not finished moving the frame out, which is a handful of instructions.
+	//	If the consumer got descheduled in that window, we drop the new frame rather than wait
+	static const int MaxPushAttempts = 100;
+	for ( auto Attempt=0;	Attempt<MaxPushAttempts;	Attempt++ )
+	{
+		if ( TryPush(Frame) )
+			return CullCount;
+		std::this_thread::yield();
+	}
+	OnFrameRemoved( NewFrame );
+	return CullCount+1;
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameRing::Peek()
+{
+	std::lock_guard<std::mutex> Lock(mConsumerLock);
+	if ( mPeekedFrame && mPeekedState.load(std::memory_order_acquire) == PeekedCulled )
+	{
+		mPeekedFrame.reset();
+		mPeekedState.store(NoPeekedFrame,std::memory_order_release);
+	}
+	if ( !mPeekedFrame )
+	{
+		std::shared_ptr<TFrame> Frame;
+		if ( !TryPop(Frame) )
+			return nullptr;
+		SetPeeked(Frame);
+	}
+	return mPeekedFrame;
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameRing::Pop()
+{
+	std::lock_guard<std::mutex> Lock(mConsumerLock);
+	std::shared_ptr<TFrame> Frame;
+	if ( !TakePeeked(Frame) && !TryPop(Frame) )
+		return nullptr;
+
+	OnFrameRemoved( *Frame );
+	OnFramePopped();
+	return Frame;
+}
+
+std::shared_ptr<PopCameraDevice::TFrame> PopCameraDevice::TFrameRing::PopLatest(size_t& SkippedCount)
+{
+	SkippedCount = 0;
+	std::lock_guard<std::mutex> Lock(mConsumerLock);
+	std::shared_ptr<TFrame> Frame;
+	if ( TakePeeked(Frame) )
+		OnFrameRemoved( *Frame );
+
+	//	drain the ring, keeping the last one. The producer can keep pushing while we do this,
+	//	which just means we return an even newer frame
+	std::shared_ptr<TFrame> NextFrame;
+	while ( TryPop(NextFrame) )
+	{
+		OnFrameRemoved( *NextFrame );
+		if ( Frame )
+			SkippedCount++;
+		Frame = std::move(NextFrame);
+		NextFrame.reset();
+	}
+
+	if ( !Frame )
+		return nullptr;
+
+	OnFramePopped();
+	return Frame;
+}
+
+void PopCameraDevice::TFrameRing::PopMany(ArrayBridge<std::shared_ptr<TFrame>>& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetBytes)
+{
+	std::lock_guard<std::mutex> Lock(mConsumerLock);
+	size_t PoppedBytes = 0;
+	size_t PopCount = 0;
+	while ( PopCount < MaxFrames )
+	{
+		std::shared_ptr<TFrame> Frame;
+		if ( !TakePeeked(Frame) && !TryPop(Frame) )
+			break;
+
+		//	doesn't fit; it's the oldest frame, so park it as peeked so it stays at the front
+		auto FrameBytes = GetFrameBytes( *Frame, GetBytes );
+		if ( FrameBytes > MaxBytes - PoppedBytes )
+		{
+			SetPeeked(Frame);
+			break;
+		}
+
+		PoppedBytes += FrameBytes;
+		OnFrameRemoved( *Frame );
+		Frames.PushBack( Frame );
+		PopCount++;
+	}
+
+	if ( PopCount > 0 )
+		OnFramePopped();
+}
+
+
+void PopCameraDevice::FrameQueue_UnitTests()
+{
+	auto MakeFrame = [](int Time,size_t DataSize=0)
+	{
+		std::shared_ptr<TFrame> Frame( new TFrame );
+		Frame->mFrameTime = SoyTime( std::chrono::milliseconds(Time) );
+		Frame->mDataSize = DataSize;
+		return Frame;
+	};
+
+	auto Expect = [](bool Condition,const std::string& QueueName,const char* Description)
+	{
+		if ( Condition )
+			return;
+		std::stringstream Error;
+		Error << QueueName << " failed: " << Description;
+		throw std::runtime_error(Error.str());
+	};
+
+	//	queue is 3 deep, push 5, check the right frames come out
+	auto Test = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName,int ExpectedFirst,int ExpectedLast)
+	{
+		size_t DropCount = 0;
+		for ( auto i=1;	i<=5;	i++ )
+			DropCount += Queue->Push( MakeFrame(i) );
+		auto ExpectedSize = ExpectedLast - ExpectedFirst + 1;
+		Expect( DropCount == 5 - ExpectedSize, QueueName, "wrong number of frames dropped" );
+		Expect( Queue->GetSize() == ExpectedSize, QueueName, "wrong number of frames queued" );
+
+		auto Peeked = Queue->Peek();
+		Expect( Peeked && Peeked->mFrameTime.GetTime() == ExpectedFirst, QueueName, "peek should be oldest remaining frame" );
+		Expect( Queue->GetSize() == ExpectedSize, QueueName, "peek shouldn't change size" );
+
+		for ( auto i=ExpectedFirst;	i<=ExpectedLast;	i++ )
+		{
+			auto Popped = Queue->Pop();
+			Expect( Popped && Popped->mFrameTime.GetTime() == i, QueueName, "frames popped out of order" );
+		}
+		Expect( Queue->Pop() == nullptr, QueueName, "expected queue to be empty" );
+		Expect( Queue->GetSize() == 0, QueueName, "expected size 0" );
+	};
+
+	auto TestPolicy = [&](TQueuePolicy::Type Policy,int ExpectedFirst,int ExpectedLast)
+	{
+		TFrameQueueParams Params;
+		Params.mPolicy = Policy;
+		Params.mMaxFrames = 3;
+		Params.mBlockTimeoutMs = 0;
+		std::string PolicyName( magic_enum::enum_name(Policy) );
+		Test( std::make_shared<TFrameQueue_Mutex>(Params), std::string("TFrameQueue_Mutex ") + PolicyName, ExpectedFirst, ExpectedLast );
+		Test( std::make_shared<TFrameRing>(Params), std::string("TFrameRing ") + PolicyName, ExpectedFirst, ExpectedLast );
+	};
+
+	TestPolicy( TQueuePolicy::DropOldest, 3, 5 );
+	TestPolicy( TQueuePolicy::DropNewest, 1, 3 );
+	TestPolicy( TQueuePolicy::LatestOnly, 5, 5 );
+	//	no consumer, so times out and drops the new frames
+	TestPolicy( TQueuePolicy::BlockProducer, 1, 3 );
+
+	//	a peeked frame is still the oldest; culling takes it first, and it counts towards the depth & bytes
+	auto TestPeekCulled = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName,int PushCount,int ExpectedFirst)
+	{
+		Queue->Push( MakeFrame(1,100) );
+		Queue->Peek();
+		for ( auto i=2;	i<=PushCount;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+		auto ExpectedSize = PushCount - ExpectedFirst + 1;
+		Expect( Queue->GetSize() == ExpectedSize, QueueName, "peeked frame should count towards depth" );
+		Expect( Queue->GetQueuedBytes() == ExpectedSize*100, QueueName, "peeked frame should count towards bytes" );
+		auto Front = Queue->Peek();
+		Expect( Front && Front->mFrameTime.GetTime() == ExpectedFirst, QueueName, "peek after a cull should be the oldest remaining frame" );
+		auto Popped = Queue->Pop();
+		Expect( Popped && Popped->mFrameTime.GetTime() == ExpectedFirst, QueueName, "peeked frame should be culled first" );
+		while ( Queue->Pop() )
+			;
+		Expect( Queue->GetQueuedBytes() == 0, QueueName, "bytes still counted after peek & cull" );
+	};
+	for ( auto Policy : { TQueuePolicy::DropOldest, TQueuePolicy::LatestOnly } )
+	{
+		TFrameQueueParams Params;
+		Params.mPolicy = Policy;
+		Params.mMaxFrames = 3;
+		auto ExpectedFirst = Policy == TQueuePolicy::LatestOnly ? 4 : 2;
+		std::string PolicyName( magic_enum::enum_name(Policy) );
+		TestPeekCulled( std::make_shared<TFrameQueue_Mutex>(Params), std::string("TFrameQueue_Mutex Peek ") + PolicyName, 4, ExpectedFirst );
+		TestPeekCulled( std::make_shared<TFrameRing>(Params), std::string("TFrameRing Peek ") + PolicyName, 4, ExpectedFirst );
+	}
+
+	//	push 5x100 byte frames into a queue with room for plenty of frames, but not bytes
+	auto TestBytes = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName,size_t ExpectedSize)
+	{
+		for ( auto i=1;	i<=5;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+		Expect( Queue->GetSize() == ExpectedSize, QueueName, "wrong number of frames queued for byte budget" );
+		Expect( Queue->GetQueuedBytes() == ExpectedSize*100, QueueName, "wrong number of bytes queued" );
+		Expect( Queue->Peek()->mFrameTime.GetTime() == 5-ExpectedSize+1, QueueName, "byte budget should cull oldest" );
+		while ( Queue->Pop() )
+			;
+		Expect( Queue->GetQueuedBytes() == 0, QueueName, "bytes still counted after popping everything" );
+	};
+
+	auto TestPopLatest = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName)
+	{
+		for ( auto i=1;	i<=5;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+		//	a peeked frame should be skipped too
+		Queue->Peek();
+		size_t SkippedCount = 0;
+		auto Latest = Queue->PopLatest(SkippedCount);
+		Expect( Latest && Latest->mFrameTime.GetTime() == 5, QueueName, "PopLatest should return newest frame" );
+		Expect( SkippedCount == 4, QueueName, "PopLatest wrong skip count" );
+		Expect( Queue->GetSize() == 0, QueueName, "PopLatest should empty queue" );
+		Expect( Queue->GetQueuedBytes() == 0, QueueName, "PopLatest left bytes counted" );
+		Expect( Queue->PopLatest(SkippedCount) == nullptr, QueueName, "PopLatest on empty queue should return null" );
+	};
+	TestPopLatest( std::make_shared<TFrameQueue_Mutex>(TFrameQueueParams()), "TFrameQueue_Mutex PopLatest" );
+	TestPopLatest( std::make_shared<TFrameRing>(TFrameQueueParams()), "TFrameRing PopLatest" );
+
+	auto TestPopMany = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName)
+	{
+		for ( auto i=1;	i<=5;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+
+		//	limited by bytes
+		Array<std::shared_ptr<TFrame>> Frames;
+		auto FramesBridge = GetArrayBridge(Frames);
+		Queue->PopMany( FramesBridge, 10, 250 );
+		Expect( Frames.GetSize() == 2, QueueName, "PopMany should stop when out of bytes" );
+		Expect( Frames[0]->mFrameTime.GetTime() == 1 && Frames[1]->mFrameTime.GetTime() == 2, QueueName, "PopMany out of order" );
+		Expect( Queue->GetSize() == 3, QueueName, "PopMany left wrong number of frames" );
+		Expect( Queue->Peek()->mFrameTime.GetTime() == 3, QueueName, "PopMany should leave frame that didn't fit at the front" );
+
+		//	limited by count
+		Queue->PopMany( FramesBridge, 2, 10000 );
+		Expect( Frames.GetSize() == 4 && Frames[3]->mFrameTime.GetTime() == 4, QueueName, "PopMany should stop at max frames" );
+		Queue->PopMany( FramesBridge, 10, 10000 );
+		Expect( Frames.GetSize() == 5 && Queue->GetSize() == 0, QueueName, "PopMany should drain queue" );
+		Expect( Queue->GetQueuedBytes() == 0, QueueName, "PopMany left bytes counted" );
+
+		//	sized as output (eg. converted to a bigger format) rather than as queued
+		for ( auto i=6;	i<=8;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+		auto GetOutputBytes = [](const TFrame& Frame)	{	return Frame.mDataSize * 2;	};
+		Queue->PopMany( FramesBridge, 10, 450, GetOutputBytes );
+		Expect( Frames.GetSize() == 7 && Queue->GetSize() == 1, QueueName, "PopMany should stop when out of output bytes" );
+		Queue->PopMany( FramesBridge, 10, 450, [](const TFrame&)	{	return std::numeric_limits<size_t>::max();	} );
+		Expect( Frames.GetSize() == 7 && Queue->GetSize() == 1, QueueName, "PopMany should leave a frame which can never fit" );
+		Queue->PopMany( FramesBridge, 10, 450, GetOutputBytes );
+		Expect( Frames.GetSize() == 8 && Queue->GetSize() == 0, QueueName, "PopMany should pop the frame left behind" );
+	};
+	TestPopMany( std::make_shared<TFrameQueue_Mutex>(TFrameQueueParams()), "TFrameQueue_Mutex PopMany" );
+	TestPopMany( std::make_shared<TFrameRing>(TFrameQueueParams()), "TFrameRing PopMany" );
+
+	TFrameQueueParams BytesParams;
+	BytesParams.mMaxBytes = 250;
+	TestBytes( std::make_shared<TFrameQueue_Mutex>(BytesParams), "TFrameQueue_Mutex MaxBytes", 2 );
+	TestBytes( std::make_shared<TFrameRing>(BytesParams), "TFrameRing MaxBytes", 2 );
+
+	//	held (leased) frames stay in the byte budget, so fewer frames fit until they're released
+	auto TestHeld = [&](std::shared_ptr<TFrameQueue> Queue,const std::string& QueueName)
+	{
+		Queue->Push( MakeFrame(1,100) );
+		auto Held = Queue->Pop();
+		Queue->OnFrameHeld( Held->mDataSize );
+		for ( auto i=2;	i<=4;	i++ )
+			Queue->Push( MakeFrame(i,100) );
+		Expect( Queue->GetSize() == 1 && Queue->GetQueuedBytes() == 200, QueueName, "held bytes should count towards the budget" );
+		Queue->OnFrameReleased( Held->mDataSize );
+		Queue->Push( MakeFrame(5,100) );
+		Expect( Queue->GetSize() == 2, QueueName, "released bytes should make room" );
+		while ( Queue->Pop() )
+			;
+		Expect( Queue->GetQueuedBytes() == 0, QueueName, "bytes still counted after release" );
+	};
+	TestHeld( std::make_shared<TFrameQueue_Mutex>(BytesParams), "TFrameQueue_Mutex Held" );
+	TestHeld( std::make_shared<TFrameRing>(BytesParams), "TFrameRing Held" );
+
+	auto OldGlobalMaxBytes = GetGlobalMaxFrameBytes();
+	SetGlobalMaxFrameBytes( GetGlobalQueuedFrameBytes() + 150 );
+	TestBytes( std::make_shared<TFrameQueue_Mutex>(TFrameQueueParams()), "TFrameQueue_Mutex GlobalMaxBytes", 1 );
+	TestBytes( std::make_shared<TFrameRing>(TFrameQueueParams()), "TFrameRing GlobalMaxBytes", 1 );
+	SetGlobalMaxFrameBytes( OldGlobalMaxBytes );
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <functional>
+#include <Array.hpp>
+
+
+namespace PopCameraDevice
+{
+	class TFrame;
+	class TFrameQueueParams;
+
+	//	bytes a frame takes up when popped; called with the queue locked, so keep it quick. Mustn't throw
+	typedef std::function<size_t(const TFrame&)>	TGetFrameBytes;
+	class TFrameQueue;
+	class TFrameQueue_Mutex;
+	class TFrameRing;
+
+	void	FrameQueue_UnitTests();
+
+	//	optional budget shared by every queue in the process, 0 = unlimited
+	void	SetGlobalMaxFrameBytes(size_t MaxBytes);
+	size_t	GetGlobalMaxFrameBytes();
+	size_t	GetGlobalQueuedFrameBytes();
+
+	//	what to do when a new frame arrives and the queue is full
+	namespace TQueuePolicy
+	{
+		enum Type
+		{
+			DropOldest,		//	cull the oldest frames (default)
+			DropNewest,		//	discard the new frame
+			LatestOnly,		//	queue depth of 1, always replaced by the newest frame. Lowest latency
+			BlockProducer,	//	capture thread waits for the consumer (up to a timeout) so recording is lossless
+		};
+	}
+}
+
+
+class PopCameraDevice::TFrameQueueParams
+{
+public:
+	TQueuePolicy::Type	mPolicy = TQueuePolicy::DropOldest;
+	size_t				mMaxFrames = 13;
+	size_t				mBlockTimeoutMs = 1000;	//	BlockProducer drops the new frame after this
+	size_t				mMaxBytes = 0;			//	pixel data allowed in the queue, 0 = unlimited
+
+	size_t				GetMaxFrames() const	{	return (mPolicy == TQueuePolicy::LatestOnly) ? 1 : std::max<size_t>(mMaxFrames,1);	}
+};
+
+
+//	frames waiting to be peeked/popped by the user.
+//	Push() is called from the backend's capture thread(s), Peek()/Pop() from callers of the C API
+class PopCameraDevice::TFrameQueue
+{
+public:
+	TFrameQueue(const TFrameQueueParams& Params) :
+		mParams		( Params ),
+		mMaxFrames	( Params.GetMaxFrames() )
+	{
+	}
+	virtual ~TFrameQueue()	{}
+
+	//	applies the queue policy, returns number of frames dropped (old or the new one)
+	size_t							Push(std::shared_ptr<TFrame> Frame);
+	virtual std::shared_ptr<TFrame>	Peek()=0;
+	virtual std::shared_ptr<TFrame>	Pop()=0;
+	virtual std::shared_ptr<TFrame>	PopLatest(size_t& SkippedCount)=0;	//	pop newest frame, discarding all older ones
+	//	pop oldest frames in order until MaxFrames, or the next frame would take the total over MaxBytes.
+	//	Frames are sized by GetFrameBytes if given (eg. as they'll be output), otherwise their pixel data
+	virtual void					PopMany(ArrayBridge<std::shared_ptr<TFrame>>& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetFrameBytes=nullptr)=0;
+	virtual size_t					GetSize()=0;
+	size_t							GetQueuedBytes() const	{	return mQueuedBytes;	}
+	//	popped frames which still hold their pixels (LockNextFrame leases) stay in the byte budgets until they're released
+	void							OnFrameHeld(size_t DataSize);
+	void							OnFrameReleased(size_t DataSize);
+	const TFrameQueueParams&		GetParams() const	{	return mParams;	}
+
+protected:
+	//	if full, either cull oldest frames to make room, or reject the new frame (returns 1)
+	virtual size_t					Enqueue(std::shared_ptr<TFrame>& Frame,bool CullOldest)=0;
+	void							OnFramePopped();		//	wake a blocked producer
+	static size_t					GetFrameBytes(const TFrame& Frame,const TGetFrameBytes& GetBytes);
+
+	//	full if over the frame count, our byte budget, or the process budget.
+	//	An empty queue is never full, so a single frame bigger than the budget still gets through
+	bool							IsFull(size_t QueuedFrames,size_t NewFrameBytes);
+	void							OnFrameAdded(const TFrame& Frame);
+	void							OnFrameRemoved(const TFrame& Frame);
+	void							OnFrameRemoved(size_t DataSize);
+
+private:
+	bool							WaitForSpace(size_t NewFrameBytes);
+
+protected:
+	TFrameQueueParams				mParams;
+	size_t							mMaxFrames = 0;
+	std::atomic<size_t>				mQueuedBytes = 0;
+
+private:
+	//	only used by the BlockProducer policy
+	std::mutex						mSpaceLock;
+	std::condition_variable			mSpaceCondition;
+	std::atomic<int>				mBlockedProducers = 0;
+};
+
+
+//	original queue; safe for backends which push from multiple threads
+class PopCameraDevice::TFrameQueue_Mutex : public TFrameQueue
+{
+public:
+	TFrameQueue_Mutex(const TFrameQueueParams& Params) :
+		TFrameQueue	( Params )
+	{
+	}
+
+	virtual std::shared_ptr<TFrame>	Peek() override;
+	virtual std::shared_ptr<TFrame>	Pop() override;
+	virtual std::shared_ptr<TFrame>	PopLatest(size_t& SkippedCount) override;
+	virtual void					PopMany(ArrayBridge<std::shared_ptr<TFrame>>& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetFrameBytes=nullptr) override;
+	virtual size_t					GetSize() override;
+
+protected:
+	virtual size_t					Enqueue(std::shared_ptr<TFrame>& Frame,bool CullOldest) override;
+
+private:
+	std::mutex						mFramesLock;
+	Array<std::shared_ptr<TFrame>>	mFrames;
+};
+
+
+//	bounded lock-free ring for backends which push from a single thread.
+//	Neither side ever takes a lock the other holds; when full, the producer drops the
+//	oldest frame itself (it acts as a second consumer of the ring, so slots
+//	are claimed with a per-slot sequence number rather than a plain head/tail)
+class PopCameraDevice::TFrameRing : public TFrameQueue
+{
+public:
+	TFrameRing(const TFrameQueueParams& Params);
+
+	virtual std::shared_ptr<TFrame>	Peek() override;
+	virtual std::shared_ptr<TFrame>	Pop() override;
+	virtual std::shared_ptr<TFrame>	PopLatest(size_t& SkippedCount) override;
+	virtual void					PopMany(ArrayBridge<std::shared_ptr<TFrame>>& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetFrameBytes=nullptr) override;
+	virtual size_t					GetSize() override;
+
+protected:
+	virtual size_t					Enqueue(std::shared_ptr<TFrame>& Frame,bool CullOldest) override;
+
+private:
+	bool							TryPush(std::shared_ptr<TFrame>& Frame);	//	producer only
+	bool							TryPop(std::shared_ptr<TFrame>& Frame);		//	consumer or producer (when culling)
+	bool							TryCullPeeked(size_t& DataSize);				//	producer only
+	bool							TakePeeked(std::shared_ptr<TFrame>& Frame);		//	consumer only, false if there's none or it was culled
+	void							SetPeeked(std::shared_ptr<TFrame>& Frame);		//	consumer only
+	size_t							GetRingSize();
+
+	class TSlot
+	{
+	public:
+		std::atomic<uint64_t>		mSequence;
+		std::shared_ptr<TFrame>		mFrame;
+	};
+
+	std::unique_ptr<TSlot[]>		mSlots;
+	uint64_t						mSlotMask = 0;
+	alignas(64) std::atomic<uint64_t>	mHead;	//	next slot to read
+	alignas(64) std::atomic<uint64_t>	mTail;	//	next slot to write, only written by producer
+
+	//	peeking moves the frame out of the ring so the producer can't cull it from under us.
+	//	It's still the oldest frame, counted in the size & bytes, so when culling the producer takes it first,
+	//	by switching mPeekedState from Peeked to Culled; the consumer then lets go of the frame on its next call.
+	//	mConsumerLock is only shared between consumers (eg. peek in a callback, pop on another thread), never the producer
+	enum TPeekedState : int
+	{
+		NoPeekedFrame,
+		Peeked,
+		PeekedCulled,
+	};
+	std::mutex						mConsumerLock;
+	std::shared_ptr<TFrame>			mPeekedFrame;		//	consumer only
+	std::atomic<int>				mPeekedState;
+	std::atomic<size_t>				mPeekedDataSize;	//	written before mPeekedState becomes Peeked, so the producer can uncount it
+};
@@ -2,6 +2,7 @@
 #include "libusb.h"
 #include "libfreenect.h"
 #include "PopCameraDevice.h"	//	params keys
+#include "Trace.h"
 
 #if defined(TARGET_WINDOWS)
 //	libusb uses some stdio functions which are now inlined. This library provides a function to link to
@@ -38,7 +39,7 @@ namespace Freenect
 	void					OnDepthFrame(freenect_device *dev, void *rgb, uint32_t timestamp);
 	void					LogCallback(freenect_context *dev, freenect_loglevel level, const char *msg);
 	const char*				LogLevelToString(freenect_loglevel level);
-	SoyTime					TimestampToMs(uint32_t Timestamp);
+	uint64_t				TicksToNs(uint64_t Ticks);	//	video clock ticks to nanoseconds
 	
 	bool		IsOkay(int Result,const std::string& Context,bool Throw=true);
 	std::string	GetErrorString(int Result);
@@ -152,6 +153,8 @@ public:
 	void			Open();			//	if there's no device, re-open given our known serial
 	SoyPixelsRemote	GetDepthPixels(const uint8_t* Pixels);
 	SoyPixelsRemote	GetColourPixels(const uint8_t* Pixels);
+	//	freenect's 32bit timestamps wrap every ~71.6s, so extend them to 64bit ticks on this device's clock
+	uint64_t		GetTimestampNs(uint32_t Timestamp);
 
 	//	todo; can we compare two device pointers?
 	bool			operator==(const std::string& Serial) const	{	return mSerial == Serial;	}
@@ -172,13 +175,16 @@ private:
 	//	these are for re-opening
 	SoyPixelsMeta		mDepthFormat;
 	SoyPixelsMeta		mColourFormat;
+
+	bool				mHasTimestamp = false;
+	uint64_t			mTimestampTicks = 0;	//	newest timestamp, extended
 };
 
 class Freenect::TFrameListener
 {
 public:
 	std::string		mSerial;
-	std::function<void(const SoyPixelsImpl&,SoyTime)>	mOnFrame;
+	std::function<void(const SoyPixelsImpl&,uint64_t)>	mOnFrame;	//	pixels, device time (ns)
 };
 
 
@@ -194,8 +200,8 @@ public:
 	
 	void				EnumDevices(std::function<void(const std::string&,ArrayBridge<std::string>&& Formats)> Enum);
 	TDevice&			OpenDevice(const std::string& Serial);
-	void				OnDepthFrame(freenect_device& Device,const uint8_t* Bytes,SoyTime Timestamp);
-	void				OnColourFrame(freenect_device& Device,const uint8_t* Bytes,SoyTime Timestamp);
+	void				OnDepthFrame(freenect_device& Device,const uint8_t* Bytes,uint32_t Timestamp);
+	void				OnColourFrame(freenect_device& Device,const uint8_t* Bytes,uint32_t Timestamp);
 	TDevice&			GetDevice(freenect_device& Device);
 
 private:
@@ -203,8 +209,8 @@ private:
 	void				ReacquireDevices();
 	
 public:
-	std::function<void(TDevice&,const SoyPixelsImpl&,SoyTime)>	mOnDepthFrame;
-	std::function<void(TDevice&,const SoyPixelsImpl&,SoyTime)>	mOnColourFrame;
+	std::function<void(TDevice&,const SoyPixelsImpl&,uint64_t)>	mOnDepthFrame;	//	timestamps are device time in ns
+	std::function<void(TDevice&,const SoyPixelsImpl&,uint64_t)>	mOnColourFrame;
 
 private:
 	std::recursive_mutex	mDeviceLock;	//	we were getting deadlock from depthcallback, whilst opening a device, so set to recursive
@@ -223,7 +229,7 @@ public:
 	void							FailRunningThreads();	//	for process exit, threads have gone, but we are unaware
 
 private:
-	void							OnFrame(TDevice& Device,const SoyPixelsImpl& Pixels,SoyTime Timestamp);
+	void							OnFrame(TDevice& Device,const SoyPixelsImpl& Pixels,uint64_t TimestampNs);
 
 public:
 	//	 lock this!
@@ -254,10 +260,9 @@ void Freenect::OnDepthFrame(freenect_device* dev, void *rgb, uint32_t timestamp)
 	
 	auto* FreenectPtr = freenect_get_user(dev);
 	auto& Freenect = *reinterpret_cast<TFreenect*>( FreenectPtr );
-	SoyTime Timecode = Freenect::TimestampToMs( timestamp );
 
 	auto* rgb8 = static_cast<uint8_t*>(rgb);
-	Freenect.OnDepthFrame( *dev, rgb8, Timecode );
+	Freenect.OnDepthFrame( *dev, rgb8, timestamp );
 }
 
 
@@ -271,20 +276,21 @@ void Freenect::OnColourFrame(freenect_device* dev, void *rgb, uint32_t timestamp
 	
 	auto* FreenectPtr = freenect_get_user(dev);
 	auto& Freenect = *reinterpret_cast<TFreenect*>( FreenectPtr );
-	SoyTime Timecode = Freenect::TimestampToMs( timestamp );
 	
 	auto* rgb8 = static_cast<uint8_t*>(rgb);
-	Freenect.OnColourFrame( *dev, rgb8, Timecode );
+	Freenect.OnColourFrame( *dev, rgb8, timestamp );
 }
 
 
-SoyTime Freenect::TimestampToMs(uint32_t Timestamp)
+uint64_t Freenect::TicksToNs(uint64_t Ticks)
 {
 	//	according to here, timestamp is in video clock cycles at 60(59.xx)... or 24hz?
 	//	https://groups.google.com/forum/#!topic/openkinect/dQVaksXrNQ0
-	int HzToMs = (59952460/1000);
-	uint64 TimestampMs = Timestamp / HzToMs;
-	return SoyTime( std::chrono::milliseconds(TimestampMs) );
+	//	split into seconds & remainder so extended ticks don't overflow when scaled to nanoseconds
+	uint64_t ClockHz = 59952460;
+	auto Seconds = Ticks / ClockHz;
+	auto RemainderTicks = Ticks % ClockHz;
+	return (Seconds * 1000000000ull) + (RemainderTicks * 1000000000ull) / ClockHz;
 }
 
 
@@ -466,6 +472,8 @@ void Freenect::TDevice::Open()
 		return;
 
 	mDevice = mOpenFunc(mSerial);
+	//	a re-opened device's clock starts again
+	mHasTimestamp = false;
 
 	//	re-enable streaming
 	if (mDepthFormat.IsValid())
@@ -598,6 +606,27 @@ SoyPixelsRemote Freenect::TDevice::GetColourPixels(const uint8_t* PixelBytes_con
 	return Pixels;
 }
 
+uint64_t Freenect::TDevice::GetTimestampNs(uint32_t Timestamp)
+{
+	if ( !mHasTimestamp )
+	{
+		mTimestampTicks = Timestamp;
+		mHasTimestamp = true;
+		return TicksToNs( mTimestampTicks );
+	}
+
+	//	colour & depth share the clock but arrive slightly out of order, so step from the newest
+	//	timestamp by the signed difference; going forward past 2^32 carries into the high bits
+	auto Delta = static_cast<int32_t>( Timestamp - static_cast<uint32_t>(mTimestampTicks) );
+	if ( Delta < 0 )
+	{
+		auto Behind = static_cast<uint64_t>( -static_cast<int64_t>(Delta) );
+		return TicksToNs( Behind > mTimestampTicks ? 0 : mTimestampTicks - Behind );
+	}
+	mTimestampTicks += Delta;
+	return TicksToNs( mTimestampTicks );
+}
+
 
 
 
@@ -825,33 +854,35 @@ Freenect::TDevice& Freenect::TFreenect::OpenDevice(const std::string& Serial)
 
 
 
-void Freenect::TFreenect::OnDepthFrame(freenect_device& DevicePtr,const uint8_t* Bytes,SoyTime Timestamp)
+void Freenect::TFreenect::OnDepthFrame(freenect_device& DevicePtr,const uint8_t* Bytes,uint32_t Timestamp)
 {
 	auto& Device = GetDevice( DevicePtr );
+	auto TimestampNs = Device.GetTimestampNs( Timestamp );
 	
 	//	format the bytes
 	auto Pixels = Device.GetDepthPixels( Bytes );
 	
 	//	do callback
 	if ( this->mOnDepthFrame )
-		this->mOnDepthFrame( Device, Pixels, Timestamp );
+		this->mOnDepthFrame( Device, Pixels, TimestampNs );
 }
 
 
-void Freenect::TFreenect::OnColourFrame(freenect_device& DevicePtr,const uint8_t* Bytes,SoyTime Timestamp)
+void Freenect::TFreenect::OnColourFrame(freenect_device& DevicePtr,const uint8_t* Bytes,uint32_t Timestamp)
 {
 	auto& Device = GetDevice( DevicePtr );
+	auto TimestampNs = Device.GetTimestampNs( Timestamp );
 	
 	//	format the bytes
 	auto Pixels = Device.GetColourPixels( Bytes );
 	
 	//	do callback
 	if ( this->mOnColourFrame )
-		this->mOnColourFrame( Device, Pixels, Timestamp );
+		this->mOnColourFrame( Device, Pixels, TimestampNs );
 }
 
 
-void Freenect::TContext::OnFrame(TDevice& Device,const SoyPixelsImpl& Pixels,SoyTime Timestamp)
+void Freenect::TContext::OnFrame(TDevice& Device,const SoyPixelsImpl& Pixels,uint64_t TimestampNs)
 {
 	//	call all listeners
 	//	todo: replace with enum which locks internally
@@ -864,7 +895,7 @@ void Freenect::TContext::OnFrame(TDevice& Device,const SoyPixelsImpl& Pixels,Soy
 		if ( !Listener.mOnFrame )
 			continue;
 		
-		Listener.mOnFrame( Pixels, Timestamp );
+		Listener.mOnFrame( Pixels, TimestampNs );
 	}
 }
 
@@ -1389,7 +1420,7 @@ SoyPixelsFormat::Type Freenect::GetFormat(freenect_depth_format Format)
 #if defined(LIBFREENECT)
 void Freenect::OnVideoFrame(freenect_device *dev, void *rgb, uint32_t timestamp)
 {
-	SoyTime Timecode = Freenect::TimestampToMs( timestamp );
+	SoyTime Timecode( std::chrono::nanoseconds( Freenect::TicksToNs( timestamp ) ) );
 
 	auto* usr = freenect_get_user(dev);
 	auto DeviceId = reinterpret_cast<uint64>( usr );
@@ -1437,7 +1468,7 @@ void Freenect::OnVideoFrame(freenect_device *dev, void *rgb, uint32_t timestamp)
 #if defined(LIBFREENECT)
 void Freenect::OnDepthFrame(freenect_device *dev, void *rgb, uint32_t timestamp)
 {
-	SoyTime Timecode = Freenect::TimestampToMs( timestamp );
+	SoyTime Timecode( std::chrono::nanoseconds( Freenect::TicksToNs( timestamp ) ) );
 
 	auto* usr = freenect_get_user(dev);
 	auto DeviceId = reinterpret_cast<uint64>( usr );
@@ -1609,13 +1640,17 @@ void Freenect::TDepthPixelBuffer::Unlock()
 */
 
 
-Freenect::TSource::TSource(std::string Serial,json11::Json& Params)
+Freenect::TSource::TSource(std::string Serial,json11::Json& Params) :
+	TDevice	( Params )
 {
 	if ( !Soy::StringTrimLeft( Serial, Freenect::DeviceName_Prefix, true ) )
 		throw PopCameraDevice::TInvalidNameException();
 
 	TCaptureParams CaptureParams(Params);
 
+	//	all frames arrive on the freenect context's thread
+	EnableLockFreeFrameQueue();
+
 	auto& Context = GetContext();
 
 	//SoyPixelsMeta Meta( 640, 480, SoyPixelsFormat::uyvy_8888 );
@@ -1623,9 +1658,9 @@ Freenect::TSource::TSource(std::string Serial,json11::Json& Params)
 	SoyPixelsMeta DepthFormat( 640, 480, CaptureParams.mDepthFormat );
 	mListener = Context.CreateListener( Serial, ColourFormat, DepthFormat );
 	
-	mListener->mOnFrame = [&](const SoyPixelsImpl& Frame,SoyTime Timestamp)
+	mListener->mOnFrame = [&](const SoyPixelsImpl& Frame,uint64_t TimestampNs)
 	{
-		this->OnFrame( Frame, Timestamp );
+		this->OnFrame( Frame, TimestampNs );
 	};
 }
 
@@ -1641,8 +1676,10 @@ void Freenect::TSource::EnableFeature(PopCameraDevice::TFeature::Type Feature,bo
 	throw Soy::AssertException("Freenect device doesn't support feature");
 }
 
-void Freenect::TSource::OnFrame(const SoyPixelsImpl& Frame,SoyTime Timestamp)
+void Freenect::TSource::OnFrame(const SoyPixelsImpl& Frame,uint64_t TimestampNs)
 {
+	TRACE_SCOPE("Freenect::TSource::OnFrame");
+	auto CallbackTimeNs = PopCameraDevice::GetHostTimeNs();
 	float3x3 Transform;
 	std::shared_ptr<TPixelBuffer> PixelBuffer( new TDumbPixelBuffer( Frame, Transform ) );
 	
@@ -1702,7 +1739,10 @@ void Freenect::TSource::OnFrame(const SoyPixelsImpl& Frame,SoyTime Timestamp)
 	
 	Meta["Camera"] = CameraMeta;
 	
-	this->PushFrame( PixelBuffer, Timestamp, Meta );
+	//	freenect's timestamp is the device's clock, so is also our device time.
+	//	Passed as nanoseconds, as SoyTime is only millisecond accurate
+	SoyTime Timestamp( std::chrono::nanoseconds(TimestampNs) );
+	this->PushFrame( PixelBuffer, Timestamp, Meta, TimestampNs, 0, CallbackTimeNs );
 }
 
 
@@ -40,7 +40,7 @@ public:
 	virtual void	EnableFeature(PopCameraDevice::TFeature::Type Feature,bool Enable) override;
 	
 private:
-	void			OnFrame(const SoyPixelsImpl& Frame,SoyTime Timestamp);
+	void			OnFrame(const SoyPixelsImpl& Frame,uint64_t TimestampNs);	//	device time
 	
 private:
 	std::shared_ptr<TFrameListener>	mListener;
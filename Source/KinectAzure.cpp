@@ -7,6 +7,7 @@
 #include <cmath>	//	fabsf
 #include <SoyFilesystem.h>
 #include "PopCameraDevice.h"
+#include "Trace.h"
 
 //	these macros are missing on linux
 #if defined(TARGET_LINUX)
@@ -451,7 +452,7 @@ k4a_image_format_t KinectAzure::GetColourFormat(SoyPixelsFormat::Type Format)
 class KinectAzure::TPixelReader : public TFrameReader
 {
 public:
-	TPixelReader(size_t DeviceIndex, bool KeepAlive, bool VerboseDebug, std::function<void(std::shared_ptr<TPixelBuffer>&,SoyTime, json11::Json::object&)> OnFrame, k4a_depth_mode_t DepthMode, k4a_colour_mode_t ColourMode,k4a_fps_t FrameRate, k4a_wired_sync_mode_t SyncMode) :
+	TPixelReader(size_t DeviceIndex, bool KeepAlive, bool VerboseDebug, std::function<void(std::shared_ptr<TPixelBuffer>&,SoyTime,json11::Json::object&,uint64_t,uint64_t,uint64_t)> OnFrame, k4a_depth_mode_t DepthMode, k4a_colour_mode_t ColourMode,k4a_fps_t FrameRate, k4a_wired_sync_mode_t SyncMode) :
 		TFrameReader	(DeviceIndex, KeepAlive, VerboseDebug),
 		mOnNewFrame		(OnFrame),
 		mDepthMode		( DepthMode ),
@@ -470,7 +471,7 @@ private:
 	virtual k4a_fps_t			GetFrameRate() override { return mFrameRate; }
 	virtual k4a_wired_sync_mode_t	GetSyncMode() override { return mSyncMode; }
 
-	std::function<void(std::shared_ptr<TPixelBuffer>&,SoyTime,json11::Json::object&)>	mOnNewFrame;
+	std::function<void(std::shared_ptr<TPixelBuffer>&,SoyTime,json11::Json::object&,uint64_t,uint64_t,uint64_t)>	mOnNewFrame;	//	pixels, time, meta, device ns, host ns, callback ns
 	k4a_depth_mode_t		mDepthMode = K4A_DEPTH_MODE_OFF;
 	k4a_colour_mode_t		mColourMode;
 	k4a_fps_t				mFrameRate = K4A_FRAMES_PER_SECOND_30;
@@ -760,7 +761,8 @@ KinectAzure::TCaptureParams::TCaptureParams(json11::Json& Options)
 	}
 }
 
-KinectAzure::TCameraDevice::TCameraDevice(const std::string& Serial,json11::Json& Options)
+KinectAzure::TCameraDevice::TCameraDevice(const std::string& Serial,json11::Json& Options) :
+	TDevice	( Options )
 {
 	TCaptureParams Params(Options);
 	if (!Soy::StringBeginsWith(Serial, KinectAzure::SerialPrefix, true))
@@ -799,9 +801,12 @@ KinectAzure::TCameraDevice::TCameraDevice(const std::string& Serial,json11::Json
 	}
 	auto Fps = GetFrameRate( FrameRate );
 
-	auto OnNewFrame = [this](std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta)
+	//	all frames are pushed from the reader thread
+	EnableLockFreeFrameQueue();
+
+	auto OnNewFrame = [this](std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta,uint64_t DeviceTimeNs,uint64_t HostTimeNs,uint64_t CallbackTimeNs)
 	{
-		PushFrame(FramePixelBuffer, FrameTime, FrameMeta);
+		PushFrame(FramePixelBuffer, FrameTime, FrameMeta, DeviceTimeNs, HostTimeNs, CallbackTimeNs);
 	};
 
 	mReader.reset( new TPixelReader(DeviceIndex, KeepAlive, Params.mVerboseDebug, OnNewFrame, DepthMode, ColourMode, Fps, SyncMode) );
@@ -1037,8 +1042,7 @@ void KinectAzure::TFrameReader::Iteration(int32_t TimeoutMs)
 
 	//	kinect provides a device timestamp (relative only to itself)
 	//	and a system timestamp, but as our purposes are measurements inside our own system, lets stick to our own timestamps
-	//	k4a_image_get_device_timestamp_usec
-	//	k4a_image_get_system_timestamp_nsec
+	//	for the frame time. Both k4a ones are passed along per-image as the frame's device & host nanoseconds
 	SoyTime FrameCaptureTime(true);
 
 	
@@ -1238,6 +1242,9 @@ void GetMeta(k4a_calibration_camera_t Calibration, json11::Json::object& Json)
 
 void KinectAzure::TPixelReader::OnFrame(TCaptureFrame& CaptureFrame)
 {
+	TRACE_SCOPE("KinectAzure::TPixelReader::OnFrame");
+	//	stamped before the depth->colour transform so its cost shows up in the Enqueue stage latency
+	auto CallbackTimeNs = PopCameraDevice::GetHostTimeNs();
 	auto& Frame = CaptureFrame.mCapture;
 	auto& Calibration = CaptureFrame.mCalibration;
 	auto& Imu = CaptureFrame.mImu;
@@ -1273,7 +1280,17 @@ void KinectAzure::TPixelReader::OnFrame(TCaptureFrame& CaptureFrame)
 	FrameMeta["SyncInCable"] = CaptureFrame.mSyncInCable;
 	FrameMeta["SyncOutCable"] = CaptureFrame.mSyncOutCable;
 
-	auto PushImage = [&](k4a_image_t Image, k4a_calibration_camera_t Calibration)
+	//	device usec (sensor's clock, shared between synced devices) and system nsec (when the image arrived on the host).
+	//	The system timestamp is CLOCK_MONOTONIC/QPC, the same clock as steady_clock, so is used as the host time.
+	//	Grabbed before the depth is realigned, as the transformed image doesn't carry them
+	auto GetDeviceTimeNs = [](k4a_image_t Image) -> uint64_t	{	return Image ? k4a_image_get_device_timestamp_usec(Image) * 1000 : 0;	};
+	auto GetHostTimeNs = [](k4a_image_t Image) -> uint64_t	{	return Image ? k4a_image_get_system_timestamp_nsec(Image) : 0;	};
+	auto DepthDeviceTimeNs = GetDeviceTimeNs(DepthImage);
+	auto DepthHostTimeNs = GetHostTimeNs(DepthImage);
+	auto ColourDeviceTimeNs = GetDeviceTimeNs(ColourImage);
+	auto ColourHostTimeNs = GetHostTimeNs(ColourImage);
+
+	auto PushImage = [&](k4a_image_t Image, k4a_calibration_camera_t Calibration,uint64_t DeviceTimeNs,uint64_t HostTimeNs)
 	{
 		auto Pixels = GetPixels(Image);
 		float3x3 Transform;
@@ -1283,7 +1300,7 @@ void KinectAzure::TPixelReader::OnFrame(TCaptureFrame& CaptureFrame)
 		GetMeta(Calibration, Meta);
 		
 		std::shared_ptr<TPixelBuffer> PixelBuffer(new TDumbPixelBuffer(Pixels,Transform));
-		this->mOnNewFrame(PixelBuffer, CaptureTime, Meta);
+		this->mOnNewFrame(PixelBuffer, CaptureTime, Meta, DeviceTimeNs, HostTimeNs, CallbackTimeNs);
 	};
 
 	//	if colour & depth, realign so depth matches colour
@@ -1332,9 +1349,9 @@ void KinectAzure::TPixelReader::OnFrame(TCaptureFrame& CaptureFrame)
 		}
 
 		if (DepthImage)
-			PushImage(DepthImage, Calibration.depth_camera_calibration);
+			PushImage(DepthImage, Calibration.depth_camera_calibration, DepthDeviceTimeNs, DepthHostTimeNs);
 		if ( ColourImage )
-			PushImage(ColourImage, Calibration.color_camera_calibration);
+			PushImage(ColourImage, Calibration.color_camera_calibration, ColourDeviceTimeNs, ColourHostTimeNs);
 		
 		Cleanup();
 	}
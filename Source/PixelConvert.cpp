@@ -0,0 +1,808 @@
+#include "PixelConvert.h"
+#include "PixelCopy.h"
+#include "PixelTestHelpers.h"
+#include <sstream>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ENABLE_PIXELCONVERT_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define ENABLE_PIXELCONVERT_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace PopCameraDevice
+{
+	//	image the planes make up, as far as conversion is concerned
+	namespace TConvertSource
+	{
+		enum Type
+		{
+			Unsupported,
+			Nv12,		//	luma plane + interleaved uv plane (Yuv_8_88)
+			I420,		//	luma, u & v planes (Yuv_8_8_8)
+			Yuy2,		//	packed 422, y0 u y1 v
+			Uyvy,		//	packed 422, u y0 v y1
+			Rgba,
+			Bgra,
+			Rgb,
+			Bgr,
+			Greyscale,
+		};
+	}
+
+	//	where each colour channel is in an output/input pixel
+	class TRgbLayout
+	{
+	public:
+		size_t	mChannels = 0;
+		size_t	mR = 0;
+		size_t	mG = 1;
+		size_t	mB = 2;
+		bool	mAlpha = false;	//	always 4th channel
+	};
+
+	//	BT.601 video range to rgb in 6 bit fixed point (1.164, 1.596, 0.392, 0.813, 2.017 x64).
+	//	small enough that the simd versions can do it all in 16 bits
+	namespace TYuvCoefficients
+	{
+		constexpr int	YOffset = 16;
+		constexpr int	YScale = 75;
+		constexpr int	VtoR = 102;
+		constexpr int	UtoG = 25;
+		constexpr int	VtoG = 52;
+		constexpr int	UtoB = 129;
+		constexpr int	Round = 32;
+		constexpr int	Shift = 6;
+	}
+
+	TConvertSource::Type	GetConvertSource(ArrayBridge<TPlaneView>& Planes);
+	TRgbLayout				GetRgbLayout(TConvertSource::Type Source);
+	TRgbLayout				GetRgbLayout(SoyPixelsFormat::Type OutputFormat);
+	bool					IsLumaFormat(SoyPixelsFormat::Type Format);
+
+	uint8_t		ClampByte(int Value);
+	void		YuvToRgb(int Luma,int ChromaU,int ChromaV,uint8_t* Rgb,const TRgbLayout& Layout);
+	uint8_t		RgbToGrey(uint8_t r,uint8_t g,uint8_t b);
+
+	//	return how many pixels were done, the caller does the rest in scalar
+	size_t		YuvToRgbaRow_Sse2(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,bool Bgra);
+	size_t		YuvToRgbaRow_Neon(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,bool Bgra);
+	size_t		Packed422ToRgbaRow_Sse2(const uint8_t* Src,bool Yuy2,uint8_t* Dst,size_t Width,bool Bgra);	//	Yuy2 false is uyvy
+	size_t		Packed422ToRgbaRow_Neon(const uint8_t* Src,bool Yuy2,uint8_t* Dst,size_t Width,bool Bgra);
+	size_t		SwapRedBlueRow_Sse2(const uint8_t* Src,uint8_t* Dst,size_t Width);
+	size_t		SwapRedBlueRow_Neon(const uint8_t* Src,uint8_t* Dst,size_t Width);
+
+	//	ChromaStep is 2 for interleaved uv (V = U+1), 1 for separate planes
+	void		YuvToRgbRow(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,const TRgbLayout& Layout,TPixelCopyKernel::Type Kernel);
+	void		Packed422ToRgbRow(const uint8_t* Src,size_t Luma0,size_t ChromaU,size_t Luma1,size_t ChromaV,uint8_t* Dst,size_t Width,const TRgbLayout& Layout,TPixelCopyKernel::Type Kernel);
+	void		RgbToRgbRow(const uint8_t* Src,const TRgbLayout& SrcLayout,uint8_t* Dst,const TRgbLayout& DstLayout,size_t Width,TPixelCopyKernel::Type Kernel);
+	void		RgbToGreyRow(const uint8_t* Src,const TRgbLayout& SrcLayout,uint8_t* Dst,size_t Width);
+	void		GreyToRgbRow(const uint8_t* Src,uint8_t* Dst,const TRgbLayout& DstLayout,size_t Width);
+}
+
+//	16 pixels from 16 luma & 8 chroma samples (u & v widened to 16 bit), shared by the planar & packed kernels
+#if defined(ENABLE_PIXELCONVERT_SSE2)
+namespace PopCameraDevice
+{
+	void		YuvToRgba16_Sse2(__m128i Luma,__m128i ChromaU,__m128i ChromaV,uint8_t* Dst,bool Bgra);
+}
+#endif
+#if defined(ENABLE_PIXELCONVERT_NEON)
+namespace PopCameraDevice
+{
+	void		YuvToRgba16_Neon(uint8x16_t Luma,uint8x8_t ChromaU,uint8x8_t ChromaV,uint8_t* Dst,bool Bgra);
+}
+#endif
+
+
+uint8_t PopCameraDevice::ClampByte(int Value)
+{
+	return static_cast<uint8_t>( Value < 0 ? 0 : (Value > 255 ? 255 : Value) );
+}
+
+void PopCameraDevice::YuvToRgb(int Luma,int ChromaU,int ChromaV,uint8_t* Rgb,const TRgbLayout& Layout)
+{
+	using namespace TYuvCoefficients;
+	auto y = (Luma - YOffset) * YScale + Round;
+	auto u = ChromaU - 128;
+	auto v = ChromaV - 128;
+	Rgb[Layout.mR] = ClampByte( (y + VtoR*v) >> Shift );
+	Rgb[Layout.mG] = ClampByte( (y - UtoG*u - VtoG*v) >> Shift );
+	Rgb[Layout.mB] = ClampByte( (y + UtoB*u) >> Shift );
+	if ( Layout.mAlpha )
+		Rgb[3] = 255;
+}
+
+uint8_t PopCameraDevice::RgbToGrey(uint8_t r,uint8_t g,uint8_t b)
+{
+	//	BT.601 luma weights x256
+	return static_cast<uint8_t>( (77*r + 150*g + 29*b + 128) >> 8 );
+}
+
+
+#if defined(ENABLE_PIXELCONVERT_SSE2)
+void PopCameraDevice::YuvToRgba16_Sse2(__m128i Luma,__m128i ChromaU,__m128i ChromaV,uint8_t* Dst,bool Bgra)
+{
+	using namespace TYuvCoefficients;
+	auto Zero = _mm_setzero_si128();
+	auto Alpha = _mm_set1_epi8( static_cast<char>(0xff) );
+	auto ChromaOffset = _mm_set1_epi16(128);
+	auto LumaOffset = _mm_set1_epi16(YOffset);
+	auto RoundOffset = _mm_set1_epi16(Round);
+
+	//	additions saturate, which only happens when the result clamps to 255 anyway
+	auto U = _mm_sub_epi16( ChromaU, ChromaOffset );
+	auto V = _mm_sub_epi16( ChromaV, ChromaOffset );
+
+	auto YLo = _mm_add_epi16( _mm_mullo_epi16( _mm_sub_epi16( _mm_unpacklo_epi8(Luma,Zero), LumaOffset ), _mm_set1_epi16(YScale) ), RoundOffset );
+	auto YHi = _mm_add_epi16( _mm_mullo_epi16( _mm_sub_epi16( _mm_unpackhi_epi8(Luma,Zero), LumaOffset ), _mm_set1_epi16(YScale) ), RoundOffset );
+	auto RChroma = _mm_mullo_epi16( V, _mm_set1_epi16(VtoR) );
+	auto GChroma = _mm_add_epi16( _mm_mullo_epi16( U, _mm_set1_epi16(UtoG) ), _mm_mullo_epi16( V, _mm_set1_epi16(VtoG) ) );
+	auto BChroma = _mm_mullo_epi16( U, _mm_set1_epi16(UtoB) );
+
+	//	each chroma sample covers 2 pixels
+	auto GetChannel = [&](__m128i Chroma,bool Subtract)
+	{
+		auto ChromaLo = _mm_unpacklo_epi16( Chroma, Chroma );
+		auto ChromaHi = _mm_unpackhi_epi16( Chroma, Chroma );
+		auto Lo = Subtract ? _mm_subs_epi16( YLo, ChromaLo ) : _mm_adds_epi16( YLo, ChromaLo );
+		auto Hi = Subtract ? _mm_subs_epi16( YHi, ChromaHi ) : _mm_adds_epi16( YHi, ChromaHi );
+		return _mm_packus_epi16( _mm_srai_epi16( Lo, Shift ), _mm_srai_epi16( Hi, Shift ) );
+	};
+	auto R = GetChannel( RChroma, false );
+	auto G = GetChannel( GChroma, true );
+	auto B = GetChannel( BChroma, false );
+
+	auto First = Bgra ? B : R;
+	auto Third = Bgra ? R : B;
+	auto FirstGLo = _mm_unpacklo_epi8( First, G );
+	auto FirstGHi = _mm_unpackhi_epi8( First, G );
+	auto ThirdALo = _mm_unpacklo_epi8( Third, Alpha );
+	auto ThirdAHi = _mm_unpackhi_epi8( Third, Alpha );
+	auto* Dst128 = reinterpret_cast<__m128i*>( Dst );
+	_mm_storeu_si128( Dst128+0, _mm_unpacklo_epi16( FirstGLo, ThirdALo ) );
+	_mm_storeu_si128( Dst128+1, _mm_unpackhi_epi16( FirstGLo, ThirdALo ) );
+	_mm_storeu_si128( Dst128+2, _mm_unpacklo_epi16( FirstGHi, ThirdAHi ) );
+	_mm_storeu_si128( Dst128+3, _mm_unpackhi_epi16( FirstGHi, ThirdAHi ) );
+}
+#endif
+
+size_t PopCameraDevice::YuvToRgbaRow_Sse2(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,bool Bgra)
+{
+#if defined(ENABLE_PIXELCONVERT_SSE2)
+	auto Zero = _mm_setzero_si128();
+
+	//	16 pixels (8 chroma samples) at a time
+	size_t x = 0;
+	for ( ;	x+16<=Width;	x+=16 )
+	{
+		auto Y8 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Luma+x) );
+		__m128i U, V;
+		if ( ChromaStep == 2 )
+		{
+			auto UV = _mm_loadu_si128( reinterpret_cast<const __m128i*>(ChromaU+x) );
+			U = _mm_and_si128( UV, _mm_set1_epi16(0xff) );
+			V = _mm_srli_epi16( UV, 8 );
+		}
+		else
+		{
+			U = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(ChromaU+x/2) ), Zero );
+			V = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>(ChromaV+x/2) ), Zero );
+		}
+		YuvToRgba16_Sse2( Y8, U, V, Dst + x*4, Bgra );
+	}
+	return x;
+#else
+	(void)Luma; (void)ChromaU; (void)ChromaV; (void)ChromaStep; (void)Dst; (void)Width; (void)Bgra;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::Packed422ToRgbaRow_Sse2(const uint8_t* Src,bool Yuy2,uint8_t* Dst,size_t Width,bool Bgra)
+{
+#if defined(ENABLE_PIXELCONVERT_SSE2)
+	auto LowBytes = _mm_set1_epi16(0xff);
+
+	//	16 pixels (32 bytes) at a time; luma is the even bytes of yuy2 & the odd bytes of uyvy, chroma alternates u,v in the others
+	size_t x = 0;
+	for ( ;	x+16<=Width;	x+=16 )
+	{
+		auto Pairs0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + x*2) );
+		auto Pairs1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + x*2 + 16) );
+		auto Even = _mm_packus_epi16( _mm_and_si128( Pairs0, LowBytes ), _mm_and_si128( Pairs1, LowBytes ) );
+		auto Odd = _mm_packus_epi16( _mm_srli_epi16( Pairs0, 8 ), _mm_srli_epi16( Pairs1, 8 ) );
+		auto Y8 = Yuy2 ? Even : Odd;
+		auto UV = Yuy2 ? Odd : Even;
+		auto U = _mm_and_si128( UV, LowBytes );
+		auto V = _mm_srli_epi16( UV, 8 );
+		YuvToRgba16_Sse2( Y8, U, V, Dst + x*4, Bgra );
+	}
+	return x;
+#else
+	(void)Src; (void)Yuy2; (void)Dst; (void)Width; (void)Bgra;
+	return 0;
+#endif
+}
+
+#if defined(ENABLE_PIXELCONVERT_NEON)
+void PopCameraDevice::YuvToRgba16_Neon(uint8x16_t Luma,uint8x8_t ChromaU,uint8x8_t ChromaV,uint8_t* Dst,bool Bgra)
+{
+	using namespace TYuvCoefficients;
+	auto ChromaOffset = vdupq_n_s16(128);
+	auto LumaOffset = vdupq_n_s16(YOffset);
+	auto RoundOffset = vdupq_n_s16(Round);
+
+	//	same maths as the sse2 version
+	auto U = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8(ChromaU) ), ChromaOffset );
+	auto V = vsubq_s16( vreinterpretq_s16_u16( vmovl_u8(ChromaV) ), ChromaOffset );
+
+	auto YLo = vaddq_s16( vmulq_n_s16( vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vget_low_u8(Luma) ) ), LumaOffset ), YScale ), RoundOffset );
+	auto YHi = vaddq_s16( vmulq_n_s16( vsubq_s16( vreinterpretq_s16_u16( vmovl_u8( vget_high_u8(Luma) ) ), LumaOffset ), YScale ), RoundOffset );
+	auto RChroma = vmulq_n_s16( V, VtoR );
+	auto GChroma = vaddq_s16( vmulq_n_s16( U, UtoG ), vmulq_n_s16( V, VtoG ) );
+	auto BChroma = vmulq_n_s16( U, UtoB );
+
+	auto GetChannel = [&](int16x8_t Chroma,bool Subtract)
+	{
+		auto Pairs = vzipq_s16( Chroma, Chroma );
+		auto Lo = Subtract ? vqsubq_s16( YLo, Pairs.val[0] ) : vqaddq_s16( YLo, Pairs.val[0] );
+		auto Hi = Subtract ? vqsubq_s16( YHi, Pairs.val[1] ) : vqaddq_s16( YHi, Pairs.val[1] );
+		return vcombine_u8( vqmovun_s16( vshrq_n_s16( Lo, Shift ) ), vqmovun_s16( vshrq_n_s16( Hi, Shift ) ) );
+	};
+	auto R = GetChannel( RChroma, false );
+	auto G = GetChannel( GChroma, true );
+	auto B = GetChannel( BChroma, false );
+
+	uint8x16x4_t Rgba;
+	Rgba.val[0] = Bgra ? B : R;
+	Rgba.val[1] = G;
+	Rgba.val[2] = Bgra ? R : B;
+	Rgba.val[3] = vdupq_n_u8(255);
+	vst4q_u8( Dst, Rgba );
+}
+#endif
+
+size_t PopCameraDevice::YuvToRgbaRow_Neon(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,bool Bgra)
+{
+#if defined(ENABLE_PIXELCONVERT_NEON)
+	size_t x = 0;
+	for ( ;	x+16<=Width;	x+=16 )
+	{
+		auto Y8 = vld1q_u8( Luma+x );
+		uint8x8_t U8, V8;
+		if ( ChromaStep == 2 )
+		{
+			auto UV = vld2_u8( ChromaU+x );
+			U8 = UV.val[0];
+			V8 = UV.val[1];
+		}
+		else
+		{
+			U8 = vld1_u8( ChromaU+x/2 );
+			V8 = vld1_u8( ChromaV+x/2 );
+		}
+		YuvToRgba16_Neon( Y8, U8, V8, Dst + x*4, Bgra );
+	}
+	return x;
+#else
+	(void)Luma; (void)ChromaU; (void)ChromaV; (void)ChromaStep; (void)Dst; (void)Width; (void)Bgra;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::Packed422ToRgbaRow_Neon(const uint8_t* Src,bool Yuy2,uint8_t* Dst,size_t Width,bool Bgra)
+{
+#if defined(ENABLE_PIXELCONVERT_NEON)
+	size_t x = 0;
+	for ( ;	x+16<=Width;	x+=16 )
+	{
+		//	8 pixel pairs, de-interleaved into y0,u,y1,v (or u,y0,v,y1)
+		auto Pairs = vld4_u8( Src + x*2 );
+		auto Luma0 = Yuy2 ? Pairs.val[0] : Pairs.val[1];
+		auto Luma1 = Yuy2 ? Pairs.val[2] : Pairs.val[3];
+		auto U8 = Yuy2 ? Pairs.val[1] : Pairs.val[0];
+		auto V8 = Yuy2 ? Pairs.val[3] : Pairs.val[2];
+		auto Luma = vzip_u8( Luma0, Luma1 );
+		YuvToRgba16_Neon( vcombine_u8( Luma.val[0], Luma.val[1] ), U8, V8, Dst + x*4, Bgra );
+	}
+	return x;
+#else
+	(void)Src; (void)Yuy2; (void)Dst; (void)Width; (void)Bgra;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::SwapRedBlueRow_Sse2(const uint8_t* Src,uint8_t* Dst,size_t Width)
+{
+#if defined(ENABLE_PIXELCONVERT_SSE2)
+	//	4 pixels at a time; keep g & a, swap bytes 0 & 2 of each pixel
+	auto GreenAlphaMask = _mm_set1_epi32( static_cast<int>(0xff00ff00) );
+	auto RedBlueMask = _mm_set1_epi32( 0x00ff00ff );
+	size_t x = 0;
+	for ( ;	x+4<=Width;	x+=4 )
+	{
+		auto Pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src + x*4) );
+		auto GreenAlpha = _mm_and_si128( Pixels, GreenAlphaMask );
+		auto RedBlue = _mm_and_si128( Pixels, RedBlueMask );
+		RedBlue = _mm_or_si128( _mm_slli_epi32( RedBlue, 16 ), _mm_srli_epi32( RedBlue, 16 ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst + x*4), _mm_or_si128( GreenAlpha, RedBlue ) );
+	}
+	return x;
+#else
+	(void)Src; (void)Dst; (void)Width;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::SwapRedBlueRow_Neon(const uint8_t* Src,uint8_t* Dst,size_t Width)
+{
+#if defined(ENABLE_PIXELCONVERT_NEON)
+	size_t x = 0;
+	for ( ;	x+16<=Width;	x+=16 )
+	{
+		auto Pixels = vld4q_u8( Src + x*4 );
+		auto Red = Pixels.val[0];
+		Pixels.val[0] = Pixels.val[2];
+		Pixels.val[2] = Red;
+		vst4q_u8( Dst + x*4, Pixels );
+	}
+	return x;
+#else
+	(void)Src; (void)Dst; (void)Width;
+	return 0;
+#endif
+}
+
+
+void PopCameraDevice::YuvToRgbRow(const uint8_t* Luma,const uint8_t* ChromaU,const uint8_t* ChromaV,size_t ChromaStep,uint8_t* Dst,size_t Width,const TRgbLayout& Layout,TPixelCopyKernel::Type Kernel)
+{
+	size_t x = 0;
+	bool Rgba4 = Layout.mChannels == 4 && Layout.mAlpha && Layout.mG == 1;
+	if ( Rgba4 )
+	{
+		bool Bgra = Layout.mB == 0;
+		if ( Kernel == TPixelCopyKernel::Sse2 || Kernel == TPixelCopyKernel::Avx2 )
+			x = YuvToRgbaRow_Sse2( Luma, ChromaU, ChromaV, ChromaStep, Dst, Width, Bgra );
+		else if ( Kernel == TPixelCopyKernel::Neon )
+			x = YuvToRgbaRow_Neon( Luma, ChromaU, ChromaV, ChromaStep, Dst, Width, Bgra );
+	}
+
+	for ( ;	x<Width;	x++ )
+	{
+		auto ChromaIndex = (x/2) * ChromaStep;
+		YuvToRgb( Luma[x], ChromaU[ChromaIndex], ChromaV[ChromaIndex], Dst + x*Layout.mChannels, Layout );
+	}
+}
+
+void PopCameraDevice::Packed422ToRgbRow(const uint8_t* Src,size_t Luma0,size_t ChromaU,size_t Luma1,size_t ChromaV,uint8_t* Dst,size_t Width,const TRgbLayout& Layout,TPixelCopyKernel::Type Kernel)
+{
+	size_t x = 0;
+	bool Rgba4 = Layout.mChannels == 4 && Layout.mAlpha && Layout.mG == 1;
+	bool Yuy2 = Luma0 == 0 && ChromaU == 1 && Luma1 == 2 && ChromaV == 3;
+	bool Uyvy = ChromaU == 0 && Luma0 == 1 && ChromaV == 2 && Luma1 == 3;
+	if ( Rgba4 && (Yuy2 || Uyvy) )
+	{
+		bool Bgra = Layout.mB == 0;
+		if ( Kernel == TPixelCopyKernel::Sse2 || Kernel == TPixelCopyKernel::Avx2 )
+			x = Packed422ToRgbaRow_Sse2( Src, Yuy2, Dst, Width, Bgra );
+		else if ( Kernel == TPixelCopyKernel::Neon )
+			x = Packed422ToRgbaRow_Neon( Src, Yuy2, Dst, Width, Bgra );
+	}
+
+	//	4 bytes per 2 pixels
+	for ( ;	x<Width;	x++ )
+	{
+		auto* Pair = Src + (x/2)*4;
+		auto Luma = Pair[ (x&1) ? Luma1 : Luma0 ];
+		YuvToRgb( Luma, Pair[ChromaU], Pair[ChromaV], Dst + x*Layout.mChannels, Layout );
+	}
+}
+
+void PopCameraDevice::RgbToRgbRow(const uint8_t* Src,const TRgbLayout& SrcLayout,uint8_t* Dst,const TRgbLayout& DstLayout,size_t Width,TPixelCopyKernel::Type Kernel)
+{
+	size_t x = 0;
+	bool SwapRedBlue4 = SrcLayout.mChannels == 4 && DstLayout.mChannels == 4 && SrcLayout.mR == DstLayout.mB && SrcLayout.mB == DstLayout.mR;
+	if ( SwapRedBlue4 )
+	{
+		if ( Kernel == TPixelCopyKernel::Sse2 || Kernel == TPixelCopyKernel::Avx2 )
+			x = SwapRedBlueRow_Sse2( Src, Dst, Width );
+		else if ( Kernel == TPixelCopyKernel::Neon )
+			x = SwapRedBlueRow_Neon( Src, Dst, Width );
+	}
+
+	for ( ;	x<Width;	x++ )
+	{
+		auto* SrcPixel = Src + x*SrcLayout.mChannels;
+		auto* DstPixel = Dst + x*DstLayout.mChannels;
+		DstPixel[DstLayout.mR] = SrcPixel[SrcLayout.mR];
+		DstPixel[DstLayout.mG] = SrcPixel[SrcLayout.mG];
+		DstPixel[DstLayout.mB] = SrcPixel[SrcLayout.mB];
+		if ( DstLayout.mAlpha )
+			DstPixel[3] = SrcLayout.mAlpha ? SrcPixel[3] : 255;
+	}
+}
+
+void PopCameraDevice::RgbToGreyRow(const uint8_t* Src,const TRgbLayout& SrcLayout,uint8_t* Dst,size_t Width)
+{
+	for ( size_t x=0;	x<Width;	x++ )
+	{
+		auto* SrcPixel = Src + x*SrcLayout.mChannels;
+		Dst[x] = RgbToGrey( SrcPixel[SrcLayout.mR], SrcPixel[SrcLayout.mG], SrcPixel[SrcLayout.mB] );
+	}
+}
+
+void PopCameraDevice::GreyToRgbRow(const uint8_t* Src,uint8_t* Dst,const TRgbLayout& DstLayout,size_t Width)
+{
+	for ( size_t x=0;	x<Width;	x++ )
+	{
+		auto* DstPixel = Dst + x*DstLayout.mChannels;
+		DstPixel[0] = DstPixel[1] = DstPixel[2] = Src[x];
+		if ( DstLayout.mAlpha )
+			DstPixel[3] = 255;
+	}
+}
+
+
+bool PopCameraDevice::IsLumaFormat(SoyPixelsFormat::Type Format)
+{
+	return Format == SoyPixelsFormat::Luma || Format == SoyPixelsFormat::Greyscale;
+}
+
+PopCameraDevice::TConvertSource::Type PopCameraDevice::GetConvertSource(ArrayBridge<TPlaneView>& Planes)
+{
+	auto GetFormat = [&](size_t p)
+	{
+		return p < Planes.GetSize() ? Planes[p].mMeta.GetFormat() : SoyPixelsFormat::Invalid;
+	};
+	auto Format0 = GetFormat(0);
+	auto Format1 = GetFormat(1);
+	auto Format2 = GetFormat(2);
+
+	//	multi-plane formats are identified by their planes, so it doesn't matter if the
+	//	pixel buffer had them in one texture or several
+	if ( Planes.GetSize() == 2 && IsLumaFormat(Format0) && Format1 == SoyPixelsFormat::ChromaUV_88 )
+		return TConvertSource::Nv12;
+	if ( Planes.GetSize() == 3 && IsLumaFormat(Format0) && Format1 == SoyPixelsFormat::ChromaU_8 && Format2 == SoyPixelsFormat::ChromaV_8 )
+		return TConvertSource::I420;
+	if ( Planes.GetSize() != 1 )
+		return TConvertSource::Unsupported;
+
+	switch ( Format0 )
+	{
+	case SoyPixelsFormat::YYuv_8888:
+	case SoyPixelsFormat::YUY2:			return TConvertSource::Yuy2;
+	case SoyPixelsFormat::uyvy_8888:	return TConvertSource::Uyvy;
+	case SoyPixelsFormat::RGBA:			return TConvertSource::Rgba;
+	case SoyPixelsFormat::BGRA:			return TConvertSource::Bgra;
+	case SoyPixelsFormat::RGB:			return TConvertSource::Rgb;
+	case SoyPixelsFormat::BGR:			return TConvertSource::Bgr;
+	case SoyPixelsFormat::Luma:
+	case SoyPixelsFormat::Greyscale:	return TConvertSource::Greyscale;
+	default:							return TConvertSource::Unsupported;
+	}
+}
+
+PopCameraDevice::TRgbLayout PopCameraDevice::GetRgbLayout(TConvertSource::Type Source)
+{
+	TRgbLayout Layout;
+	switch ( Source )
+	{
+	case TConvertSource::Rgba:	Layout.mChannels = 4;	Layout.mAlpha = true;	break;
+	case TConvertSource::Bgra:	Layout.mChannels = 4;	Layout.mAlpha = true;	Layout.mR = 2;	Layout.mB = 0;	break;
+	case TConvertSource::Rgb:	Layout.mChannels = 3;	break;
+	case TConvertSource::Bgr:	Layout.mChannels = 3;	Layout.mR = 2;	Layout.mB = 0;	break;
+	default:
+		throw Soy::AssertException("Convert source is not rgb");
+	}
+	return Layout;
+}
+
+PopCameraDevice::TRgbLayout PopCameraDevice::GetRgbLayout(SoyPixelsFormat::Type OutputFormat)
+{
+	switch ( OutputFormat )
+	{
+	case SoyPixelsFormat::RGBA:	return GetRgbLayout( TConvertSource::Rgba );
+	case SoyPixelsFormat::BGRA:	return GetRgbLayout( TConvertSource::Bgra );
+	case SoyPixelsFormat::RGB:	return GetRgbLayout( TConvertSource::Rgb );
+	default:
+		throw Soy::AssertException( std::string("Output format is not rgb; ") + SoyPixelsFormat::ToString(OutputFormat) );
+	}
+}
+
+
+bool PopCameraDevice::IsConvertOutputFormat(SoyPixelsFormat::Type Format)
+{
+	switch ( Format )
+	{
+	case SoyPixelsFormat::RGBA:
+	case SoyPixelsFormat::BGRA:
+	case SoyPixelsFormat::RGB:
+	case SoyPixelsFormat::Greyscale:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool PopCameraDevice::IsConversionNeeded(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat)
+{
+	if ( OutputFormat == SoyPixelsFormat::Invalid || Planes.IsEmpty() )
+		return false;
+
+	auto Format0 = Planes[0].mMeta.GetFormat();
+	if ( SoyPixelsFormat::IsDepthFormat(Format0) )
+		return false;
+	if ( Planes.GetSize() == 1 && Format0 == OutputFormat )
+		return false;
+	return true;
+}
+
+SoyPixelsMeta PopCameraDevice::GetConvertedMeta(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat)
+{
+	if ( Planes.IsEmpty() )
+		throw Soy::AssertException("No planes to convert");
+
+	//	first plane is full size (luma, or the whole packed image)
+	auto& Meta = Planes[0].mMeta;
+	return SoyPixelsMeta( Meta.GetWidth(), Meta.GetHeight(), OutputFormat );
+}
+
+void PopCameraDevice::ConvertPixels(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat,uint8_t* Dst,size_t DstStride,size_t Rows,TPixelCopyKernel::Type Kernel)
+{
+	auto Source = GetConvertSource(Planes);
+	if ( Source == TConvertSource::Unsupported || !IsConvertOutputFormat(OutputFormat) )
+	{
+		std::stringstream Error;
+		Error << "Cannot convert ";
+		for ( auto p=0;	p<Planes.GetSize();	p++ )
+			Error << (p==0 ? "" : "+") << Planes[p].mMeta.GetFormat();
+		Error << " to " << OutputFormat;
+		throw Soy::AssertException(Error);
+	}
+
+	auto OutputMeta = GetConvertedMeta( Planes, OutputFormat );
+	auto Width = OutputMeta.GetWidth();
+	Rows = std::min( Rows, OutputMeta.GetHeight() );
+	if ( DstStride < OutputMeta.GetRowDataSize() )
+		throw Soy::AssertException("ConvertPixels destination stride smaller than a row");
+
+	//	check the source planes are big enough for the rows we'll read. Cropped planes' last row stops short of the stride
+	auto CheckPlaneSize = [&](size_t PlaneIndex,size_t Stride,size_t RowBytes,size_t PlaneRows)
+	{
+		auto& Plane = Planes[PlaneIndex];
+		if ( PlaneRows == 0 || Plane.mDataSize >= (PlaneRows-1) * Stride + RowBytes )
+			return;
+		std::stringstream Error;
+		Error << "Plane " << PlaneIndex << " (" << Plane.mDataSize << " bytes) too small for " << PlaneRows << " rows of " << RowBytes << " (stride " << Stride << ")";
+		throw Soy::AssertException(Error);
+	};
+
+	//	simd kernels follow the plane copy's cpu detection
+	Kernel = GetPixelCopyKernel(Kernel);
+	bool OutputGrey = OutputFormat == SoyPixelsFormat::Greyscale;
+	auto ChromaWidth = (Width + 1) / 2;
+	auto ChromaRows = (Rows + 1) / 2;
+
+	switch ( Source )
+	{
+	case TConvertSource::Nv12:
+	case TConvertSource::I420:
+	{
+		auto LumaStride = Planes[0].GetRowStride();
+		CheckPlaneSize( 0, LumaStride, Width, Rows );
+		//	greyscale is just the luma plane
+		if ( OutputGrey )
+		{
+			CopyPixelRows( Dst, DstStride, Planes[0].mPixels, LumaStride, Width, Rows, Kernel );
+			return;
+		}
+
+		bool Interleaved = Source == TConvertSource::Nv12;
+		auto ChromaStride = Planes[1].GetRowStride();
+		auto ChromaRowBytes = ChromaWidth * (Interleaved ? 2 : 1);
+		if ( ChromaStride < ChromaRowBytes )
+			throw Soy::AssertException("Chroma plane narrower than half the luma plane");
+		CheckPlaneSize( 1, ChromaStride, ChromaRowBytes, ChromaRows );
+		if ( !Interleaved )
+			CheckPlaneSize( 2, Planes[2].GetRowStride(), ChromaRowBytes, ChromaRows );
+
+		auto Layout = GetRgbLayout(OutputFormat);
+		for ( size_t y=0;	y<Rows;	y++ )
+		{
+			auto* Luma = Planes[0].mPixels + y*LumaStride;
+			auto* ChromaU = Planes[1].mPixels + (y/2)*ChromaStride;
+			auto* ChromaV = Interleaved ? ChromaU+1 : Planes[2].mPixels + (y/2)*Planes[2].GetRowStride();
+			YuvToRgbRow( Luma, ChromaU, ChromaV, Interleaved ? 2 : 1, Dst + y*DstStride, Width, Layout, Kernel );
+		}
+		return;
+	}
+
+	case TConvertSource::Yuy2:
+	case TConvertSource::Uyvy:
+	{
+		auto RowBytes = ChromaWidth * 4;
+		auto SrcStride = Planes[0].mRowStride ? Planes[0].mRowStride : RowBytes;
+		CheckPlaneSize( 0, SrcStride, RowBytes, Rows );
+		bool Yuy2 = Source == TConvertSource::Yuy2;
+		size_t Luma0 = Yuy2 ? 0 : 1;
+		size_t ChromaU = Yuy2 ? 1 : 0;
+		size_t Luma1 = Yuy2 ? 2 : 3;
+		size_t ChromaV = Yuy2 ? 3 : 2;
+		for ( size_t y=0;	y<Rows;	y++ )
+		{
+			auto* Src = Planes[0].mPixels + y*SrcStride;
+			auto* DstRow = Dst + y*DstStride;
+			if ( OutputGrey )
+			{
+				for ( size_t x=0;	x<Width;	x++ )
+					DstRow[x] = Src[ (x/2)*4 + ((x&1) ? Luma1 : Luma0) ];
+				continue;
+			}
+			Packed422ToRgbRow( Src, Luma0, ChromaU, Luma1, ChromaV, DstRow, Width, GetRgbLayout(OutputFormat), Kernel );
+		}
+		return;
+	}
+
+	case TConvertSource::Greyscale:
+	{
+		auto SrcStride = Planes[0].GetRowStride();
+		CheckPlaneSize( 0, SrcStride, Width, Rows );
+		for ( size_t y=0;	y<Rows;	y++ )
+		{
+			auto* Src = Planes[0].mPixels + y*SrcStride;
+			auto* DstRow = Dst + y*DstStride;
+			if ( OutputGrey )
+				CopyPixels( DstRow, Src, Width, Kernel );
+			else
+				GreyToRgbRow( Src, DstRow, GetRgbLayout(OutputFormat), Width );
+		}
+		return;
+	}
+
+	default:
+	{
+		auto SrcLayout = GetRgbLayout(Source);
+		auto RowBytes = Width * SrcLayout.mChannels;
+		auto SrcStride = Planes[0].mRowStride ? Planes[0].mRowStride : RowBytes;
+		CheckPlaneSize( 0, SrcStride, RowBytes, Rows );
+		for ( size_t y=0;	y<Rows;	y++ )
+		{
+			auto* Src = Planes[0].mPixels + y*SrcStride;
+			auto* DstRow = Dst + y*DstStride;
+			if ( OutputGrey )
+				RgbToGreyRow( Src, SrcLayout, DstRow, Width );
+			else
+				RgbToRgbRow( Src, SrcLayout, DstRow, GetRgbLayout(OutputFormat), Width, Kernel );
+		}
+		return;
+	}
+	}
+}
+
+
+void PopCameraDevice::PixelConvert_UnitTests()
+{
+	using namespace PixelTests;
+	TExpect Expect("PixelConvert");
+
+	//	known colours, scalar
+	{
+		std::vector<uint8_t> Pixel = { 0, 0, 0 };
+		TRgbLayout Rgb;
+		Rgb.mChannels = 3;
+		YuvToRgb( 16, 128, 128, Pixel.data(), Rgb );
+		Expect( Pixel == std::vector<uint8_t>{0,0,0}, "yuv black should be rgb black" );
+		YuvToRgb( 235, 128, 128, Pixel.data(), Rgb );
+		Expect( Pixel == std::vector<uint8_t>{255,255,255}, "yuv white should be rgb white" );
+		YuvToRgb( 81, 90, 240, Pixel.data(), Rgb );
+		Expect( Pixel[0] > 240 && Pixel[1] < 10 && Pixel[2] < 10, "yuv red should be mostly red" );
+	}
+
+	//	every simd kernel must match scalar exactly, for widths around the vector sizes.
+	//	Kernels are passed in, rather than set globally, so other threads' conversions aren't affected
+	size_t Widths[] = { 1, 2, 15, 16, 17, 33, 64, 67 };
+	const size_t Height = 5;
+	SoyPixelsFormat::Type Outputs[] = { SoyPixelsFormat::RGBA, SoyPixelsFormat::BGRA, SoyPixelsFormat::RGB, SoyPixelsFormat::Greyscale };
+	TPixelCopyKernel::Type Kernels[] = { TPixelCopyKernel::Sse2, TPixelCopyKernel::Avx2, TPixelCopyKernel::Neon };
+	for ( auto Width : Widths )
+	{
+		auto ChromaWidth = (Width+1)/2;
+		auto ChromaHeight = (Height+1)/2;
+		std::vector<uint8_t> Luma( Width*Height ), ChromaUV( ChromaWidth*2*ChromaHeight ), ChromaU( ChromaWidth*ChromaHeight ), ChromaV( ChromaWidth*ChromaHeight ), Rgba( Width*Height*4 );
+		std::vector<uint8_t> Packed422( ChromaWidth*4*Height );	//	odd widths still have whole pixel pairs
+		uint32_t Random = 1234;
+		FillRandom( Luma, Random );
+		FillRandom( ChromaUV, Random );
+		FillRandom( ChromaU, Random );
+		FillRandom( ChromaV, Random );
+		FillRandom( Rgba, Random );
+		FillRandom( Packed422, Random );
+
+		BufferArray<TPlaneView,3> Nv12;
+		Nv12.PushBack( MakePlane( Luma, Width, Height, SoyPixelsFormat::Luma ) );
+		Nv12.PushBack( MakePlane( ChromaUV, ChromaWidth, ChromaHeight, SoyPixelsFormat::ChromaUV_88 ) );
+		BufferArray<TPlaneView,3> I420;
+		I420.PushBack( MakePlane( Luma, Width, Height, SoyPixelsFormat::Luma ) );
+		I420.PushBack( MakePlane( ChromaU, ChromaWidth, ChromaHeight, SoyPixelsFormat::ChromaU_8 ) );
+		I420.PushBack( MakePlane( ChromaV, ChromaWidth, ChromaHeight, SoyPixelsFormat::ChromaV_8 ) );
+		BufferArray<TPlaneView,3> Rgba1;
+		Rgba1.PushBack( MakePlane( Rgba, Width, Height, SoyPixelsFormat::RGBA ) );
+		BufferArray<TPlaneView,3> Yuy2;
+		Yuy2.PushBack( MakePlane( Packed422, Width, Height, SoyPixelsFormat::YUY2 ) );
+		BufferArray<TPlaneView,3> Uyvy;
+		Uyvy.PushBack( MakePlane( Packed422, Width, Height, SoyPixelsFormat::uyvy_8888 ) );
+		BufferArray<TPlaneView,3>* Sources[] = { &Nv12, &I420, &Yuy2, &Uyvy, &Rgba1 };
+
+		for ( auto* pSource : Sources )
+		{
+			auto SourceBridge = GetArrayBridge(*pSource);
+			for ( auto Output : Outputs )
+			{
+				if ( !IsConversionNeeded( SourceBridge, Output ) )
+					continue;
+				auto RowBytes = GetConvertedMeta( SourceBridge, Output ).GetRowDataSize();
+				std::vector<uint8_t> Expected( RowBytes*Height );
+				ConvertPixels( SourceBridge, Output, Expected.data(), RowBytes, Height, TPixelCopyKernel::Scalar );
+
+				for ( auto Kernel : Kernels )
+				{
+					if ( !IsPixelCopyKernelSupported(Kernel) )
+						continue;
+					std::vector<uint8_t> Converted( RowBytes*Height );
+					ConvertPixels( SourceBridge, Output, Converted.data(), RowBytes, Height, Kernel );
+					std::stringstream Description;
+					Description << GetPixelCopyKernelName(Kernel) << " " << (*pSource)[0].mMeta.GetFormat() << " to " << Output << " width " << Width << " differs from scalar";
+					Expect( Converted == Expected, Description.str() );
+				}
+			}
+		}
+
+		//	rgba -> bgra -> rgba round trips
+		{
+			auto RowBytes = Width*4;
+			std::vector<uint8_t> Bgra( RowBytes*Height ), RoundTrip( RowBytes*Height );
+			auto RgbaBridge = GetArrayBridge(Rgba1);
+			ConvertPixels( RgbaBridge, SoyPixelsFormat::BGRA, Bgra.data(), RowBytes, Height );
+			BufferArray<TPlaneView,1> Bgra1;
+			Bgra1.PushBack( MakePlane( Bgra, Width, Height, SoyPixelsFormat::BGRA ) );
+			auto BgraBridge = GetArrayBridge(Bgra1);
+			ConvertPixels( BgraBridge, SoyPixelsFormat::RGBA, RoundTrip.data(), RowBytes, Height );
+			Expect( RoundTrip == Rgba, "RGBA to BGRA and back should be lossless" );
+		}
+	}
+
+	//	packed 422 must match the same samples as planes
+	{
+		const size_t Width = 6;
+		std::vector<uint8_t> Yuy2 = { 16,90,81,240, 235,128,126,128, 50,60,70,80 };
+		std::vector<uint8_t> Luma = { 16,81, 235,126, 50,70 };
+		std::vector<uint8_t> ChromaUV = { 90,240, 128,128, 60,80 };
+		BufferArray<TPlaneView,1> Packed;
+		Packed.PushBack( MakePlane( Yuy2, Width, 1, SoyPixelsFormat::YYuv_8888 ) );
+		BufferArray<TPlaneView,2> Nv12;
+		Nv12.PushBack( MakePlane( Luma, Width, 1, SoyPixelsFormat::Luma ) );
+		Nv12.PushBack( MakePlane( ChromaUV, Width/2, 1, SoyPixelsFormat::ChromaUV_88 ) );
+		std::vector<uint8_t> FromPacked( Width*4 ), FromPlanes( Width*4 );
+		auto PackedBridge = GetArrayBridge(Packed);
+		auto Nv12Bridge = GetArrayBridge(Nv12);
+		ConvertPixels( PackedBridge, SoyPixelsFormat::RGBA, FromPacked.data(), Width*4, 1 );
+		ConvertPixels( Nv12Bridge, SoyPixelsFormat::RGBA, FromPlanes.data(), Width*4, 1 );
+		Expect( FromPacked == FromPlanes, "YUY2 should convert the same as NV12 of the same samples" );
+	}
+
+	//	depth passes through
+	{
+		std::vector<uint8_t> Depth( 4*4*2 );
+		BufferArray<TPlaneView,1> Planes;
+		Planes.PushBack( MakePlane( Depth, 4, 4, SoyPixelsFormat::Depth16mm ) );
+		auto PlanesBridge = GetArrayBridge(Planes);
+		Expect( !IsConversionNeeded( PlanesBridge, SoyPixelsFormat::RGBA ), "depth shouldn't be converted" );
+	}
+}
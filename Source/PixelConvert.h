@@ -0,0 +1,24 @@
+#pragma once
+
+#include "FramePlanes.h"
+#include "PixelCopy.h"
+
+
+//	pixel format conversion for OutputFormat, done while copying to the caller's buffer so it's one pass over the frame.
+//	YUV is treated as BT.601 video range. YUV to greyscale outputs the luma plane as-is.
+//	Only YUV (NV12, I420, YUY2 & UYVY) to RGBA/BGRA and RGBA<->BGRA have simd kernels; RGB(3 channel) output,
+//	RGB to greyscale & greyscale to RGB are scalar. There's no conversion to YUV
+namespace PopCameraDevice
+{
+	bool			IsConvertOutputFormat(SoyPixelsFormat::Type Format);	//	RGBA, BGRA, RGB or Greyscale
+
+	//	false if the planes are already the output format, or are depth, which passes through unconverted
+	bool			IsConversionNeeded(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat);
+	SoyPixelsMeta	GetConvertedMeta(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat);
+
+	//	Planes are the split planes of one image (eg. luma & chroma). Writes the first Rows rows of the converted image.
+	//	Throws if the planes' formats can't be converted. Kernel picks the simd kernels (see CopyPixels)
+	void			ConvertPixels(ArrayBridge<TPlaneView>& Planes,SoyPixelsFormat::Type OutputFormat,uint8_t* Dst,size_t DstStride,size_t Rows,TPixelCopyKernel::Type Kernel=TPixelCopyKernel::Auto);
+
+	void			PixelConvert_UnitTests();
+}
@@ -0,0 +1,376 @@
+#include "PixelCopy.h"
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ENABLE_PIXELCOPY_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//	neon is only detected here for the convert & resize kernels, plane copies are memcpy
+#if defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define ENABLE_PIXELCOPY_NEON
+#endif
+
+//	gcc/clang need avx2 enabled per-function (the rest of the library is built for the baseline cpu)
+#if defined(ENABLE_PIXELCOPY_X86) && !defined(_MSC_VER)
+#define PIXELCOPY_TARGET_AVX2	__attribute__((target("avx2")))
+#else
+#define PIXELCOPY_TARGET_AVX2
+#endif
+
+
+namespace PopCameraDevice
+{
+	//	Stream = use non-temporal stores if the kernel has them, caller does StoreFence() afterwards.
+	//	Non-streaming copies are left to memcpy, which is already vectorised & tuned for the cpu by the c library
+	typedef void(*TPixelCopyFunction)(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream);
+
+	void				CopyScalar(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream);
+	void				CopySse2(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream);
+	void				CopyAvx2(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream);
+	void				StoreFence();
+
+	TPixelCopyKernel::Type	GetBestPixelCopyKernel();
+	TPixelCopyFunction		GetPixelCopyFunction(TPixelCopyKernel::Type Kernel);
+
+	std::atomic<TPixelCopyKernel::Type>	PixelCopyKernel = TPixelCopyKernel::Auto;
+}
+
+
+void PopCameraDevice::CopyScalar(uint8_t* Dst,const uint8_t* Src,size_t Size,bool)
+{
+	//	no streaming stores, so Stream is ignored
+	memcpy( Dst, Src, Size );
+}
+
+void PopCameraDevice::StoreFence()
+{
+#if defined(ENABLE_PIXELCOPY_X86)
+	//	streaming stores are weakly ordered, make them visible before the consumer is told the frame is ready
+	_mm_sfence();
+#endif
+}
+
+void PopCameraDevice::CopySse2(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream)
+{
+#if defined(ENABLE_PIXELCOPY_X86)
+	if ( !Stream )
+	{
+		memcpy( Dst, Src, Size );
+		return;
+	}
+
+	//	non-temporal stores must be aligned, copy the head up to alignment (source stays unaligned)
+	auto Misaligned = reinterpret_cast<uintptr_t>(Dst) & 15;
+	if ( Misaligned )
+	{
+		auto HeadSize = std::min<size_t>( 16 - Misaligned, Size );
+		memcpy( Dst, Src, HeadSize );
+		Dst += HeadSize;
+		Src += HeadSize;
+		Size -= HeadSize;
+	}
+
+	for ( ;	Size>=64;	Size-=64, Src+=64, Dst+=64 )
+	{
+		auto a = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src+0) );
+		auto b = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src+16) );
+		auto c = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src+32) );
+		auto d = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src+48) );
+		_mm_stream_si128( reinterpret_cast<__m128i*>(Dst+0), a );
+		_mm_stream_si128( reinterpret_cast<__m128i*>(Dst+16), b );
+		_mm_stream_si128( reinterpret_cast<__m128i*>(Dst+32), c );
+		_mm_stream_si128( reinterpret_cast<__m128i*>(Dst+48), d );
+	}
+	for ( ;	Size>=16;	Size-=16, Src+=16, Dst+=16 )
+		_mm_stream_si128( reinterpret_cast<__m128i*>(Dst), _mm_loadu_si128( reinterpret_cast<const __m128i*>(Src) ) );
+
+	memcpy( Dst, Src, Size );
+#else
+	(void)Dst; (void)Src; (void)Size; (void)Stream;
+	throw std::runtime_error("SSE2 pixel copy not supported on this architecture");
+#endif
+}
+
+PIXELCOPY_TARGET_AVX2 void PopCameraDevice::CopyAvx2(uint8_t* Dst,const uint8_t* Src,size_t Size,bool Stream)
+{
+#if defined(ENABLE_PIXELCOPY_X86)
+	if ( !Stream )
+	{
+		memcpy( Dst, Src, Size );
+		return;
+	}
+
+	auto Misaligned = reinterpret_cast<uintptr_t>(Dst) & 31;
+	if ( Misaligned )
+	{
+		auto HeadSize = std::min<size_t>( 32 - Misaligned, Size );
+		memcpy( Dst, Src, HeadSize );
+		Dst += HeadSize;
+		Src += HeadSize;
+		Size -= HeadSize;
+	}
+
+	for ( ;	Size>=128;	Size-=128, Src+=128, Dst+=128 )
+	{
+		auto a = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src+0) );
+		auto b = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src+32) );
+		auto c = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src+64) );
+		auto d = _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src+96) );
+		_mm256_stream_si256( reinterpret_cast<__m256i*>(Dst+0), a );
+		_mm256_stream_si256( reinterpret_cast<__m256i*>(Dst+32), b );
+		_mm256_stream_si256( reinterpret_cast<__m256i*>(Dst+64), c );
+		_mm256_stream_si256( reinterpret_cast<__m256i*>(Dst+96), d );
+	}
+	for ( ;	Size>=32;	Size-=32, Src+=32, Dst+=32 )
+		_mm256_stream_si256( reinterpret_cast<__m256i*>(Dst), _mm256_loadu_si256( reinterpret_cast<const __m256i*>(Src) ) );
+
+	memcpy( Dst, Src, Size );
+#else
+	(void)Dst; (void)Src; (void)Size; (void)Stream;
+	throw std::runtime_error("AVX2 pixel copy not supported on this architecture");
+#endif
+}
+
+
+bool PopCameraDevice::IsPixelCopyKernelSupported(TPixelCopyKernel::Type Kernel)
+{
+	switch ( Kernel )
+	{
+	case TPixelCopyKernel::Auto:
+	case TPixelCopyKernel::Scalar:
+		return true;
+
+#if defined(ENABLE_PIXELCOPY_X86)
+#if defined(_MSC_VER)
+	case TPixelCopyKernel::Sse2:
+	{
+		int Info[4] = {};
+		__cpuid( Info, 1 );
+		return ( Info[3] & (1<<26) ) != 0;
+	}
+	case TPixelCopyKernel::Avx2:
+	{
+		int Info[4] = {};
+		__cpuid( Info, 0 );
+		if ( Info[0] < 7 )
+			return false;
+		//	os must save ymm registers (osxsave & xcr0 sse+avx state) as well as the cpu supporting avx2
+		__cpuid( Info, 1 );
+		bool OsXSave = ( Info[2] & (1<<27) ) != 0;
+		bool Avx = ( Info[2] & (1<<28) ) != 0;
+		if ( !OsXSave || !Avx || (_xgetbv(0) & 6) != 6 )
+			return false;
+		__cpuidex( Info, 7, 0 );
+		return ( Info[1] & (1<<5) ) != 0;
+	}
+#else
+	//	gcc/clang's checks include os support for the register state
+	case TPixelCopyKernel::Sse2:	return __builtin_cpu_supports("sse2");
+	case TPixelCopyKernel::Avx2:	return __builtin_cpu_supports("avx2");
+#endif
+#endif
+
+#if defined(ENABLE_PIXELCOPY_NEON)
+	case TPixelCopyKernel::Neon:	return true;
+#endif
+
+	default:
+		return false;
+	}
+}
+
+PopCameraDevice::TPixelCopyKernel::Type PopCameraDevice::GetBestPixelCopyKernel()
+{
+	TPixelCopyKernel::Type Preferred[] = { TPixelCopyKernel::Avx2, TPixelCopyKernel::Sse2, TPixelCopyKernel::Neon };
+	for ( auto Kernel : Preferred )
+		if ( IsPixelCopyKernelSupported(Kernel) )
+			return Kernel;
+	return TPixelCopyKernel::Scalar;
+}
+
+void PopCameraDevice::SetPixelCopyKernel(TPixelCopyKernel::Type Kernel)
+{
+	if ( !IsPixelCopyKernelSupported(Kernel) )
+	{
+		std::stringstream Error;
+		Error << "Pixel copy kernel " << GetPixelCopyKernelName(Kernel) << " not supported on this cpu";
+		throw std::runtime_error(Error.str());
+	}
+	if ( Kernel == TPixelCopyKernel::Auto )
+		Kernel = GetBestPixelCopyKernel();
+	PixelCopyKernel = Kernel;
+}
+
+PopCameraDevice::TPixelCopyKernel::Type PopCameraDevice::GetPixelCopyKernel(TPixelCopyKernel::Type Kernel)
+{
+	return Kernel == TPixelCopyKernel::Auto ? GetPixelCopyKernel() : Kernel;
+}
+
+PopCameraDevice::TPixelCopyKernel::Type PopCameraDevice::GetPixelCopyKernel()
+{
+	auto Kernel = PixelCopyKernel.load();
+	if ( Kernel != TPixelCopyKernel::Auto )
+		return Kernel;
+
+	//	racing threads will all pick the same kernel
+	Kernel = GetBestPixelCopyKernel();
+	PixelCopyKernel = Kernel;
+	return Kernel;
+}
+
+const char* PopCameraDevice::GetPixelCopyKernelName(TPixelCopyKernel::Type Kernel)
+{
+	switch ( Kernel )
+	{
+	case TPixelCopyKernel::Auto:	return "Auto";
+	case TPixelCopyKernel::Scalar:	return "Scalar";
+	case TPixelCopyKernel::Sse2:	return "Sse2";
+	case TPixelCopyKernel::Avx2:	return "Avx2";
+	case TPixelCopyKernel::Neon:	return "Neon";
+	default:						return "Unknown";
+	}
+}
+
+PopCameraDevice::TPixelCopyFunction PopCameraDevice::GetPixelCopyFunction(TPixelCopyKernel::Type Kernel)
+{
+	switch ( Kernel )
+	{
+	case TPixelCopyKernel::Sse2:	return CopySse2;
+	case TPixelCopyKernel::Avx2:	return CopyAvx2;
+	//	neon's plain loads & stores are no faster than memcpy
+	default:						return CopyScalar;
+	}
+}
+
+
+void PopCameraDevice::CopyPixels(uint8_t* Dst,const uint8_t* Src,size_t Size,TPixelCopyKernel::Type Kernel)
+{
+	if ( Size == 0 )
+		return;
+
+	auto Copy = GetPixelCopyFunction( GetPixelCopyKernel(Kernel) );
+	bool Stream = Size >= PixelCopyStreamingThreshold;
+	Copy( Dst, Src, Size, Stream );
+	if ( Stream )
+		StoreFence();
+}
+
+void PopCameraDevice::CopyPixelRows(uint8_t* Dst,size_t DstStride,const uint8_t* Src,size_t SrcStride,size_t RowBytes,size_t Rows,TPixelCopyKernel::Type Kernel)
+{
+	if ( RowBytes == 0 || Rows == 0 )
+		return;
+
+	//	packed rows are one copy
+	if ( DstStride == RowBytes && SrcStride == RowBytes )
+	{
+		CopyPixels( Dst, Src, RowBytes * Rows, Kernel );
+		return;
+	}
+
+	if ( DstStride < RowBytes || SrcStride < RowBytes )
+	{
+		std::stringstream Error;
+		Error << "CopyPixelRows stride (src " << SrcStride << ", dst " << DstStride << ") smaller than row (" << RowBytes << " bytes)";
+		throw std::runtime_error(Error.str());
+	}
+
+	//	stream based on the whole copy, one fence at the end
+	auto Copy = GetPixelCopyFunction( GetPixelCopyKernel(Kernel) );
+	bool Stream = RowBytes * Rows >= PixelCopyStreamingThreshold;
+	for ( size_t y=0;	y<Rows;	y++ )
+		Copy( Dst + (y*DstStride), Src + (y*SrcStride), RowBytes, Stream );
+	if ( Stream )
+		StoreFence();
+}
+
+
+void PopCameraDevice::PixelCopy_UnitTests()
+{
+	auto Expect = [](bool Condition,const char* Kernel,const char* Description)
+	{
+		if ( Condition )
+			return;
+		std::stringstream Error;
+		Error << "PixelCopy test failed (" << Kernel << "): " << Description;
+		throw std::runtime_error(Error.str());
+	};
+
+	auto GetPattern = [](size_t Index)
+	{
+		return static_cast<uint8_t>( (Index * 31) ^ (Index >> 8) );
+	};
+
+	const uint8_t Guard = 0xcd;
+	const size_t Padding = 64;
+
+	//	kernels are passed in, rather than set globally, so other threads' copies aren't affected
+	TPixelCopyKernel::Type Kernels[] = { TPixelCopyKernel::Scalar, TPixelCopyKernel::Sse2, TPixelCopyKernel::Avx2, TPixelCopyKernel::Neon };
+	for ( auto Kernel : Kernels )
+	{
+		if ( !IsPixelCopyKernelSupported(Kernel) )
+			continue;
+		auto KernelName = GetPixelCopyKernelName(Kernel);
+
+		//	sizes around vector widths and the streaming threshold, with misaligned src & dst
+		size_t Sizes[] = { 0, 1, 15, 16, 17, 31, 33, 63, 64, 65, 127, 129, 1000, PixelCopyStreamingThreshold-1, PixelCopyStreamingThreshold+77 };
+		for ( auto Size : Sizes )
+		{
+			for ( size_t Offset=0;	Offset<4;	Offset++ )
+			{
+				std::vector<uint8_t> Src( Size + Padding );
+				std::vector<uint8_t> Dst( Size + Padding, Guard );
+				for ( size_t i=0;	i<Src.size();	i++ )
+					Src[i] = GetPattern(i);
+				auto SrcOffset = Offset;
+				auto DstOffset = (Offset * 7) % 32;
+				CopyPixels( Dst.data() + DstOffset, Src.data() + SrcOffset, Size, Kernel );
+
+				bool Match = true;
+				for ( size_t i=0;	i<Dst.size();	i++ )
+				{
+					bool Inside = i >= DstOffset && i < DstOffset + Size;
+					auto Expected = Inside ? Src[i - DstOffset + SrcOffset] : Guard;
+					Match = Match && Dst[i] == Expected;
+				}
+				Expect( Match, KernelName, "CopyPixels output mismatch or wrote outside destination" );
+			}
+		}
+
+		//	strided rows; padding between rows must be left alone. Second case is big enough to stream
+		struct TRowsCase { size_t RowBytes, Rows, SrcStride, DstStride; };
+		TRowsCase RowCases[] =
+		{
+			{ 13, 7, 16, 20 },
+			{ 64, 9, 64, 64 },
+			{ 3000, 400, 3072, 3001 },
+		};
+		for ( auto& Case : RowCases )
+		{
+			std::vector<uint8_t> Src( Case.SrcStride * Case.Rows );
+			std::vector<uint8_t> Dst( Case.DstStride * Case.Rows, Guard );
+			for ( size_t i=0;	i<Src.size();	i++ )
+				Src[i] = GetPattern(i);
+			CopyPixelRows( Dst.data(), Case.DstStride, Src.data(), Case.SrcStride, Case.RowBytes, Case.Rows, Kernel );
+
+			bool Match = true;
+			for ( size_t y=0;	y<Case.Rows;	y++ )
+			{
+				for ( size_t x=0;	x<Case.DstStride;	x++ )
+				{
+					auto Expected = x < Case.RowBytes ? Src[y*Case.SrcStride + x] : Guard;
+					Match = Match && Dst[y*Case.DstStride + x] == Expected;
+				}
+			}
+			Expect( Match, KernelName, "CopyPixelRows output mismatch or wrote into row padding" );
+		}
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+//	plane copy kernels. The widest the cpu supports is picked at runtime (on first use),
+//	large copies use non-temporal stores on x86 so a frame doesn't flush the consumer's cache
+namespace PopCameraDevice
+{
+	namespace TPixelCopyKernel
+	{
+		enum Type
+		{
+			Auto,		//	best supported
+			Scalar,		//	memcpy
+			Sse2,
+			Avx2,
+			Neon,		//	plane copies are memcpy (there's no neon non-temporal store), but picks the neon convert & resize kernels
+		};
+	}
+
+	//	copies at least this big bypass the cache (roughly L2 sized, smaller copies are likely read again soon)
+	constexpr size_t			PixelCopyStreamingThreshold = 1024 * 1024;
+
+	//	Kernel is for tests & benchmarks to use a specific (supported) kernel without changing the global one, Auto uses GetPixelCopyKernel()
+	void						CopyPixels(uint8_t* Dst,const uint8_t* Src,size_t Size,TPixelCopyKernel::Type Kernel=TPixelCopyKernel::Auto);
+
+	//	copy Rows rows of RowBytes. Strides can be larger than RowBytes (padded rows, a sub-rectangle)
+	void						CopyPixelRows(uint8_t* Dst,size_t DstStride,const uint8_t* Src,size_t SrcStride,size_t RowBytes,size_t Rows,TPixelCopyKernel::Type Kernel=TPixelCopyKernel::Auto);
+
+	bool						IsPixelCopyKernelSupported(TPixelCopyKernel::Type Kernel);
+	void						SetPixelCopyKernel(TPixelCopyKernel::Type Kernel);	//	for benchmarks & tests, throws if unsupported
+	TPixelCopyKernel::Type		GetPixelCopyKernel();								//	resolved, never Auto
+	TPixelCopyKernel::Type		GetPixelCopyKernel(TPixelCopyKernel::Type Kernel);	//	Kernel, or GetPixelCopyKernel() if it's Auto
+	const char*					GetPixelCopyKernelName(TPixelCopyKernel::Type Kernel);
+
+	void						PixelCopy_UnitTests();
+}
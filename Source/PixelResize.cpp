@@ -0,0 +1,882 @@
+#include "PixelResize.h"
+#include "PixelCopy.h"
+#include "PixelTestHelpers.h"
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ENABLE_PIXELRESIZE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define ENABLE_PIXELRESIZE_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace PopCameraDevice
+{
+	//	horizontal half of a bilinear sample, the same for every row so worked out once per plane
+	class TBilinearColumn
+	{
+	public:
+		uint32_t	mLeft = 0;			//	value index of the left pixel in a row
+		uint32_t	mRight = 0;
+		uint32_t	mRightWeight = 0;
+	};
+
+	//	one plane being resized, shared by every band of rows
+	class TResizeJob
+	{
+	public:
+		const uint8_t*			mSrc = nullptr;
+		size_t					mSrcWidth = 0;
+		size_t					mSrcHeight = 0;
+		size_t					mSrcStride = 0;
+		uint8_t*				mDst = nullptr;
+		size_t					mDstWidth = 0;
+		size_t					mDstHeight = 0;
+		size_t					mDstStride = 0;
+		size_t					mChannels = 0;
+		size_t					mBoxFactor = 0;		//	2 or 4 when the area filter is an exact box, which the simd versions do
+		const TBilinearColumn*	mColumns = nullptr;	//	bilinear; where each output column samples from
+		TResizeFilter::Type		mFilter = TResizeFilter::Area;
+		TPixelCopyKernel::Type	mKernel = TPixelCopyKernel::Scalar;
+	};
+
+	//	threads kept around to resize bands of rows alongside the popping thread, so a pop doesn't start threads
+	class TResizeWorkers
+	{
+	public:
+		TResizeWorkers(size_t ThreadCount);
+		~TResizeWorkers();
+
+		size_t		GetThreadCount() const	{	return mThreads.size() + 1;	}	//	including the caller
+		//	splits the rows into bands & calls Function(FirstRow,RowCount) for each across the threads, returning when they're all done.
+		//	If another pop is already using the workers, the bands are all done on the calling thread
+		void		Run(size_t Rows,const std::function<void(size_t,size_t)>& Function);
+		void		Quit();				//	wake the workers to exit, without waiting for them
+		void		Join();				//	waits for the current job, then quits & joins the workers. Later jobs run on the caller
+		void		DetachThreads();
+
+	private:
+		void		WorkerThread();
+		void		RunBands();
+
+	private:
+		std::mutex					mRunLock;	//	one job at a time
+		std::mutex					mLock;
+		std::condition_variable		mWake;
+		std::condition_variable		mFinished;
+		uint64_t					mJobCounter = 0;
+		size_t						mBusyWorkers = 0;
+		bool						mQuit = false;
+		std::exception_ptr			mError;
+
+		const std::function<void(size_t,size_t)>*	mFunction = nullptr;
+		size_t						mRows = 0;
+		size_t						mBands = 0;
+		std::atomic<size_t>			mNextBand { 0 };
+
+		std::vector<std::thread>	mThreads;
+	};
+
+	constexpr size_t	MaxResizeThreads = 4;
+	constexpr size_t	ResizeThreadingThreshold = 1024*1024;	//	source bytes read before a plane is split across threads
+	constexpr uint32_t	BilinearOne = 256;						//	bilinear weights are 8 bit fractions
+
+	std::shared_ptr<TResizeWorkers>	GetResizeWorkers();
+
+	//	return how many output pixels were done, the caller does the rest in scalar
+	size_t		BoxDownscaleRow_Sse2(const uint8_t* Src,size_t SrcStride,size_t Factor,size_t Channels,uint8_t* Dst,size_t DstWidth);
+	size_t		BoxDownscaleRow_Neon(const uint8_t* Src,size_t SrcStride,size_t Factor,size_t Channels,uint8_t* Dst,size_t DstWidth);
+	size_t		BlendRows_Sse2(const uint8_t* Top,const uint8_t* Bottom,uint32_t BottomWeight,uint16_t* Dst,size_t Count);
+	size_t		BlendRows_Neon(const uint8_t* Top,const uint8_t* Bottom,uint32_t BottomWeight,uint16_t* Dst,size_t Count);
+
+	//	source pixels either side of the centre of a destination pixel, & the weight of the second.
+	//	Step is source pixels per destination pixel in 16.16 fixed point (GetBilinearStep)
+	uint64_t	GetBilinearStep(size_t DstSize,size_t SrcSize);
+	void		GetBilinearSample(size_t DstIndex,uint64_t Step,size_t SrcSize,size_t& Src0,size_t& Src1,uint32_t& Weight1);
+	void		AreaRow(const TResizeJob& Job,size_t y);
+	void		GetBilinearColumns(size_t DstWidth,size_t SrcWidth,size_t Channels,std::vector<TBilinearColumn>& Columns);
+	template<size_t CHANNELS>
+	void		BlendColumns(const uint16_t* Blended,const TBilinearColumn* Columns,uint8_t* Dst,size_t DstWidth);
+	void		BilinearRow(const TResizeJob& Job,size_t y,std::vector<uint16_t>& BlendedRow);
+	void		ResizeRows(const TResizeJob& Job,size_t FirstRow,size_t RowCount);
+
+	std::mutex						ResizeWorkersLock;
+	std::shared_ptr<TResizeWorkers>	ResizeWorkers;
+}
+
+
+PopCameraDevice::TResizeWorkers::TResizeWorkers(size_t ThreadCount)
+{
+	for ( size_t t=1;	t<ThreadCount;	t++ )
+		mThreads.emplace_back( [this]()	{	WorkerThread();	} );
+}
+
+PopCameraDevice::TResizeWorkers::~TResizeWorkers()
+{
+	Quit();
+	for ( auto& Thread : mThreads )
+	{
+		if ( Thread.joinable() )
+			Thread.join();
+	}
+}
+
+void PopCameraDevice::TResizeWorkers::Quit()
+{
+	{
+		std::lock_guard<std::mutex> Lock(mLock);
+		mQuit = true;
+	}
+	mWake.notify_all();
+}
+
+void PopCameraDevice::TResizeWorkers::Join()
+{
+	std::lock_guard<std::mutex> RunLock(mRunLock);
+	Quit();
+	for ( auto& Thread : mThreads )
+	{
+		if ( Thread.joinable() )
+			Thread.join();
+	}
+	mThreads.clear();
+}
+
+void PopCameraDevice::TResizeWorkers::DetachThreads()
+{
+	for ( auto& Thread : mThreads )
+	{
+		if ( Thread.joinable() )
+			Thread.detach();
+	}
+}
+
+void PopCameraDevice::TResizeWorkers::Run(size_t Rows,const std::function<void(size_t,size_t)>& Function)
+{
+	std::unique_lock<std::mutex> RunLock( mRunLock, std::try_to_lock );
+	if ( !RunLock.owns_lock() || mThreads.empty() )
+	{
+		Function( 0, Rows );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(mLock);
+		mFunction = &Function;
+		mRows = Rows;
+		//	a few bands per thread so they finish at about the same time
+		mBands = std::min( Rows, GetThreadCount() * 4 );
+		mNextBand = 0;
+		mError = nullptr;
+		mBusyWorkers = mThreads.size();
+		mJobCounter++;
+	}
+	mWake.notify_all();
+	RunBands();
+
+	std::unique_lock<std::mutex> Lock(mLock);
+	mFinished.wait( Lock, [this]()	{	return mBusyWorkers == 0;	} );
+	mFunction = nullptr;
+	auto Error = mError;
+	mError = nullptr;
+	if ( Error )
+		std::rethrow_exception(Error);
+}
+
+void PopCameraDevice::TResizeWorkers::RunBands()
+{
+	try
+	{
+		while ( true )
+		{
+			auto Band = mNextBand++;
+			if ( Band >= mBands )
+				return;
+			auto FirstRow = Band * mRows / mBands;
+			auto EndRow = (Band+1) * mRows / mBands;
+			(*mFunction)( FirstRow, EndRow - FirstRow );
+		}
+	}
+	catch(...)
+	{
+		std::lock_guard<std::mutex> Lock(mLock);
+		if ( !mError )
+			mError = std::current_exception();
+		//	stop the others picking up more bands
+		mNextBand = mBands;
+	}
+}
+
+void PopCameraDevice::TResizeWorkers::WorkerThread()
+{
+	uint64_t LastJob = 0;
+	while ( true )
+	{
+		{
+			std::unique_lock<std::mutex> Lock(mLock);
+			mWake.wait( Lock, [&]()	{	return mQuit || mJobCounter != LastJob;	} );
+			if ( mQuit )
+				return;
+			LastJob = mJobCounter;
+		}
+		RunBands();
+		{
+			std::lock_guard<std::mutex> Lock(mLock);
+			mBusyWorkers--;
+		}
+		mFinished.notify_one();
+	}
+}
+
+
+std::shared_ptr<PopCameraDevice::TResizeWorkers> PopCameraDevice::GetResizeWorkers()
+{
+	std::lock_guard<std::mutex> Lock(ResizeWorkersLock);
+	if ( !ResizeWorkers )
+	{
+		auto ThreadCount = std::clamp<size_t>( std::thread::hardware_concurrency(), 1, MaxResizeThreads );
+		ResizeWorkers = std::make_shared<TResizeWorkers>(ThreadCount);
+	}
+	return ResizeWorkers;
+}
+
+void PopCameraDevice::ShutdownResizeWorkers(bool ProcessExit)
+{
+	std::shared_ptr<TResizeWorkers> Workers;
+	{
+		std::lock_guard<std::mutex> Lock(ResizeWorkersLock);
+		std::swap( Workers, ResizeWorkers );
+	}
+	if ( !Workers )
+		return;
+
+	(void)ProcessExit;	//	only windows treats process exit differently
+#if defined(TARGET_WINDOWS)
+	//	on DLL_PROCESS_DETACH the threads have already been terminated (or joining them would deadlock on the loader lock),
+	//	so they're let go. The workers are leaked, rather than freed under any thread that is somehow still running
+	if ( ProcessExit )
+	{
+		Workers->Quit();
+		Workers->DetachThreads();
+		new std::shared_ptr<TResizeWorkers>( std::move(Workers) );
+		return;
+	}
+#endif
+	//	a pop still holding a reference finishes its resize first, & any later one runs on its own thread
+	Workers->Join();
+}
+
+
+size_t PopCameraDevice::BoxDownscaleRow_Sse2(const uint8_t* Src,size_t SrcStride,size_t Factor,size_t Channels,uint8_t* Dst,size_t DstWidth)
+{
+#if defined(ENABLE_PIXELRESIZE_SSE2)
+	if ( Channels != 1 && Channels != 2 && Channels != 4 )
+		return 0;
+	if ( Factor != 2 && Factor != 4 )
+		return 0;
+
+	auto Zero = _mm_setzero_si128();
+	//	Lo & Hi are 16 channel values in pixel order, widened to 16 bits. Returns the 8 sums of each pair of neighbouring pixels
+	auto SumPixelPairs = [&](__m128i Lo,__m128i Hi)
+	{
+		if ( Channels == 1 )
+		{
+			auto Ones = _mm_set1_epi16(1);
+			return _mm_packs_epi32( _mm_madd_epi16( Lo, Ones ), _mm_madd_epi16( Hi, Ones ) );
+		}
+		if ( Channels == 2 )
+		{
+			auto PairLo = _mm_add_epi16( Lo, _mm_srli_epi64( Lo, 32 ) );
+			auto PairHi = _mm_add_epi16( Hi, _mm_srli_epi64( Hi, 32 ) );
+			PairLo = _mm_shuffle_epi32( PairLo, _MM_SHUFFLE(3,1,2,0) );
+			PairHi = _mm_shuffle_epi32( PairHi, _MM_SHUFFLE(3,1,2,0) );
+			return _mm_unpacklo_epi64( PairLo, PairHi );
+		}
+		auto PairLo = _mm_add_epi16( Lo, _mm_srli_si128( Lo, 8 ) );
+		auto PairHi = _mm_add_epi16( Hi, _mm_srli_si128( Hi, 8 ) );
+		return _mm_unpacklo_epi64( PairLo, PairHi );
+	};
+
+	//	8 bytes of output at a time. Sums are at most 16x255 so fit in 16 bits
+	auto Shift = _mm_cvtsi32_si128( Factor == 2 ? 2 : 4 );
+	auto Round = _mm_set1_epi16( Factor == 2 ? 2 : 8 );
+	auto DstPixelsPerLoop = 8 / Channels;
+	size_t x = 0;
+	for ( ;	x+DstPixelsPerLoop<=DstWidth;	x+=DstPixelsPerLoop )
+	{
+		auto* SrcX = Src + x*Factor*Channels;
+		__m128i Sum;
+		if ( Factor == 2 )
+		{
+			auto Row0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(SrcX) );
+			auto Row1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(SrcX+SrcStride) );
+			auto Lo = _mm_add_epi16( _mm_unpacklo_epi8(Row0,Zero), _mm_unpacklo_epi8(Row1,Zero) );
+			auto Hi = _mm_add_epi16( _mm_unpackhi_epi8(Row0,Zero), _mm_unpackhi_epi8(Row1,Zero) );
+			Sum = SumPixelPairs( Lo, Hi );
+		}
+		else
+		{
+			auto Lo0 = Zero;
+			auto Hi0 = Zero;
+			auto Lo1 = Zero;
+			auto Hi1 = Zero;
+			for ( size_t r=0;	r<4;	r++ )
+			{
+				auto* Row = SrcX + r*SrcStride;
+				auto Pixels0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Row) );
+				auto Pixels1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Row+16) );
+				Lo0 = _mm_add_epi16( Lo0, _mm_unpacklo_epi8(Pixels0,Zero) );
+				Hi0 = _mm_add_epi16( Hi0, _mm_unpackhi_epi8(Pixels0,Zero) );
+				Lo1 = _mm_add_epi16( Lo1, _mm_unpacklo_epi8(Pixels1,Zero) );
+				Hi1 = _mm_add_epi16( Hi1, _mm_unpackhi_epi8(Pixels1,Zero) );
+			}
+			Sum = SumPixelPairs( SumPixelPairs( Lo0, Hi0 ), SumPixelPairs( Lo1, Hi1 ) );
+		}
+		auto Average = _mm_srl_epi16( _mm_add_epi16( Sum, Round ), Shift );
+		_mm_storel_epi64( reinterpret_cast<__m128i*>(Dst + x*Channels), _mm_packus_epi16( Average, Average ) );
+	}
+	return x;
+#else
+	(void)Src; (void)SrcStride; (void)Factor; (void)Channels; (void)Dst; (void)DstWidth;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::BoxDownscaleRow_Neon(const uint8_t* Src,size_t SrcStride,size_t Factor,size_t Channels,uint8_t* Dst,size_t DstWidth)
+{
+#if defined(ENABLE_PIXELRESIZE_NEON)
+	if ( Channels != 1 && Channels != 2 && Channels != 4 )
+		return 0;
+	if ( Factor != 2 && Factor != 4 )
+		return 0;
+
+	//	16 pixels, deinterleaved into a vector per channel
+	auto LoadChannels = [&](const uint8_t* Pixels,uint8x16_t* Values)
+	{
+		if ( Channels == 1 )
+		{
+			Values[0] = vld1q_u8( Pixels );
+		}
+		else if ( Channels == 2 )
+		{
+			auto Loaded = vld2q_u8( Pixels );
+			Values[0] = Loaded.val[0];
+			Values[1] = Loaded.val[1];
+		}
+		else
+		{
+			auto Loaded = vld4q_u8( Pixels );
+			for ( size_t c=0;	c<4;	c++ )
+				Values[c] = Loaded.val[c];
+		}
+	};
+	auto StoreChannels = [&](uint8_t* Pixels,const uint8x8_t* Values)
+	{
+		if ( Channels == 1 )
+		{
+			vst1_u8( Pixels, Values[0] );
+		}
+		else if ( Channels == 2 )
+		{
+			uint8x8x2_t Store;
+			Store.val[0] = Values[0];
+			Store.val[1] = Values[1];
+			vst2_u8( Pixels, Store );
+		}
+		else
+		{
+			uint8x8x4_t Store;
+			for ( size_t c=0;	c<4;	c++ )
+				Store.val[c] = Values[c];
+			vst4_u8( Pixels, Store );
+		}
+	};
+
+	//	8 output pixels at a time, same rounding as scalar
+	size_t x = 0;
+	for ( ;	x+8<=DstWidth;	x+=8 )
+	{
+		auto* SrcX = Src + x*Factor*Channels;
+		uint8x8_t Averages[4];
+		if ( Factor == 2 )
+		{
+			uint8x16_t Row0[4];
+			uint8x16_t Row1[4];
+			LoadChannels( SrcX, Row0 );
+			LoadChannels( SrcX+SrcStride, Row1 );
+			for ( size_t c=0;	c<Channels;	c++ )
+				Averages[c] = vrshrn_n_u16( vaddq_u16( vpaddlq_u8(Row0[c]), vpaddlq_u8(Row1[c]) ), 2 );
+		}
+		else
+		{
+			uint16x8_t Sums0[4];
+			uint16x8_t Sums1[4];
+			for ( size_t c=0;	c<Channels;	c++ )
+				Sums0[c] = Sums1[c] = vdupq_n_u16(0);
+			for ( size_t r=0;	r<4;	r++ )
+			{
+				auto* Row = SrcX + r*SrcStride;
+				uint8x16_t Pixels0[4];
+				uint8x16_t Pixels1[4];
+				LoadChannels( Row, Pixels0 );
+				LoadChannels( Row + 16*Channels, Pixels1 );
+				for ( size_t c=0;	c<Channels;	c++ )
+				{
+					Sums0[c] = vaddq_u16( Sums0[c], vpaddlq_u8(Pixels0[c]) );
+					Sums1[c] = vaddq_u16( Sums1[c], vpaddlq_u8(Pixels1[c]) );
+				}
+			}
+			for ( size_t c=0;	c<Channels;	c++ )
+			{
+				auto Sum0 = vpadd_u16( vget_low_u16(Sums0[c]), vget_high_u16(Sums0[c]) );
+				auto Sum1 = vpadd_u16( vget_low_u16(Sums1[c]), vget_high_u16(Sums1[c]) );
+				Averages[c] = vrshrn_n_u16( vcombine_u16( Sum0, Sum1 ), 4 );
+			}
+		}
+		StoreChannels( Dst + x*Channels, Averages );
+	}
+	return x;
+#else
+	(void)Src; (void)SrcStride; (void)Factor; (void)Channels; (void)Dst; (void)DstWidth;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::BlendRows_Sse2(const uint8_t* Top,const uint8_t* Bottom,uint32_t BottomWeight,uint16_t* Dst,size_t Count)
+{
+#if defined(ENABLE_PIXELRESIZE_SSE2)
+	//	weighted sums are at most 255x256 so fit in unsigned 16 bits
+	auto Zero = _mm_setzero_si128();
+	auto TopWeight16 = _mm_set1_epi16( static_cast<short>(BilinearOne - BottomWeight) );
+	auto BottomWeight16 = _mm_set1_epi16( static_cast<short>(BottomWeight) );
+	size_t x = 0;
+	for ( ;	x+16<=Count;	x+=16 )
+	{
+		auto TopPixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Top+x) );
+		auto BottomPixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>(Bottom+x) );
+		auto Lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8(TopPixels,Zero), TopWeight16 ), _mm_mullo_epi16( _mm_unpacklo_epi8(BottomPixels,Zero), BottomWeight16 ) );
+		auto Hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8(TopPixels,Zero), TopWeight16 ), _mm_mullo_epi16( _mm_unpackhi_epi8(BottomPixels,Zero), BottomWeight16 ) );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst+x), Lo );
+		_mm_storeu_si128( reinterpret_cast<__m128i*>(Dst+x+8), Hi );
+	}
+	return x;
+#else
+	(void)Top; (void)Bottom; (void)BottomWeight; (void)Dst; (void)Count;
+	return 0;
+#endif
+}
+
+size_t PopCameraDevice::BlendRows_Neon(const uint8_t* Top,const uint8_t* Bottom,uint32_t BottomWeight,uint16_t* Dst,size_t Count)
+{
+#if defined(ENABLE_PIXELRESIZE_NEON)
+	auto TopWeight16 = static_cast<uint16_t>(BilinearOne - BottomWeight);
+	auto BottomWeight16 = static_cast<uint16_t>(BottomWeight);
+	size_t x = 0;
+	for ( ;	x+16<=Count;	x+=16 )
+	{
+		auto TopPixels = vld1q_u8( Top+x );
+		auto BottomPixels = vld1q_u8( Bottom+x );
+		auto Lo = vmlaq_n_u16( vmulq_n_u16( vmovl_u8( vget_low_u8(TopPixels) ), TopWeight16 ), vmovl_u8( vget_low_u8(BottomPixels) ), BottomWeight16 );
+		auto Hi = vmlaq_n_u16( vmulq_n_u16( vmovl_u8( vget_high_u8(TopPixels) ), TopWeight16 ), vmovl_u8( vget_high_u8(BottomPixels) ), BottomWeight16 );
+		vst1q_u16( Dst+x, Lo );
+		vst1q_u16( Dst+x+8, Hi );
+	}
+	return x;
+#else
+	(void)Top; (void)Bottom; (void)BottomWeight; (void)Dst; (void)Count;
+	return 0;
+#endif
+}
+
+
+uint64_t PopCameraDevice::GetBilinearStep(size_t DstSize,size_t SrcSize)
+{
+	return ( static_cast<uint64_t>(SrcSize) << 16 ) / DstSize;
+}
+
+void PopCameraDevice::GetBilinearSample(size_t DstIndex,uint64_t Step,size_t SrcSize,size_t& Src0,size_t& Src1,uint32_t& Weight1)
+{
+	//	centre of the destination pixel in source pixels. Same size lands exactly on each source pixel
+	auto Position = static_cast<int64_t>( DstIndex*Step + Step/2 ) - (1<<15);
+	Position = std::max<int64_t>( Position, 0 );
+	Src0 = static_cast<size_t>( Position >> 16 );
+	Weight1 = static_cast<uint32_t>( (Position >> 8) & 0xff );
+	if ( Src0 >= SrcSize-1 )
+	{
+		Src0 = SrcSize-1;
+		Weight1 = 0;
+	}
+	Src1 = std::min( Src0+1, SrcSize-1 );
+}
+
+void PopCameraDevice::AreaRow(const TResizeJob& Job,size_t y)
+{
+	//	average of the source pixels this output pixel covers, rounded out to whole pixels
+	auto SrcY0 = y * Job.mSrcHeight / Job.mDstHeight;
+	auto SrcY1 = std::max( SrcY0+1, (y+1) * Job.mSrcHeight / Job.mDstHeight );
+	auto* Dst = Job.mDst + y*Job.mDstStride;
+	auto Channels = Job.mChannels;
+
+	size_t x = 0;
+	if ( Job.mBoxFactor )
+	{
+		auto* Src = Job.mSrc + SrcY0*Job.mSrcStride;
+		if ( Job.mKernel == TPixelCopyKernel::Sse2 || Job.mKernel == TPixelCopyKernel::Avx2 )
+			x = BoxDownscaleRow_Sse2( Src, Job.mSrcStride, Job.mBoxFactor, Channels, Dst, Job.mDstWidth );
+		else if ( Job.mKernel == TPixelCopyKernel::Neon )
+			x = BoxDownscaleRow_Neon( Src, Job.mSrcStride, Job.mBoxFactor, Channels, Dst, Job.mDstWidth );
+	}
+
+	for ( ;	x<Job.mDstWidth;	x++ )
+	{
+		auto SrcX0 = x * Job.mSrcWidth / Job.mDstWidth;
+		auto SrcX1 = std::max( SrcX0+1, (x+1) * Job.mSrcWidth / Job.mDstWidth );
+		auto Count = (SrcX1-SrcX0) * (SrcY1-SrcY0);
+		for ( size_t c=0;	c<Channels;	c++ )
+		{
+			size_t Sum = 0;
+			for ( auto sy=SrcY0;	sy<SrcY1;	sy++ )
+			{
+				auto* Row = Job.mSrc + sy*Job.mSrcStride + c;
+				for ( auto sx=SrcX0;	sx<SrcX1;	sx++ )
+					Sum += Row[sx*Channels];
+			}
+			Dst[x*Channels+c] = static_cast<uint8_t>( (Sum + Count/2) / Count );
+		}
+	}
+}
+
+void PopCameraDevice::BilinearRow(const TResizeJob& Job,size_t y,std::vector<uint16_t>& BlendedRow)
+{
+	//	blend the two source rows first, then across
+	size_t SrcY0, SrcY1;
+	uint32_t WeightY;
+	GetBilinearSample( y, GetBilinearStep( Job.mDstHeight, Job.mSrcHeight ), Job.mSrcHeight, SrcY0, SrcY1, WeightY );
+	auto* Top = Job.mSrc + SrcY0*Job.mSrcStride;
+	auto* Bottom = Job.mSrc + SrcY1*Job.mSrcStride;
+	auto RowValues = Job.mSrcWidth * Job.mChannels;
+	BlendedRow.resize( RowValues );
+	auto* Blended = BlendedRow.data();
+
+	size_t i = 0;
+	if ( Job.mKernel == TPixelCopyKernel::Sse2 || Job.mKernel == TPixelCopyKernel::Avx2 )
+		i = BlendRows_Sse2( Top, Bottom, WeightY, Blended, RowValues );
+	else if ( Job.mKernel == TPixelCopyKernel::Neon )
+		i = BlendRows_Neon( Top, Bottom, WeightY, Blended, RowValues );
+	for ( ;	i<RowValues;	i++ )
+		Blended[i] = static_cast<uint16_t>( Top[i]*(BilinearOne-WeightY) + Bottom[i]*WeightY );
+
+	auto* Dst = Job.mDst + y*Job.mDstStride;
+	switch ( Job.mChannels )
+	{
+	case 1:	BlendColumns<1>( Blended, Job.mColumns, Dst, Job.mDstWidth );	break;
+	case 2:	BlendColumns<2>( Blended, Job.mColumns, Dst, Job.mDstWidth );	break;
+	case 3:	BlendColumns<3>( Blended, Job.mColumns, Dst, Job.mDstWidth );	break;
+	case 4:	BlendColumns<4>( Blended, Job.mColumns, Dst, Job.mDstWidth );	break;
+	default:
+		throw Soy::AssertException("Bilinear resize expects 1 to 4 channels");
+	}
+}
+
+void PopCameraDevice::GetBilinearColumns(size_t DstWidth,size_t SrcWidth,size_t Channels,std::vector<TBilinearColumn>& Columns)
+{
+	Columns.resize( DstWidth );
+	auto Step = GetBilinearStep( DstWidth, SrcWidth );
+	for ( size_t x=0;	x<DstWidth;	x++ )
+	{
+		size_t Left, Right;
+		uint32_t RightWeight;
+		GetBilinearSample( x, Step, SrcWidth, Left, Right, RightWeight );
+		Columns[x].mLeft = static_cast<uint32_t>( Left * Channels );
+		Columns[x].mRight = static_cast<uint32_t>( Right * Channels );
+		Columns[x].mRightWeight = RightWeight;
+	}
+}
+
+template<size_t CHANNELS>
+void PopCameraDevice::BlendColumns(const uint16_t* Blended,const TBilinearColumn* Columns,uint8_t* Dst,size_t DstWidth)
+{
+	constexpr uint32_t Round = (BilinearOne*BilinearOne) / 2;
+	for ( size_t x=0;	x<DstWidth;	x++ )
+	{
+		auto& Column = Columns[x];
+		auto* Left = Blended + Column.mLeft;
+		auto* Right = Blended + Column.mRight;
+		auto LeftWeight = BilinearOne - Column.mRightWeight;
+		for ( size_t c=0;	c<CHANNELS;	c++ )
+			Dst[x*CHANNELS+c] = static_cast<uint8_t>( (Left[c]*LeftWeight + Right[c]*Column.mRightWeight + Round) >> 16 );
+	}
+}
+
+void PopCameraDevice::ResizeRows(const TResizeJob& Job,size_t FirstRow,size_t RowCount)
+{
+	//	each thread keeps its own blend row, so it's only allocated the first time
+	thread_local std::vector<uint16_t> BlendedRow;
+	for ( auto y=FirstRow;	y<FirstRow+RowCount;	y++ )
+	{
+		if ( Job.mFilter == TResizeFilter::Bilinear )
+			BilinearRow( Job, y, BlendedRow );
+		else
+			AreaRow( Job, y );
+	}
+}
+
+
+bool PopCameraDevice::IsResizableFormat(SoyPixelsFormat::Type Format)
+{
+	switch ( Format )
+	{
+	case SoyPixelsFormat::Greyscale:
+	case SoyPixelsFormat::GreyscaleAlpha:
+	case SoyPixelsFormat::Luma:
+	case SoyPixelsFormat::RGB:
+	case SoyPixelsFormat::BGR:
+	case SoyPixelsFormat::RGBA:
+	case SoyPixelsFormat::BGRA:
+	case SoyPixelsFormat::ARGB:
+	case SoyPixelsFormat::ChromaUV_88:
+	case SoyPixelsFormat::ChromaU_8:
+	case SoyPixelsFormat::ChromaV_8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool PopCameraDevice::IsResizeNeeded(ArrayBridge<TPlaneView>& Planes,size_t Width,size_t Height)
+{
+	if ( Planes.IsEmpty() )
+		return false;
+
+	auto& ImageMeta = Planes[0].mMeta;
+	auto ResizedMeta = GetResizedMeta( ImageMeta, Width, Height );
+	if ( ResizedMeta == ImageMeta )
+		return false;
+
+	for ( auto p=0;	p<Planes.GetSize();	p++ )
+	{
+		if ( !IsResizableFormat( Planes[p].mMeta.GetFormat() ) )
+			return false;
+	}
+	return true;
+}
+
+SoyPixelsMeta PopCameraDevice::GetResizedMeta(const SoyPixelsMeta& Meta,size_t Width,size_t Height)
+{
+	auto SrcWidth = Meta.GetWidth();
+	auto SrcHeight = Meta.GetHeight();
+	if ( (Width == 0 && Height == 0) || SrcWidth == 0 || SrcHeight == 0 )
+		return Meta;
+
+	if ( Width == 0 )
+		Width = std::max<size_t>( 1, (Height*SrcWidth + SrcHeight/2) / SrcHeight );
+	if ( Height == 0 )
+		Height = std::max<size_t>( 1, (Width*SrcHeight + SrcWidth/2) / SrcWidth );
+	return SoyPixelsMeta( Width, Height, Meta.GetFormat() );
+}
+
+SoyPixelsMeta PopCameraDevice::GetResizedPlaneMeta(const SoyPixelsMeta& ImageMeta,const SoyPixelsMeta& ResizedImageMeta,const SoyPixelsMeta& PlaneMeta)
+{
+	auto ImageWidth = ImageMeta.GetWidth();
+	auto ImageHeight = ImageMeta.GetHeight();
+	if ( ImageWidth == 0 || ImageHeight == 0 )
+		return PlaneMeta;
+
+	//	keep the plane's subsampling; odd sizes round up the same way the chroma of an odd sized image does
+	auto Width = ( ResizedImageMeta.GetWidth() * PlaneMeta.GetWidth() + ImageWidth-1 ) / ImageWidth;
+	auto Height = ( ResizedImageMeta.GetHeight() * PlaneMeta.GetHeight() + ImageHeight-1 ) / ImageHeight;
+	return SoyPixelsMeta( Width, Height, PlaneMeta.GetFormat() );
+}
+
+void PopCameraDevice::ResizePlane(const TPlaneView& Src,const SoyPixelsMeta& DstMeta,uint8_t* Dst,size_t DstStride,size_t Rows,TResizeFilter::Type Filter,bool AllowThreads,TPixelCopyKernel::Type Kernel)
+{
+	auto& SrcMeta = Src.mMeta;
+	if ( !IsResizableFormat( SrcMeta.GetFormat() ) || DstMeta.GetFormat() != SrcMeta.GetFormat() )
+	{
+		std::stringstream Error;
+		Error << "Cannot resize " << SrcMeta << " to " << DstMeta;
+		throw Soy::AssertException(Error);
+	}
+	if ( SrcMeta.GetWidth() == 0 || SrcMeta.GetHeight() == 0 )
+		throw Soy::AssertException("Cannot resize an empty plane");
+	//	cropped planes' last row stops short of the stride
+	auto SrcStride = Src.GetRowStride();
+	if ( Src.mDataSize < (SrcMeta.GetHeight()-1) * SrcStride + SrcMeta.GetRowDataSize() )
+	{
+		std::stringstream Error;
+		Error << "Plane (" << Src.mDataSize << " bytes, stride " << SrcStride << ") too small for " << SrcMeta;
+		throw Soy::AssertException(Error);
+	}
+	if ( DstStride < DstMeta.GetRowDataSize() )
+		throw Soy::AssertException("ResizePlane destination stride smaller than a row");
+
+	TResizeJob Job;
+	Job.mSrc = Src.mPixels;
+	Job.mSrcWidth = SrcMeta.GetWidth();
+	Job.mSrcHeight = SrcMeta.GetHeight();
+	Job.mSrcStride = SrcStride;
+	Job.mDst = Dst;
+	Job.mDstWidth = DstMeta.GetWidth();
+	Job.mDstHeight = DstMeta.GetHeight();
+	Job.mDstStride = DstStride;
+	Job.mChannels = SrcMeta.GetChannels();
+	Job.mFilter = Filter;
+	//	simd kernels follow the plane copy's cpu detection
+	Job.mKernel = GetPixelCopyKernel(Kernel);
+	if ( Filter == TResizeFilter::Area )
+	{
+		for ( size_t Factor : { 2, 4 } )
+		{
+			if ( Job.mSrcWidth == Job.mDstWidth*Factor && Job.mSrcHeight == Job.mDstHeight*Factor )
+				Job.mBoxFactor = Factor;
+		}
+	}
+
+	Rows = std::min( Rows, Job.mDstHeight );
+	if ( Rows == 0 || Job.mDstWidth == 0 )
+		return;
+
+	//	kept per thread, so it's only allocated when a plane is wider than before
+	thread_local std::vector<TBilinearColumn> BilinearColumns;
+	if ( Filter == TResizeFilter::Bilinear )
+	{
+		GetBilinearColumns( Job.mDstWidth, Job.mSrcWidth, Job.mChannels, BilinearColumns );
+		Job.mColumns = BilinearColumns.data();
+	}
+
+	//	only split planes big enough to be worth waking the workers
+	auto SrcBytes = Job.mSrcStride * Job.mSrcHeight * Rows / Job.mDstHeight;
+	std::shared_ptr<TResizeWorkers> Workers;
+	if ( AllowThreads && SrcBytes >= ResizeThreadingThreshold )
+		Workers = GetResizeWorkers();
+	if ( !Workers )
+	{
+		ResizeRows( Job, 0, Rows );
+		return;
+	}
+
+	std::function<void(size_t,size_t)> ResizeBand = [&Job](size_t FirstRow,size_t RowCount)
+	{
+		ResizeRows( Job, FirstRow, RowCount );
+	};
+	Workers->Run( Rows, ResizeBand );
+}
+
+
+void PopCameraDevice::PixelResize_UnitTests()
+{
+	using namespace PixelTests;
+	TExpect Expect("PixelResize");
+	uint32_t Random = 1234;
+
+	auto Resize = [](const TPlaneView& Src,size_t Width,size_t Height,TResizeFilter::Type Filter,bool AllowThreads=true,TPixelCopyKernel::Type Kernel=TPixelCopyKernel::Auto)
+	{
+		SoyPixelsMeta DstMeta( Width, Height, Src.mMeta.GetFormat() );
+		std::vector<uint8_t> Dst( DstMeta.GetDataSize() );
+		ResizePlane( Src, DstMeta, Dst.data(), DstMeta.GetRowDataSize(), Height, Filter, AllowThreads, Kernel );
+		return Dst;
+	};
+
+	//	sizes
+	{
+		Expect( GetResizedMeta( SoyPixelsMeta(1920,1080,SoyPixelsFormat::Luma), 960, 0 ) == SoyPixelsMeta(960,540,SoyPixelsFormat::Luma), "height should keep the aspect ratio" );
+		Expect( GetResizedMeta( SoyPixelsMeta(1920,1080,SoyPixelsFormat::Luma), 0, 270 ) == SoyPixelsMeta(480,270,SoyPixelsFormat::Luma), "width should keep the aspect ratio" );
+		SoyPixelsMeta Image( 1280, 720, SoyPixelsFormat::Luma );
+		SoyPixelsMeta Resized( 641, 361, SoyPixelsFormat::Luma );
+		SoyPixelsMeta Chroma( 640, 360, SoyPixelsFormat::ChromaUV_88 );
+		Expect( GetResizedPlaneMeta( Image, Resized, Chroma ) == SoyPixelsMeta(321,181,SoyPixelsFormat::ChromaUV_88), "chroma should be half the resized luma, rounded up" );
+	}
+
+	//	known averages
+	{
+		std::vector<uint8_t> Pixels;
+		auto Plane = MakePlane( Pixels, 4, 2, SoyPixelsFormat::Greyscale );
+		Pixels = { 0,10,20,30, 40,50,60,71 };
+		Expect( Resize( Plane, 2, 1, TResizeFilter::Area ) == std::vector<uint8_t>{25,45}, "2x2 box averages should round to nearest" );
+	}
+
+	//	kernels are passed in, rather than set globally, so other threads' resizes aren't affected
+	SoyPixelsFormat::Type Formats[] = { SoyPixelsFormat::Greyscale, SoyPixelsFormat::ChromaUV_88, SoyPixelsFormat::RGB, SoyPixelsFormat::RGBA };
+	TResizeFilter::Type Filters[] = { TResizeFilter::Area, TResizeFilter::Bilinear };
+	TPixelCopyKernel::Type Kernels[] = { TPixelCopyKernel::Sse2, TPixelCopyKernel::Avx2, TPixelCopyKernel::Neon };
+
+	for ( auto Format : Formats )
+	{
+		//	same size is a copy, and a flat colour stays flat
+		{
+			std::vector<uint8_t> Pixels, Flat;
+			auto Plane = MakePlane( Pixels, 37, 11, Format );
+			FillRandom( Pixels, Random );
+			auto FlatPlane = MakePlane( Flat, 37, 11, Format );
+			std::fill( Flat.begin(), Flat.end(), 77 );
+			for ( auto Filter : Filters )
+			{
+				Expect( Resize( Plane, 37, 11, Filter ) == Pixels, "same size resize should be a copy" );
+				auto Resized = Resize( FlatPlane, 13, 29, Filter );
+				Expect( std::all_of( Resized.begin(), Resized.end(), [](uint8_t Value)	{	return Value == 77;	} ), "flat colour should stay flat" );
+			}
+		}
+
+		//	every simd kernel must match scalar exactly, for widths around the vector sizes
+		size_t DstWidths[] = { 1, 3, 4, 7, 8, 9, 16, 17, 33 };
+		for ( auto DstWidth : DstWidths )
+		{
+			for ( size_t Factor : { 2, 3, 4 } )
+			{
+				const size_t DstHeight = 3;
+				std::vector<uint8_t> Pixels;
+				auto Plane = MakePlane( Pixels, DstWidth*Factor, DstHeight*Factor, Format );
+				FillRandom( Pixels, Random );
+
+				for ( auto Filter : Filters )
+				{
+					auto Expected = Resize( Plane, DstWidth, DstHeight, Filter, true, TPixelCopyKernel::Scalar );
+					for ( auto Kernel : Kernels )
+					{
+						if ( !IsPixelCopyKernelSupported(Kernel) )
+							continue;
+						std::stringstream Description;
+						Description << GetPixelCopyKernelName(Kernel) << " " << Plane.mMeta << " /" << Factor << (Filter == TResizeFilter::Bilinear ? " bilinear" : " area") << " differs from scalar";
+						Expect( Resize( Plane, DstWidth, DstHeight, Filter, true, Kernel ) == Expected, Description.str() );
+					}
+				}
+			}
+		}
+	}
+
+	//	big planes are split across threads, which must give the same result
+	{
+		std::vector<uint8_t> Pixels;
+		auto Plane = MakePlane( Pixels, 2048, 1024, SoyPixelsFormat::Greyscale );
+		FillRandom( Pixels, Random );
+		for ( auto Filter : Filters )
+		{
+			Expect( Resize( Plane, 1024, 512, Filter, true ) == Resize( Plane, 1024, 512, Filter, false ), "threaded 1/2 resize differs" );
+			Expect( Resize( Plane, 700, 301, Filter, true ) == Resize( Plane, 700, 301, Filter, false ), "threaded resize differs" );
+		}
+	}
+
+	//	depth can't be averaged byte by byte
+	{
+		std::vector<uint8_t> Depth;
+		auto Plane = MakePlane( Depth, 4, 4, SoyPixelsFormat::Depth16mm );
+		BufferArray<TPlaneView,1> Planes;
+		Planes.PushBack( Plane );
+		auto PlanesBridge = GetArrayBridge(Planes);
+		Expect( !IsResizeNeeded( PlanesBridge, 2, 2 ), "depth shouldn't be resized" );
+	}
+}
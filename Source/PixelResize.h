@@ -0,0 +1,31 @@
+#pragma once
+
+#include "FramePlanes.h"
+#include "PixelCopy.h"
+
+
+//	resizing for OutputWidth/OutputHeight, done per plane while copying to the caller's buffer.
+//	Planes are resized in their own format, so chroma planes keep their subsampling & stay aligned with luma
+namespace PopCameraDevice
+{
+	//	true for formats of independent 8 bit channels. Depth, float & packed 422 can't be averaged byte by byte
+	bool			IsResizableFormat(SoyPixelsFormat::Type Format);
+
+	//	false if the planes are already this size, or any of them can't be resized
+	bool			IsResizeNeeded(ArrayBridge<TPlaneView>& Planes,size_t Width,size_t Height);
+
+	//	Width or Height of 0 keeps the aspect ratio from the other, both 0 keeps the size
+	SoyPixelsMeta	GetResizedMeta(const SoyPixelsMeta& Meta,size_t Width,size_t Height);
+	//	plane's size once its image (ImageMeta, the first plane) is resized to ResizedImageMeta. Subsampled planes round up
+	SoyPixelsMeta	GetResizedPlaneMeta(const SoyPixelsMeta& ImageMeta,const SoyPixelsMeta& ResizedImageMeta,const SoyPixelsMeta& PlaneMeta);
+
+	//	writes the first Rows rows of Src resized to DstMeta (which must be the same format).
+	//	Large planes are split across the resize worker threads unless AllowThreads is false.
+	//	Throws if the format can't be resized or the source is too small for its meta. Kernel picks the simd kernels (see CopyPixels)
+	void			ResizePlane(const TPlaneView& Src,const SoyPixelsMeta& DstMeta,uint8_t* Dst,size_t DstStride,size_t Rows,TResizeFilter::Type Filter,bool AllowThreads=true,TPixelCopyKernel::Type Kernel=TPixelCopyKernel::Auto);
+
+	//	stop & join the worker threads, after any resize using them. On windows process exit they've already been terminated, so they're let go (and leaked)
+	void			ShutdownResizeWorkers(bool ProcessExit);
+
+	void			PixelResize_UnitTests();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "FramePlanes.h"
+
+
+//	fixtures shared by the pixel convert & resize unit tests
+namespace PopCameraDevice
+{
+	namespace PixelTests
+	{
+		class TExpect;
+
+		//	view of Pixels as a Width x Height plane, growing Pixels if it's too small for that.
+		//	The view points into Pixels, so is invalid once Pixels reallocates
+		TPlaneView	MakePlane(std::vector<uint8_t>& Pixels,size_t Width,size_t Height,SoyPixelsFormat::Type Format);
+
+		//	repeatable noise (an LCG), Random is advanced so each call fills differently but every run is the same
+		void		FillRandom(std::vector<uint8_t>& Pixels,uint32_t& Random);
+	}
+}
+
+
+//	Expect(Condition,Description) throws "<TestName> test failed: <Description>" if Condition is false
+class PopCameraDevice::PixelTests::TExpect
+{
+public:
+	TExpect(const char* TestName) :
+		mTestName	( TestName )
+	{
+	}
+
+	void		operator()(bool Condition,const std::string& Description) const
+	{
+		if ( Condition )
+			return;
+		throw std::runtime_error( std::string(mTestName) + " test failed: " + Description );
+	}
+
+private:
+	const char*	mTestName;
+};
+
+
+inline PopCameraDevice::TPlaneView PopCameraDevice::PixelTests::MakePlane(std::vector<uint8_t>& Pixels,size_t Width,size_t Height,SoyPixelsFormat::Type Format)
+{
+	TPlaneView Plane;
+	Plane.mMeta = SoyPixelsMeta( Width, Height, Format );
+	if ( Pixels.size() < Plane.mMeta.GetDataSize() )
+		Pixels.resize( Plane.mMeta.GetDataSize() );
+	Plane.mPixels = Pixels.data();
+	Plane.mDataSize = Pixels.size();
+	return Plane;
+}
+
+inline void PopCameraDevice::PixelTests::FillRandom(std::vector<uint8_t>& Pixels,uint32_t& Random)
+{
+	for ( auto& Value : Pixels )
+	{
+		Random = Random * 1664525 + 1013904223;
+		Value = static_cast<uint8_t>( Random >> 24 );
+	}
+}
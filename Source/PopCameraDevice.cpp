@@ -4,8 +4,16 @@
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <shared_mutex>
 #include <HeapArray.hpp>
 #include "TestDevice.h"
+#include "Trace.h"
+#include "FramePlanes.h"
+#include "PixelCopy.h"
+#include "PixelConvert.h"
+#include "PixelResize.h"
 #include <SoyMedia.h>
 
 
@@ -27,6 +35,43 @@ namespace PopCameraDevice
 	const Soy::TVersion	Version(VERSION_MAJOR, VERSION_MINOR, VERSION_PATCH);
 	const int32_t		NoFrame = -1;
 	const int32_t		Error = -2;
+
+	//	size (including terminator) the last string output on this thread needed
+	thread_local int32_t	RequiredBufferSize = 0;
+
+	//	records the required size. Json is never truncated (a cut-off object is worse than none),
+	//	so if it doesn't fit, the buffer is emptied. Returns required size
+	int32_t		StringToBuffer(const std::string& String,char* Buffer,int32_t BufferSize,bool AllowTruncation=false);
+	//	empties an output buffer (if there is one) before it's written; nothing is required until something is
+	void		ClearBuffer(char* Buffer,int32_t BufferSize);
+}
+
+int32_t PopCameraDevice::StringToBuffer(const std::string& String,char* Buffer,int32_t BufferSize,bool AllowTruncation)
+{
+	auto Required = static_cast<int32_t>( String.length() + 1 );
+	RequiredBufferSize = Required;
+	if ( !Buffer || BufferSize <= 0 )
+		return Required;
+
+	if ( Required > BufferSize && !AllowTruncation )
+	{
+		Buffer[0] = '\0';
+		return Required;
+	}
+	Soy::StringToBuffer(String, Buffer, BufferSize);
+	return Required;
+}
+
+void PopCameraDevice::ClearBuffer(char* Buffer,int32_t BufferSize)
+{
+	RequiredBufferSize = 0;
+	if ( Buffer && BufferSize > 0 )
+		Buffer[0] = '\0';
+}
+
+__export int32_t PopCameraDevice_GetRequiredBufferSize()
+{
+	return PopCameraDevice::RequiredBufferSize;
 }
 
 __export int32_t PopCameraDevice_GetVersion()
@@ -90,14 +135,30 @@ public:
 
 namespace PopCameraDevice
 {
-	class TDeviceInstance;
+	class TDeviceSlot;
+	class TFrameLease;
 
-	TDevice&		GetCameraDevice(int32_t Instance);
-	TDevice&		GetCameraDevice(uint32_t Instance);
+	//	callers hold the returned reference for the duration of the call, so the device
+	//	can't be destroyed under them if it's freed on another thread
+	std::shared_ptr<TDevice>	GetCameraDevice(int32_t Instance);
 	uint32_t		CreateInstance(std::shared_ptr<TDevice> Device);
 	void			FreeInstance(uint32_t Instance);
-	int32_t			GetNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize, ArrayBridge<ArrayBridge<uint8_t>*>&& Planes, bool DeleteFrame);
-	void			AddOnNewFrameCallback(int32_t Instance,std::function<void()> Callback);
+	int32_t			GetNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize, ArrayBridge<ArrayBridge<uint8_t>*>&& Planes, bool DeleteFrame, bool SkipToLatest=false, uint64_t* HostTimeNs=nullptr, uint64_t* DeviceTimeNs=nullptr);
+	int32_t			PopFrames(int32_t Instance,int32_t MaxFrames,PopCameraDevice_FrameDescriptor* Descriptors,uint8_t* Arena,int32_t ArenaSize,char* JsonBuffer,int32_t JsonBufferSize);
+	//	Roi (optional) replaces the device's Roi option for this frame
+	int32_t			GetNextFrameInfo(int32_t Instance, PopCameraDevice_FrameInfo& FrameInfo, char* JsonBuffer, int32_t JsonBufferSize, ArrayBridge<ArrayBridge<uint8_t>*>&& Planes, bool DeleteFrame, bool SkipToLatest=false, const TRoi* Roi=nullptr);
+	int32_t			PopNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, bool SkipToLatest, uint64_t* HostTimeNs=nullptr, uint64_t* DeviceTimeNs=nullptr, PopCameraDevice_FrameInfo* FrameInfo=nullptr, const TRoi* Roi=nullptr);
+	//	the part of GetNextFrame & GetNextFrameInfo after the device lookup; gets the next frame (peek, pop or latest)
+	//	and copies its planes. Meta & FrameInfo are optional, so they're only built when wanted. False if no frame
+	bool			CopyNextFrame(TDevice& Device,TFrame& Frame,ArrayBridge<ArrayBridge<uint8_t>*>& Planes,bool DeleteFrame,bool SkipToLatest,const TRoi* Roi,json11::Json::object* Meta,PopCameraDevice_FrameInfo* FrameInfo);
+	void			GetFrameTimeMeta(const TFrame& Frame,json11::Json::object& Meta);
+	void			GetFrameInfo(const TFrame& Frame,PopCameraDevice_FrameInfo& FrameInfo);
+	bool			WaitForNextFrame(int32_t Instance,int32_t TimeoutMs);
+	int32_t			PeekNextFrameTime(int32_t Instance);	//	NoFrame if none queued
+	uint32_t		AddOnNewFrameCallback(int32_t Instance,std::function<void()> Callback);
+	void			RemoveOnNewFrameCallback(int32_t Instance,uint32_t Handle);
+	int32_t			LockNextFrame(int32_t Instance,char* JsonBuffer,int32_t JsonBufferSize,uint8_t** PlanePixels,int32_t* PlaneSizes,int32_t* PlaneStrides,int32_t PlaneCount,int32_t& LeaseId);
+	void			UnlockFrame(int32_t LeaseId);
 
 	uint32_t		CreateCameraDevice(const std::string& Name,json11::Json& Options);
 
@@ -105,9 +166,18 @@ namespace PopCameraDevice
 	//	we do a hail mary shutdown
 	void			Shutdown(bool ProcessExit);
 
-	std::mutex				InstancesLock;
-	Array<TDeviceInstance>	Instances;
-	uint32_t				InstancesCounter = 1;
+	//	instance id is generation<<InstanceSlotBits | slot index, so a lookup is an index
+	//	and an id from a freed device never matches the slot's next occupant
+	const uint32_t			InstanceSlotBits = 10;
+	const uint32_t			MaxInstanceSlots = 1 << InstanceSlotBits;
+	const uint32_t			MaxInstanceGeneration = (1u << (31-InstanceSlotBits)) - 1;	//	keep ids positive int32s
+	std::shared_mutex		InstancesLock;		//	shared for lookups, exclusive for create/free
+	Array<TDeviceSlot>		InstanceSlots;
+	Array<uint32_t>			FreeInstanceSlots;
+
+	std::mutex							LeasesLock;
+	Array<std::shared_ptr<TFrameLease>>	Leases;
+	int32_t								LeasesCounter = 1;
 
 	std::string				EnumDevicesJson();
 	void					EnumDevices(ArrayBridge< TDeviceAndFormats>&& DeviceAndFormats);
@@ -150,15 +220,44 @@ void __attribute__((destructor)) DllExit()
 }
 #endif
 
-class PopCameraDevice::TDeviceInstance
+class PopCameraDevice::TDeviceSlot
 {
 public:
 	std::shared_ptr<TDevice>	mDevice;
-	uint32_t					mInstanceId = 0;
+	uint32_t					mGeneration = 0;
+};
+
+//	a popped frame whose pixel buffer stays locked until the caller unlocks it,
+//	so they can read the planes in-place instead of us copying them out
+class PopCameraDevice::TFrameLease
+{
+public:
+	~TFrameLease();
 
-	bool						operator==(const uint32_t& InstanceId) const	{	return mInstanceId == InstanceId;	}
+	int32_t											mLeaseId = 0;
+	std::shared_ptr<TPixelBuffer>					mPixelBuffer;
+	bool											mLocked = false;
+	std::shared_ptr<TFrameQueue>					mQueue;			//	the held pixels count towards its byte budget until released
+	size_t											mHeldBytes = 0;
 };
 
+PopCameraDevice::TFrameLease::~TFrameLease()
+{
+	if ( !mLocked )
+		return;
+
+	try
+	{
+		mPixelBuffer->Unlock();
+	}
+	catch(std::exception& e)
+	{
+		std::Debug << "Exception unlocking leased frame " << mLeaseId << ": " << e.what() << std::endl;
+	}
+	if ( mQueue )
+		mQueue->OnFrameReleased( mHeldBytes );
+}
+
 
 
 void PushJsonKey(std::stringstream& Json, const char* Key, int PreTab = 1)
@@ -278,15 +377,6 @@ void GetObjectJson(const TDeviceAndFormats& DeviceAndFormats, std::stringstream&
 }
 
 
-void GetObjectJson(json11::Json::object& Json,const SoyPixelsMeta& PlaneMeta)
-{
-	Json["Width"] = static_cast<int>(PlaneMeta.GetWidth());
-	Json["Height"] = static_cast<int>(PlaneMeta.GetHeight());
-	Json["Format"] = SoyPixelsFormat::ToString(PlaneMeta.GetFormat());
-	Json["DataSize"] = static_cast<int>(PlaneMeta.GetDataSize());
-	Json["Channels"] = PlaneMeta.GetChannels();
-}
-
 void PopCameraDevice::EnumDevices(ArrayBridge<TDeviceAndFormats>&& DeviceAndFormats)
 {
 	auto EnumDevice = [&](const std::string& Name)
@@ -362,14 +452,6 @@ std::string PopCameraDevice::EnumDevicesJson()
 	return Json.str();
 }
 
-//	gr: make this safe!
-__export void PopCameraDevice_EnumCameraDevicesJson(char* StringBuffer,int32_t StringBufferLength)
-{
-	auto Json = PopCameraDevice::EnumDevicesJson();
-
-	Soy::StringToBuffer(Json, StringBuffer, StringBufferLength);
-}
-
 
 
 uint32_t PopCameraDevice::CreateCameraDevice(const std::string& Name,json11::Json& Options)
@@ -493,6 +575,17 @@ RETURN SafeCall(FUNC Function,const char* FunctionName,RETURN ErrorReturn)
 }
 
 
+__export int32_t PopCameraDevice_EnumCameraDevicesJson(char* StringBuffer,int32_t StringBufferLength)
+{
+	auto Function = [&]()
+	{
+		auto Json = PopCameraDevice::EnumDevicesJson();
+		return PopCameraDevice::StringToBuffer(Json, StringBuffer, StringBufferLength);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+
 __export int32_t PopCameraDevice_CreateCameraDevice(const char* Name,const char* OptionsJson, char* ErrorBuffer, int32_t ErrorBufferLength)
 {
 	try
@@ -514,215 +607,250 @@ __export int32_t PopCameraDevice_CreateCameraDevice(const char* Name,const char*
 	}
 	catch(std::exception& e)
 	{
-		Soy::StringToBuffer(e.what(), ErrorBuffer, ErrorBufferLength);
+		PopCameraDevice::StringToBuffer(e.what(), ErrorBuffer, ErrorBufferLength, true);
 		return 0;
 	}
 	catch(...)
 	{
-		Soy::StringToBuffer("Unknown exception", ErrorBuffer, ErrorBufferLength);
+		PopCameraDevice::StringToBuffer("Unknown exception", ErrorBuffer, ErrorBufferLength, true);
 		return 0;
 	}
 }
 
 
-PopCameraDevice::TDevice& PopCameraDevice::GetCameraDevice(int32_t Instance)
+std::shared_ptr<PopCameraDevice::TDevice> PopCameraDevice::GetCameraDevice(int32_t Instance)
 {
-	if ( Instance < 0 )
+	auto SlotIndex = static_cast<uint32_t>(Instance) & (MaxInstanceSlots-1);
+	auto Generation = static_cast<uint32_t>(Instance) >> InstanceSlotBits;
+
+	std::shared_ptr<TDevice> Device;
+	if ( Instance > 0 )
 	{
-		std::stringstream Error;
-		Error << "Invalid instance identifier " << Instance;
-		throw Soy::AssertException(Error.str());
+		std::shared_lock<std::shared_mutex> Lock(InstancesLock);
+		if ( SlotIndex < InstanceSlots.GetSize() && InstanceSlots[SlotIndex].mGeneration == Generation )
+			Device = InstanceSlots[SlotIndex].mDevice;
 	}
-	return GetCameraDevice( static_cast<uint32_t>( Instance ) );
-}
 
-PopCameraDevice::TDevice& PopCameraDevice::GetCameraDevice(uint32_t Instance)
-{
-	std::lock_guard<std::mutex> Lock(InstancesLock);
-	auto pInstance = Instances.Find(Instance);
-	auto* Device = pInstance ? pInstance->mDevice.get() : nullptr;
 	if ( !Device )
 	{
 		std::stringstream Error;
 		Error << "No instance/device matching " << Instance;
 		throw Soy::AssertException(Error.str());
 	}
-
-	return *Device;
+	return Device;
 }
 
 
 uint32_t PopCameraDevice::CreateInstance(std::shared_ptr<TDevice> Device)
 {
-	std::lock_guard<std::mutex> Lock(InstancesLock);
-	
-	TDeviceInstance Instance;
-	Instance.mInstanceId = InstancesCounter;
-	Instance.mDevice = Device;
-	Instances.PushBack(Instance);
+	std::lock_guard<std::shared_mutex> Lock(InstancesLock);
 
-	InstancesCounter++;
-	return Instance.mInstanceId;
+	uint32_t SlotIndex;
+	if ( !FreeInstanceSlots.IsEmpty() )
+	{
+		SlotIndex = FreeInstanceSlots.PopBack();
+	}
+	else
+	{
+		if ( InstanceSlots.GetSize() >= MaxInstanceSlots )
+			throw Soy::AssertException("Too many device instances");
+		SlotIndex = static_cast<uint32_t>( InstanceSlots.GetSize() );
+		InstanceSlots.PushBack( TDeviceSlot() );
+	}
+
+	auto& Slot = InstanceSlots[SlotIndex];
+	Slot.mGeneration = (Slot.mGeneration % MaxInstanceGeneration) + 1;
+	Slot.mDevice = Device;
+	return (Slot.mGeneration << InstanceSlotBits) | SlotIndex;
 }
 
 
 void PopCameraDevice::FreeInstance(uint32_t Instance)
 {
+	auto SlotIndex = Instance & (MaxInstanceSlots-1);
+	auto Generation = Instance >> InstanceSlotBits;
+
 	//	lock, pop, and destroy outside lock
-	TDeviceInstance InstanceCopy;
+	std::shared_ptr<TDevice> Device;
 	{
-		std::lock_guard<std::mutex> Lock(InstancesLock);
+		std::lock_guard<std::shared_mutex> Lock(InstancesLock);
+		if ( SlotIndex < InstanceSlots.GetSize() && InstanceSlots[SlotIndex].mGeneration == Generation )
+			Device = std::move( InstanceSlots[SlotIndex].mDevice );
 
-		auto InstanceIndex = Instances.FindIndex(Instance);
-		if (InstanceIndex < 0)
+		if ( !Device )
 		{
 			std::Debug << "No instance " << Instance << " to free" << std::endl;
 			return;
 		}
-		InstanceCopy = Instances.PopAt(InstanceIndex);
+		InstanceSlots[SlotIndex].mDevice.reset();
+		FreeInstanceSlots.PushBack(SlotIndex);
 	}
 
-	//	actual destroy outside lock
-	//	gr: this line isn't needed, scope of Instance does it. But to aid debugging
-	InstanceCopy.mDevice.reset();
+	//	anyone still waiting for a frame holds a reference, let them go
+	Device->ReleaseFrameWaiters();
+
+	//	actual destroy outside lock. If another call still holds a reference, it's destroyed when that call finishes
+	//	gr: this line isn't needed, scope of Device does it. But to aid debugging
+	Device.reset();
 }
 
 
 void PopCameraDevice::ReadNativeHandle(int32_t Instance,void* Handle)
 {
-	auto& Device = GetCameraDevice(Instance);
+	auto pDevice = GetCameraDevice(Instance);
+	auto& Device = *pDevice;
 	Device.ReadNativeHandle(Handle);
 }
 
 
 
-void GetJson(json11::Json::object& Json,SoyPixelsMeta PixelMeta)
+uint32_t PopCameraDevice::AddOnNewFrameCallback(int32_t Instance, std::function<void()> Callback)
 {
-	//	output all plane info
-	BufferArray<SoyPixelsMeta, 3> PlaneMetas;
-	PixelMeta.GetPlanes(GetArrayBridge(PlaneMetas));
+	auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+	auto& Device = *pDevice;
+	return Device.mOnNewFrameCallbacks.Add(Callback);
+}
 
-	json11::Json::array Planes;
-	for (auto p = 0; p < PlaneMetas.GetSize(); p++)
+void PopCameraDevice::RemoveOnNewFrameCallback(int32_t Instance,uint32_t Handle)
+{
+	auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+	auto& Device = *pDevice;
+	if ( !Device.mOnNewFrameCallbacks.Remove(Handle) )
 	{
-		auto& PlaneMeta = PlaneMetas[p];
-		json11::Json::object PlaneMetaObject;
-		GetObjectJson(PlaneMetaObject, PlaneMeta);
-		Planes.push_back(PlaneMetaObject);
+		std::stringstream Error;
+		Error << "No new frame callback " << Handle << " on instance " << Instance;
+		throw Soy::AssertException(Error);
 	}
+}
 
-	Json["Planes"] = Planes;
+
+void PopCameraDevice::GetFrameTimeMeta(const TFrame& Frame,json11::Json::object& Meta)
+{
+	//	json numbers are doubles, so these are exact up to ~104 days of uptime.
+	//	Use PopNextFrameWithTimestamps for the exact 64bit values
+	Meta["HostTimeNs"] = static_cast<double>(Frame.mHostTimeNs);
+	if ( Frame.mDeviceTimeNs != 0 )
+		Meta["DeviceTimeNs"] = static_cast<double>(Frame.mDeviceTimeNs);
 }
 
 
-void CopyPlanes(ArrayBridge<SoyPixelsImpl*>&& PlaneSrcs,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneDsts,json11::Json::object& JsonMeta)
+void PopCameraDevice::GetFrameInfo(const TFrame& Frame,PopCameraDevice_FrameInfo& FrameInfo)
 {
-	json11::Json::array PlaneMetas;
-	
-	for (auto p = 0; p <PlaneSrcs.GetSize(); p++)
-	{
-		auto& PlaneSrc = *PlaneSrcs[p];
-		//	gr: get meta first, even if there's no buffer (for peek!)
-		auto PlaneMeta = PlaneSrc.GetMeta();
-		json11::Json::object PlaneMetaObject;
-		GetObjectJson(PlaneMetaObject, PlaneMeta);
-		PlaneMetas.push_back(PlaneMetaObject);
-	
-		//	is there a buffer for this plane?
-		if (p >= PlaneDsts.GetSize())
-			continue;
-		auto* pPlaneDstArray = PlaneDsts[p];
-		if (!pPlaneDstArray)
-			continue;
-		
-		auto& PlaneSrcArray = PlaneSrc.GetPixelsArray();
-		auto& PlaneDstArray = *pPlaneDstArray;
-		
-		auto MaxSize = std::min(PlaneDstArray.GetDataSize(), PlaneSrcArray.GetDataSize());
-		//	copy as much as possible
-		auto PlaneSrcPixelsMin = GetRemoteArray(PlaneSrcArray.GetArray(), MaxSize);
-		PlaneDstArray.Copy(PlaneSrcPixelsMin);
-	}
-	JsonMeta["Planes"] = PlaneMetas;
-}
-
-void CopyPlanes(TPixelBuffer& PixelBuffer,ArrayBridge<ArrayBridge<uint8_t>*>& PlaneBuffers,json11::Json::object& JsonMeta,bool SplitPlanes)
-{
-	//	gr: we're losing this transform. go back through PixelBuffer implementations
-	//		to see if we explicitly sometimes reveal this transform ONLY on locking the 
-	//		pixel buffer, or if it always comes from preexisting meta
-	float3x3 Transform;
-	BufferArray<SoyPixelsImpl*, 10> Textures;
-	PixelBuffer.Lock(GetArrayBridge(Textures), Transform);
-	try
-	{
-		//	split planes of planes
-		BufferArray<std::shared_ptr<SoyPixelsImpl>, 10> Planes;
-		BufferArray<SoyPixelsImpl*,10> PlanePtrs;
-		if ( SplitPlanes )
-		{
-			for (auto t = 0; t < Textures.GetSize(); t++)
-			{
-				auto& Texture = *Textures[t];
-				Texture.SplitPlanes(GetArrayBridge(Planes));
-			}
-			for ( auto p=0;	p<Planes.GetSize();	p++ )
-				PlanePtrs.PushBack( Planes[p].get() );
-		}
-		else
-		{
-			//	just store originals (assuming theyre not split)
-			for (auto t = 0; t < Textures.GetSize(); t++)
-			{
-				auto& Texture = *Textures[t];
-				PlanePtrs.PushBack(&Texture);
-			}
-		}
+	FrameInfo.Version = PopCameraDevice_FrameInfoVersion;
+	FrameInfo.FrameNumber = Frame.mFrameNumber;
+	FrameInfo.HostTimeNs = Frame.mHostTimeNs;
+	FrameInfo.DeviceTimeNs = Frame.mDeviceTimeNs;
+	FrameInfo.FrameTime = static_cast<int32_t>(Frame.mFrameTime.GetTime());
+	Soy::StringToBuffer(Frame.mStreamName, FrameInfo.StreamName, std::size(FrameInfo.StreamName));
+}
+
 
-		CopyPlanes( GetArrayBridge(PlanePtrs), PlaneBuffers, JsonMeta );
-		PixelBuffer.Unlock();
+int32_t PopCameraDevice::GetNextFrameInfo(int32_t Instance,PopCameraDevice_FrameInfo& FrameInfo,char* JsonBuffer,int32_t JsonBufferSize,ArrayBridge<ArrayBridge<uint8_t>*>&& Planes,bool DeleteFrame,bool SkipToLatest,const TRoi* Roi)
+{
+	//	caller's struct may be an older (smaller) version, so fill our own and copy as much as they have room for
+	auto StructSize = FrameInfo.StructSize;
+	if ( StructSize < offsetof(PopCameraDevice_FrameInfo, FrameNumber) )
+	{
+		std::stringstream Error;
+		Error << "FrameInfo.StructSize(" << StructSize << ") too small, should be sizeof(PopCameraDevice_FrameInfo)=" << sizeof(PopCameraDevice_FrameInfo);
+		throw Soy::AssertException(Error);
 	}
-	catch (...)
+
+	PopCameraDevice::ClearBuffer(JsonBuffer, JsonBufferSize);
+
+	auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+	TFrame Frame;
+	PopCameraDevice_FrameInfo Info = {};
+	//	only build json if it's wanted
+	json11::Json::object Meta;
+	auto* pMeta = JsonBuffer ? &Meta : nullptr;
+	if ( !CopyNextFrame( *pDevice, Frame, Planes, DeleteFrame, SkipToLatest, Roi, pMeta, &Info ) )
+		return PopCameraDevice::NoFrame;
+
+	Info.StructSize = StructSize;
+	memcpy( &FrameInfo, &Info, std::min<size_t>(StructSize, sizeof(Info)) );
+
+	//	a popped frame can't be put back, so give the caller as much of its meta as fits
+	if ( JsonBuffer )
 	{
-		PixelBuffer.Unlock();
-		throw;
+		auto JsonString = Frame.GetMetaJson(Meta);
+		PopCameraDevice::StringToBuffer(JsonString, JsonBuffer, JsonBufferSize, DeleteFrame);
 	}
+
+	return Frame.mFrameTime.GetTime();
 }
 
 
-void PopCameraDevice::AddOnNewFrameCallback(int32_t Instance, std::function<void()> Callback)
+bool PopCameraDevice::CopyNextFrame(TDevice& Device,TFrame& Frame,ArrayBridge<ArrayBridge<uint8_t>*>& Planes,bool DeleteFrame,bool SkipToLatest,const TRoi* Roi,json11::Json::object* Meta,PopCameraDevice_FrameInfo* FrameInfo)
 {
-	auto& Device = PopCameraDevice::GetCameraDevice(Instance);
-	Device.mOnNewFrameCallbacks.PushBack(Callback);
+	size_t SkippedFrames = 0;
+	auto HasFrame = SkipToLatest ? Device.GetLatestFrame(Frame, SkippedFrames) : Device.GetNextFrame(Frame, DeleteFrame);
+	if ( !HasFrame )
+		return false;
+
+	if ( FrameInfo )
+		GetFrameInfo( Frame, *FrameInfo );
+
+	//	frame meta is already serialised, so only the extra device & plane meta is built here
+	if ( Meta )
+	{
+		Device.GetDeviceMeta(*Meta);
+		if ( SkipToLatest )
+			(*Meta)["SkippedFrames"] = static_cast<int>(SkippedFrames);
+		GetFrameTimeMeta( Frame, *Meta );
+	}
+
+	if ( Frame.mPixelBuffer )
+	{
+		TRACE_SCOPE("PopCameraDevice CopyPlanes");
+		const TOutputParams* Output = &Device.mOutputParams;
+		TOutputParams RoiOutput;
+		if ( Roi )
+		{
+			RoiOutput = Device.mOutputParams;
+			RoiOutput.mRoi = *Roi;
+			Output = &RoiOutput;
+		}
+		auto CopyStartNs = GetHostTimeNs();
+		auto CopiedBytes = CopyPlanes( *Frame.mPixelBuffer, Planes, Meta, FrameInfo, Device.mSplitPlanes, &Device.mPlaneLayouts, Output );
+		Device.OnFrameCopied( Frame, CopiedBytes, CopyStartNs );
+	}
+
+	if ( Meta )
+		Device.GetFrameStageMeta( Frame, *Meta );
+	return true;
 }
 
 
-int32_t PopCameraDevice::GetNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize, ArrayBridge<ArrayBridge<uint8_t>*>&& Planes,bool DeleteFrame)
+int32_t PopCameraDevice::GetNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize, ArrayBridge<ArrayBridge<uint8_t>*>&& Planes,bool DeleteFrame,bool SkipToLatest,uint64_t* HostTimeNs,uint64_t* DeviceTimeNs)
 {
 	try
 	{
-		//	always clear json buffer
-		if ( JsonBuffer )
-			Soy::StringToBuffer("", JsonBuffer, JsonBufferSize);
-
-		auto& Device = PopCameraDevice::GetCameraDevice(Instance);
+		//	always clear json buffer (and the required size, if there's no frame)
+		PopCameraDevice::ClearBuffer(JsonBuffer, JsonBufferSize);
+		if ( HostTimeNs )
+			*HostTimeNs = 0;
+		if ( DeviceTimeNs )
+			*DeviceTimeNs = 0;
+
+		auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
 		TFrame Frame;
-		if ( !Device.GetNextFrame(Frame, DeleteFrame ) )
+		//	copy meta out. Peeking with no buffer is a query for the required size
+		auto OutputMeta = JsonBuffer || !DeleteFrame;
+		json11::Json::object Meta;
+		if ( !CopyNextFrame( *pDevice, Frame, Planes, DeleteFrame, SkipToLatest, nullptr, OutputMeta ? &Meta : nullptr, nullptr ) )
 			return PopCameraDevice::NoFrame;
 
-		auto Meta = Frame.GetMetaJson();
-
-		//	get extra meta
-		Device.GetDeviceMeta(Meta);
-
-		CopyPlanes( *Frame.mPixelBuffer, Planes, Meta, Device.mSplitPlanes );
+		if ( HostTimeNs )
+			*HostTimeNs = Frame.mHostTimeNs;
+		if ( DeviceTimeNs )
+			*DeviceTimeNs = Frame.mDeviceTimeNs;
 
-		//	copy meta out
-		if (JsonBuffer)
+		if ( OutputMeta )
 		{
-			//	copy to output
-			auto JsonString = json11::Json(Meta).dump();
-			Soy::StringToBuffer(JsonString, JsonBuffer, JsonBufferSize);
+			//	copy to output. A popped frame can't be put back, so give the caller as much of its meta as fits
+			auto JsonString = Frame.GetMetaJson(Meta);
+			PopCameraDevice::StringToBuffer(JsonString, JsonBuffer, JsonBufferSize, DeleteFrame);
 		}
 
 		return Frame.mFrameTime.GetTime();
@@ -731,13 +859,13 @@ int32_t PopCameraDevice::GetNextFrame(int32_t Instance, char* JsonBuffer, int32_
 	{
 		std::stringstream Json;
 		Json << "{\"Exception\":\"" << e.what() << "\"}";
-		Soy::StringToBuffer(Json.str(), JsonBuffer, JsonBufferSize);
+		PopCameraDevice::StringToBuffer(Json.str(), JsonBuffer, JsonBufferSize);
 		throw;
 	}
 	catch (...)
 	{
 		std::string Json = "{\"Exception\":\"Unknown\"}";
-		Soy::StringToBuffer(Json, JsonBuffer, JsonBufferSize);
+		PopCameraDevice::StringToBuffer(Json, JsonBuffer, JsonBufferSize);
 		throw;
 	}
 }
@@ -745,6 +873,255 @@ int32_t PopCameraDevice::GetNextFrame(int32_t Instance, char* JsonBuffer, int32_
 
 
 
+int32_t PopCameraDevice::PopFrames(int32_t Instance,int32_t MaxFrames,PopCameraDevice_FrameDescriptor* Descriptors,uint8_t* Arena,int32_t ArenaSize,char* JsonBuffer,int32_t JsonBufferSize)
+{
+	PopCameraDevice::ClearBuffer(JsonBuffer, JsonBufferSize);
+
+	if ( MaxFrames < 0 || ArenaSize < 0 )
+		throw Soy::AssertException("PopFrames MaxFrames & ArenaSize cannot be negative");
+	if ( MaxFrames > 0 && !Descriptors )
+		throw Soy::AssertException("PopFrames missing descriptors");
+	if ( ArenaSize > 0 && !Arena )
+		throw Soy::AssertException("PopFrames missing arena");
+
+	auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+	auto& Device = *pDevice;
+	json11::Json::object DeviceMeta;
+
+	//	frames are sized as they'll be output before they're popped, so one that doesn't fit stays queued.
+	//	One that can't be output at all (eg. too many planes) is popped if it's first, and errors when copied,
+	//	so it doesn't block the queue; later in the batch it's left for the next call
+	size_t SizedFrames = 0;
+	size_t LastFrameBytes = 0;
+	auto GetArenaBytes = [&](const TFrame& Frame) -> size_t
+	{
+		SizedFrames++;
+		LastFrameBytes = 0;
+		if ( !Frame.mPixelBuffer )
+			return 0;
+		try
+		{
+			LastFrameBytes = GetArenaDataSize( *Frame.mPixelBuffer, Device.mSplitPlanes, &Device.mPlaneLayouts, &Device.mOutputParams );
+			return LastFrameBytes;
+		}
+		catch(std::exception&)
+		{
+			return SizedFrames == 1 ? 0 : std::numeric_limits<size_t>::max();
+		}
+	};
+	Array<std::shared_ptr<TFrame>> Popped;
+	Device.PopFrames( GetArrayBridge(Popped), MaxFrames, ArenaSize, GetArenaBytes );
+
+	//	the next frame was sized but didn't fit; this is how much arena it needs
+	size_t NextFrameBytes = ( SizedFrames > Popped.GetSize() ) ? LastFrameBytes : 0;
+	if ( !Popped.IsEmpty() )
+		Device.GetDeviceMeta(DeviceMeta);
+
+	std::string Json = "[";
+	size_t ArenaUsed = 0;
+	int32_t FrameCount = 0;
+	std::string FirstCopyError;
+	for ( auto f=0;	f<Popped.GetSize();	f++ )
+	{
+		auto& Frame = *Popped[f];
+		auto& Descriptor = Descriptors[FrameCount];
+		Descriptor = PopCameraDevice_FrameDescriptor();
+		Descriptor.FrameTime = Frame.mFrameTime.GetTime();
+		Descriptor.HostTimeNs = Frame.mHostTimeNs;
+		Descriptor.DeviceTimeNs = Frame.mDeviceTimeNs;
+
+		auto Meta = DeviceMeta;
+		GetFrameTimeMeta( Frame, Meta );
+		if ( Frame.mPixelBuffer )
+		{
+			TRACE_SCOPE("PopCameraDevice CopyPlanes");
+			auto CopyStartNs = GetHostTimeNs();
+			auto ArenaStart = ArenaUsed;
+			try
+			{
+				CopyPlanesToArena( *Frame.mPixelBuffer, Device.mSplitPlanes, &Device.mPlaneLayouts, &Device.mOutputParams, Arena, ArenaSize, ArenaUsed, Descriptor, Meta );
+			}
+			catch(std::exception& e)
+			{
+				//	the frame has been popped, so is dropped. The rest of the batch is still returned,
+				//	it's only an error if there's nothing to return
+				ArenaUsed = ArenaStart;
+				if ( FirstCopyError.empty() )
+					FirstCopyError = e.what();
+				std::Debug << __PRETTY_FUNCTION__ << " dropping frame " << Descriptor.FrameTime << " which failed to copy; " << e.what() << std::endl;
+				continue;
+			}
+			Device.OnFrameCopied( Frame, ArenaUsed - ArenaStart, CopyStartNs );
+		}
+		Device.GetFrameStageMeta( Frame, Meta );
+
+		if ( FrameCount > 0 )
+			Json += ',';
+		Json += Frame.GetMetaJson(Meta);
+		FrameCount++;
+	}
+	Json += ']';
+
+	if ( FrameCount == 0 && !FirstCopyError.empty() )
+		throw Soy::AssertException(FirstCopyError);
+
+	if ( FrameCount == 0 && NextFrameBytes > 0 )
+	{
+		RequiredBufferSize = static_cast<int32_t>( std::min<size_t>( NextFrameBytes, std::numeric_limits<int32_t>::max() ) );
+		std::stringstream Error;
+		Error << "PopFrames arena (" << ArenaSize << " bytes) too small for next frame (" << NextFrameBytes << " bytes)";
+		throw Soy::AssertException(Error);
+	}
+
+	//	the frames are popped, so give the caller as much of their meta as fits
+	if ( JsonBuffer && FrameCount > 0 )
+		PopCameraDevice::StringToBuffer(Json, JsonBuffer, JsonBufferSize, true);
+
+	//	arena needed to have popped the next frame too, so the caller can grow it
+	RequiredBufferSize = static_cast<int32_t>( std::min<size_t>( ArenaUsed + NextFrameBytes, std::numeric_limits<int32_t>::max() ) );
+	return FrameCount;
+}
+
+bool PopCameraDevice::WaitForNextFrame(int32_t Instance,int32_t TimeoutMs)
+{
+	if ( TimeoutMs < 0 )
+	{
+		std::stringstream Error;
+		Error << "Invalid timeout " << TimeoutMs << "ms";
+		throw Soy::AssertException(Error);
+	}
+
+	//	we hold a reference, not the instances lock, whilst we block
+	auto Device = GetCameraDevice(Instance);
+	return Device->WaitForNextFrame( static_cast<size_t>(TimeoutMs) );
+}
+
+int32_t PopCameraDevice::PeekNextFrameTime(int32_t Instance)
+{
+	auto Device = GetCameraDevice(Instance);
+	SoyTime FrameTime;
+	if ( !Device->PeekNextFrameTime(FrameTime) )
+		return NoFrame;
+	return FrameTime.GetTime();
+}
+
+int32_t PopCameraDevice::LockNextFrame(int32_t Instance,char* JsonBuffer,int32_t JsonBufferSize,uint8_t** PlanePixels,int32_t* PlaneSizes,int32_t* PlaneStrides,int32_t PlaneCount,int32_t& LeaseId)
+{
+	LeaseId = 0;
+	PopCameraDevice::ClearBuffer(JsonBuffer, JsonBufferSize);
+
+	auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+	auto& Device = *pDevice;
+
+	//	lock the next frame before popping it, so if locking fails the frame is still queued.
+	//	The lease unlocks the buffer if anything below throws
+	float3x3 Transform;
+	BufferArray<SoyPixelsImpl*, 10> Textures;
+	auto LockFrame = [&](const TFrame& Frame)
+	{
+		auto Lease = std::make_shared<TFrameLease>();
+		Lease->mPixelBuffer = Frame.mPixelBuffer;
+		Textures.Clear(false);
+		if ( Lease->mPixelBuffer )
+		{
+			Lease->mPixelBuffer->Lock(GetArrayBridge(Textures), Transform);
+			Lease->mLocked = true;
+		}
+		return Lease;
+	};
+
+	TFrame NextFrame;
+	if ( !Device.GetNextFrame(NextFrame, false) )
+		return PopCameraDevice::NoFrame;
+	auto Lease = LockFrame(NextFrame);
+
+	TFrame Frame;
+	if ( !Device.GetNextFrame(Frame, true) )
+		return PopCameraDevice::NoFrame;
+	//	another consumer (or culling) took the frame between the peek & pop, so lock the one we got instead
+	if ( Frame.mPixelBuffer != Lease->mPixelBuffer )
+	{
+		Lease.reset();
+		Lease = LockFrame(Frame);
+	}
+
+	//	the popped frame's pixels are still held until UnlockFrame
+	Lease->mQueue = Device.GetFrameQueue();
+	Lease->mHeldBytes = Frame.mDataSize;
+	Lease->mQueue->OnFrameHeld( Lease->mHeldBytes );
+
+	json11::Json::object Meta;
+	Device.GetDeviceMeta(Meta);
+	GetFrameTimeMeta( Frame, Meta );
+
+	//	views into the locked pixels
+	BufferArray<TPlaneView,10> Planes;
+	auto TexturesBridge = GetArrayBridge(Textures);
+	GetPlaneViews( TexturesBridge, Device.mSplitPlanes, &Device.mPlaneLayouts, GetArrayBridge(Planes) );
+
+	//	no destination buffers, this just writes plane meta
+	BufferArray<ArrayBridge<uint8_t>*,1> NoBuffers;
+	auto NoBuffersBridge = GetArrayBridge(NoBuffers);
+	CopyPlanes( GetArrayBridge(Planes), NoBuffersBridge, &Meta, nullptr );
+
+	//	planes we don't have are nulled
+	for ( auto p=0;	p<PlaneCount;	p++ )
+	{
+		auto* Plane = (p < Planes.GetSize()) ? &Planes[p] : nullptr;
+		if ( PlanePixels )
+			PlanePixels[p] = Plane ? Plane->mPixels : nullptr;
+		if ( PlaneSizes )
+			PlaneSizes[p] = Plane ? static_cast<int32_t>(Plane->mDataSize) : 0;
+		if ( PlaneStrides )
+			PlaneStrides[p] = Plane ? static_cast<int32_t>(Plane->mMeta.GetRowDataSize()) : 0;
+	}
+
+	//	nothing copied, the locked planes count as the Copied stage
+	Device.OnFrameCopied( Frame, 0, 0 );
+	Device.GetFrameStageMeta( Frame, Meta );
+
+	{
+		std::lock_guard<std::mutex> Lock(LeasesLock);
+		Lease->mLeaseId = LeasesCounter++;
+		Leases.PushBack(Lease);
+	}
+	LeaseId = Lease->mLeaseId;
+	Meta["LeaseId"] = LeaseId;
+
+	//	the frame is popped, so give the caller as much of its meta as fits
+	if ( JsonBuffer )
+	{
+		auto JsonString = Frame.GetMetaJson(Meta);
+		PopCameraDevice::StringToBuffer(JsonString, JsonBuffer, JsonBufferSize, true);
+	}
+
+	return Frame.mFrameTime.GetTime();
+}
+
+void PopCameraDevice::UnlockFrame(int32_t LeaseId)
+{
+	//	pop under lock, unlock the pixel buffer outside it
+	std::shared_ptr<TFrameLease> Lease;
+	{
+		std::lock_guard<std::mutex> Lock(LeasesLock);
+		for ( auto i=0;	i<Leases.GetSize();	i++ )
+		{
+			if ( Leases[i]->mLeaseId != LeaseId )
+				continue;
+			Lease = Leases.PopAt(i);
+			break;
+		}
+	}
+
+	if ( !Lease )
+	{
+		std::stringstream Error;
+		Error << "No frame lease " << LeaseId << " to unlock";
+		throw Soy::AssertException(Error);
+	}
+}
+
+
 __export int32_t PopCameraDevice_PeekNextFrame(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize)
 {
 	BufferArray<ArrayBridge<uint8_t>*,1> NoBuffers;
@@ -752,7 +1129,7 @@ __export int32_t PopCameraDevice_PeekNextFrame(int32_t Instance, char* JsonBuffe
 	return PopCameraDevice::GetNextFrame(Instance, JsonBuffer, JsonBufferSize, GetArrayBridge(NoBuffers), DeleteFrame);
 }
 
-__export void PopCameraDevice_AddOnNewFrameCallback(int32_t Instance, PopCameraDevice_OnNewFrame* Callback, void* Meta)
+__export int32_t PopCameraDevice_AddOnNewFrameCallback(int32_t Instance, PopCameraDevice_OnNewFrame* Callback, void* Meta)
 {
 	auto Function = [&]()
 	{
@@ -763,7 +1140,17 @@ __export void PopCameraDevice_AddOnNewFrameCallback(int32_t Instance, PopCameraD
 		{
 			Callback(Meta);
 		};
-		PopCameraDevice::AddOnNewFrameCallback(Instance, Lambda);
+		auto Handle = PopCameraDevice::AddOnNewFrameCallback(Instance, Lambda);
+		return static_cast<int32_t>(Handle);
+	};
+	return SafeCall(Function, __func__, 0);
+}
+
+__export void PopCameraDevice_RemoveOnNewFrameCallback(int32_t Instance, int32_t CallbackHandle)
+{
+	auto Function = [&]()
+	{
+		PopCameraDevice::RemoveOnNewFrameCallback(Instance, static_cast<uint32_t>(CallbackHandle));
 		return 0;
 	};
 	SafeCall(Function, __func__, 0);
@@ -782,34 +1169,206 @@ __export void PopCameraDevice_FreeCameraDevice(int32_t Instance)
 
 
 
+int32_t PopCameraDevice::PopNextFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, bool SkipToLatest, uint64_t* HostTimeNs, uint64_t* DeviceTimeNs, PopCameraDevice_FrameInfo* FrameInfo, const TRoi* Roi)
+{
+	auto Plane0Array = GetRemoteArray(Plane0, Plane0Size);
+	auto Plane1Array = GetRemoteArray(Plane1, Plane1Size);
+	auto Plane2Array = GetRemoteArray(Plane2, Plane2Size);
+	auto Plane0ArrayBridge = GetArrayBridge(Plane0Array);
+	auto Plane1ArrayBridge = GetArrayBridge(Plane1Array);
+	auto Plane2ArrayBridge = GetArrayBridge(Plane2Array);
+	BufferArray<ArrayBridge<uint8_t>*, 3> PlaneArrays;
+	PlaneArrays.PushBack(&Plane0ArrayBridge);
+	PlaneArrays.PushBack(&Plane1ArrayBridge);
+	PlaneArrays.PushBack(&Plane2ArrayBridge);
+
+	auto DeleteFrame = true;
+	if ( FrameInfo )
+		return GetNextFrameInfo(Instance, *FrameInfo, MetaJsonBuffer, MetaJsonBufferSize, GetArrayBridge(PlaneArrays), DeleteFrame, SkipToLatest, Roi);
+	return GetNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, GetArrayBridge(PlaneArrays), DeleteFrame, SkipToLatest, HostTimeNs, DeviceTimeNs);
+}
+
 __export int32_t PopCameraDevice_PopNextFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size)
 {
 	auto Function = [&]()
 	{
-		auto Plane0Array = GetRemoteArray(Plane0, Plane0Size);
-		auto Plane1Array = GetRemoteArray(Plane1, Plane1Size);
-		auto Plane2Array = GetRemoteArray(Plane2, Plane2Size);
-		auto Plane0ArrayBridge = GetArrayBridge(Plane0Array);
-		auto Plane1ArrayBridge = GetArrayBridge(Plane1Array);
-		auto Plane2ArrayBridge = GetArrayBridge(Plane2Array);
-		BufferArray<ArrayBridge<uint8_t>*, 3> PlaneArrays;
-		PlaneArrays.PushBack(&Plane0ArrayBridge);
-		PlaneArrays.PushBack(&Plane1ArrayBridge);
-		PlaneArrays.PushBack(&Plane2ArrayBridge);
-
-		auto DeleteFrame = true;
-		auto Result = PopCameraDevice::GetNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, GetArrayBridge(PlaneArrays), DeleteFrame);
+		auto SkipToLatest = false;
+		return PopCameraDevice::PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size, SkipToLatest);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PeekNextFrameInfo(int32_t Instance, PopCameraDevice_FrameInfo* FrameInfo)
+{
+	auto Function = [&]()
+	{
+		if ( !FrameInfo )
+			throw Soy::AssertException("PeekNextFrameInfo missing FrameInfo");
+		BufferArray<ArrayBridge<uint8_t>*,1> NoBuffers;
+		auto DeleteFrame = false;
+		return PopCameraDevice::GetNextFrameInfo(Instance, *FrameInfo, nullptr, 0, GetArrayBridge(NoBuffers), DeleteFrame);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopNextFrameInfo(int32_t Instance, PopCameraDevice_FrameInfo* FrameInfo, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size)
+{
+	auto Function = [&]()
+	{
+		if ( !FrameInfo )
+			throw Soy::AssertException("PopNextFrameInfo missing FrameInfo");
+		auto SkipToLatest = false;
+		return PopCameraDevice::PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size, SkipToLatest, nullptr, nullptr, FrameInfo);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopNextFrameRoi(int32_t Instance, int32_t RoiX, int32_t RoiY, int32_t RoiWidth, int32_t RoiHeight, PopCameraDevice_FrameInfo* FrameInfo, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size)
+{
+	auto Function = [&]()
+	{
+		if ( !FrameInfo )
+			throw Soy::AssertException("PopNextFrameRoi missing FrameInfo");
+		if ( RoiX < 0 || RoiY < 0 || RoiWidth < 0 || RoiHeight < 0 )
+			throw Soy::AssertException("PopNextFrameRoi Roi cannot be negative");
+		PopCameraDevice::TRoi Roi;
+		Roi.mX = RoiX;
+		Roi.mY = RoiY;
+		Roi.mWidth = RoiWidth;
+		Roi.mHeight = RoiHeight;
+		auto SkipToLatest = false;
+		return PopCameraDevice::PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size, SkipToLatest, nullptr, nullptr, FrameInfo, &Roi);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopNextFrameWithTimestamps(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, uint64_t* HostTimeNs, uint64_t* DeviceTimeNs)
+{
+	auto Function = [&]()
+	{
+		auto SkipToLatest = false;
+		return PopCameraDevice::PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size, SkipToLatest, HostTimeNs, DeviceTimeNs);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopFrames(int32_t Instance, int32_t MaxFrames, PopCameraDevice_FrameDescriptor* Descriptors, uint8_t* Arena, int32_t ArenaSize, char* MetaJsonBuffer, int32_t MetaJsonBufferSize)
+{
+	auto Function = [&]()
+	{
+		return PopCameraDevice::PopFrames(Instance, MaxFrames, Descriptors, Arena, ArenaSize, MetaJsonBuffer, MetaJsonBufferSize);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopLatestFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size)
+{
+	auto Function = [&]()
+	{
+		auto SkipToLatest = true;
+		return PopCameraDevice::PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size, SkipToLatest);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+
+__export int32_t PopCameraDevice_LockNextFrame(int32_t Instance,char* MetaJsonBuffer,int32_t MetaJsonBufferSize,uint8_t** PlanePixels,int32_t* PlaneSizes,int32_t* PlaneStrides,int32_t PlaneCount,int32_t* LeaseId)
+{
+	auto Function = [&]()
+	{
+		int32_t NewLeaseId = 0;
+		auto Result = PopCameraDevice::LockNextFrame( Instance, MetaJsonBuffer, MetaJsonBufferSize, PlanePixels, PlaneSizes, PlaneStrides, PlaneCount, NewLeaseId );
+		if ( LeaseId )
+			*LeaseId = NewLeaseId;
 		return Result;
 	};
 	return SafeCall(Function, __func__, PopCameraDevice::Error);
 }
 
+__export void PopCameraDevice_UnlockFrame(int32_t LeaseId)
+{
+	auto Function = [&]()
+	{
+		PopCameraDevice::UnlockFrame(LeaseId);
+		return 0;
+	};
+	SafeCall(Function, __func__, 0);
+}
+
+
+__export int32_t PopCameraDevice_WaitForNextFrame(int32_t Instance,int32_t TimeoutMs)
+{
+	auto Function = [&]()
+	{
+		if ( !PopCameraDevice::WaitForNextFrame(Instance, TimeoutMs) )
+			return PopCameraDevice::NoFrame;
+
+		//	only the time is returned, so don't build any meta
+		return PopCameraDevice::PeekNextFrameTime(Instance);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_PopNextFrameWithTimeout(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, int32_t TimeoutMs)
+{
+	auto Function = [&]()
+	{
+		//	always clear json buffer, as PopNextFrame would
+		if ( !PopCameraDevice::WaitForNextFrame(Instance, TimeoutMs) )
+		{
+			PopCameraDevice::ClearBuffer(MetaJsonBuffer, MetaJsonBufferSize);
+			return PopCameraDevice::NoFrame;
+		}
+		return PopCameraDevice_PopNextFrame(Instance, MetaJsonBuffer, MetaJsonBufferSize, Plane0, Plane0Size, Plane1, Plane1Size, Plane2, Plane2Size);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+
+__export int32_t PopCameraDevice_GetFrameEventFd(int32_t Instance)
+{
+	auto Function = [&]()
+	{
+		auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+		auto& Device = *pDevice;
+		return static_cast<int32_t>( Device.GetFrameEventFd() );
+	};
+	return SafeCall(Function, __func__, -1);
+}
+
+__export int32_t PopCameraDevice_GetStatsJson(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize)
+{
+	auto Function = [&]()
+	{
+		auto pDevice = PopCameraDevice::GetCameraDevice(Instance);
+		auto& Device = *pDevice;
+		json11::Json::object Stats;
+		Device.GetStats(Stats);
+		auto Json = json11::Json(Stats).dump();
+		return PopCameraDevice::StringToBuffer(Json, JsonBuffer, JsonBufferSize);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
+__export int32_t PopCameraDevice_DumpTrace(const char* Filename)
+{
+	auto Function = [&]()
+	{
+		if ( !Filename )
+			throw Soy::AssertException("PopCameraDevice_DumpTrace null filename");
+		auto EventCount = PopCameraDevice::DumpTrace(Filename);
+		return static_cast<int32_t>(EventCount);
+	};
+	return SafeCall(Function, __func__, PopCameraDevice::Error);
+}
+
 
 void PopCameraDevice::Shutdown(bool ProcessExit)
 {
 #if defined(ENABLE_FREENECT)
 	Freenect::Shutdown(ProcessExit);
 #endif
+	ShutdownResizeWorkers(ProcessExit);
 }
 
 __export void PopCameraDevice_Cleanup()
@@ -820,6 +1379,13 @@ __export void PopCameraDevice_Cleanup()
 __export void PopCameraDevice_UnitTests()
 {
 	PopCameraDevice::DecodeFormatString_UnitTests();
+	PopCameraDevice::FrameQueue_UnitTests();
+	PopCameraDevice::DeviceStats_UnitTests();
+	PopCameraDevice::Trace_UnitTests();
+	PopCameraDevice::PixelCopy_UnitTests();
+	PopCameraDevice::FramePlanes_UnitTests();
+	PopCameraDevice::PixelConvert_UnitTests();
+	PopCameraDevice::PixelResize_UnitTests();
 }
 
 __export void PopCameraDevice_ReadNativeHandle(int32_t Instance,void* Handle)
@@ -832,6 +1398,16 @@ __export void PopCameraDevice_ReadNativeHandle(int32_t Instance,void* Handle)
 	SafeCall(Function, __func__, 0);
 }
 
+__export void PopCameraDevice_SetGlobalMaxFrameBytes(uint64_t MaxBytes)
+{
+	auto Function = [&]()
+	{
+		PopCameraDevice::SetGlobalMaxFrameBytes( static_cast<size_t>(MaxBytes) );
+		return 0;
+	};
+	SafeCall(Function, __func__, 0);
+}
+
 
 
 __export void UnityPluginLoad(/*IUnityInterfaces*/void*)
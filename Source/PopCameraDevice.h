@@ -8,6 +8,55 @@
 //	constant for invalid instance numbers, to avoid use of magic-number 0 around code bases
 enum { PopCameraDevice_NullInstance=0 };
 
+//	most planes a frame descriptor can describe
+enum { PopCameraDevice_MaxPlanes=4 };
+
+//	one frame written by PopCameraDevice_PopFrames
+struct PopCameraDevice_FrameDescriptor
+{
+	int32_t		FrameTime;									//	same as PopNextFrame's return value
+	int32_t		PlaneCount;
+	int32_t		PlaneOffsets[PopCameraDevice_MaxPlanes];	//	byte offset of each plane's pixels in the arena
+	int32_t		PlaneSizes[PopCameraDevice_MaxPlanes];
+	uint64_t	HostTimeNs;									//	see PopCameraDevice_PopNextFrameWithTimestamps
+	uint64_t	DeviceTimeNs;
+};
+
+//	PopCameraDevice_FrameInfo layout version. Fields are only ever appended, so older callers
+//	(with a smaller StructSize) still work.
+//	2: Roi
+enum { PopCameraDevice_FrameInfoVersion=2 };
+enum { PopCameraDevice_MaxNameLength=32 };
+
+struct PopCameraDevice_PlaneInfo
+{
+	int32_t		Width;
+	int32_t		Height;
+	int32_t		Channels;
+	int32_t		DataSize;
+	int32_t		RowStride;									//	bytes per row
+	int32_t		Format;										//	SoyPixelsFormat value
+	char		FormatName[PopCameraDevice_MaxNameLength];	//	same as meta's Format, eg. Greyscale, Depth16mm
+};
+
+//	fixed-layout frame description, so the hot fields don't need the json meta parsing every frame
+struct PopCameraDevice_FrameInfo
+{
+	uint32_t	StructSize;			//	caller sets this to sizeof(PopCameraDevice_FrameInfo), no more than this is written
+	uint32_t	Version;			//	written as PopCameraDevice_FrameInfoVersion of the library
+	uint64_t	FrameNumber;		//	per device, counts every frame pushed, so gaps are frames culled/skipped
+	uint64_t	HostTimeNs;			//	see PopCameraDevice_PopNextFrameWithTimestamps
+	uint64_t	DeviceTimeNs;
+	int32_t		FrameTime;			//	same as PopNextFrame's return value
+	int32_t		PlaneCount;
+	struct PopCameraDevice_PlaneInfo	Planes[PopCameraDevice_MaxPlanes];
+	char		StreamName[PopCameraDevice_MaxNameLength];	//	empty if the device doesn't name its streams
+	int32_t		RoiX;				//	area of the image the planes were cropped to (after aligning to chroma samples), all 0 if not cropped
+	int32_t		RoiY;
+	int32_t		RoiWidth;
+	int32_t		RoiHeight;
+};
+
 #if !defined(__export)
 
 #if defined(_MSC_VER) && !defined(TARGET_PS4)	//	_MSC_VER = visual studio
@@ -34,6 +83,17 @@ enum { PopCameraDevice_NullInstance=0 };
 #define POPCAMERADEVICE_KEY_DEPTHFORMAT	"DepthFormat"
 #define POPCAMERADEVICE_KEY_DEBUG		"Debug"			//	extra verbose debug output
 #define POPCAMERADEVICE_KEY_SPLITPLANES	"SplitPlanes"	//	by default we split YUV formats into multiple planes
+#define POPCAMERADEVICE_KEY_QUEUEPOLICY		"QueuePolicy"		//	DropOldest (default), DropNewest, LatestOnly, BlockProducer
+#define POPCAMERADEVICE_KEY_MAXFRAMEBUFFERS	"MaxFrameBuffers"	//	max frames queued before QueuePolicy applies (default 13)
+#define POPCAMERADEVICE_KEY_QUEUETIMEOUTMS	"QueueTimeoutMs"	//	BlockProducer waits this long before dropping a new frame (default 1000)
+#define POPCAMERADEVICE_KEY_MAXFRAMEBYTES	"MaxFrameBytes"		//	max bytes of pixel data queued before QueuePolicy applies (default 0, unlimited)
+#define POPCAMERADEVICE_KEY_ASYNCCALLBACKS	"AsyncCallbacks"	//	call OnNewFrame callbacks from a per-device thread instead of the capture thread. Bursts of frames are coalesced into one call
+#define POPCAMERADEVICE_KEY_STAGELATENCYMETA	"StageLatencyMeta"	//	add StageLatencyMs to frame meta; ms spent reaching each pipeline stage (BackendCallback, Enqueue, Dequeue, Copied) from the previous one
+#define POPCAMERADEVICE_KEY_OUTPUTFORMAT	"OutputFormat"		//	RGBA, BGRA, RGB or Greyscale; colour frames are converted to this as they're popped (one plane). Depth frames & LockNextFrame are left as-is
+#define POPCAMERADEVICE_KEY_OUTPUTWIDTH		"OutputWidth"		//	colour frames are resized to this as they're popped, with chroma planes scaled to match. 0 (default) keeps the aspect ratio from OutputHeight
+#define POPCAMERADEVICE_KEY_OUTPUTHEIGHT	"OutputHeight"		//	0 (default) keeps the aspect ratio from OutputWidth. Depth frames & LockNextFrame are left at their own size
+#define POPCAMERADEVICE_KEY_RESIZEFILTER	"ResizeFilter"		//	Area (default, best for downscaling) or Bilinear
+#define POPCAMERADEVICE_KEY_ROI				"Roi"				//	[x,y,width,height] in the image's pixels; popped frames (depth too) only copy this area, before OutputFormat & resizing. Widened to whole chroma samples, planes' meta has their Roi. LockNextFrame is left whole
 
 //	ARKit options
 #define POPCAMERADEVICE_KEY_HDRCOLOUR				"HdrColour"		//	probably wants to be a specific colour format
@@ -57,11 +117,21 @@ enum { PopCameraDevice_NullInstance=0 };
 #define POPCAMERADEVICE_KEY_SYNCSECONDARY			"SyncSecondary"
 
 
+//	String outputs (meta json, error buffers):
+//	json is never truncated; if it doesn't fit, the buffer is emptied instead of holding cut-off json.
+//	The exception is meta from calls which pop frames (PopNextFrame, PopFrames, LockNextFrame...), which is
+//	cut to fit as the frame can't be put back; Peek first to size the buffer.
+//	Every string output records the size it needed (including terminator), which
+//	PopCameraDevice_GetRequiredBufferSize returns for the last call on the same thread (0 if nothing was output).
+//	Size buffers from that once and reuse them
+__export int32_t			PopCameraDevice_GetRequiredBufferSize();
+
 //	function pointer type for new frame callback
 typedef void PopCameraDevice_OnNewFrame(void* Meta);
 
 //	enum every availible device and their availible formats as Json
-__export void				PopCameraDevice_EnumCameraDevicesJson(char* StringBuffer,int32_t StringBufferLength);
+//	returns the size (including terminator) the json needs, pass a null buffer to query it.
+__export int32_t			PopCameraDevice_EnumCameraDevicesJson(char* StringBuffer,int32_t StringBufferLength);
 
 //	create a new device. Options are optional.
 //	Returns instance ID (0 on error)
@@ -69,19 +139,89 @@ __export int32_t			PopCameraDevice_CreateCameraDevice(const char* Name,const cha
 
 __export void				PopCameraDevice_FreeCameraDevice(int32_t Instance);
 
-//	register a callback function when a new frame is ready. This is expected to exist until released
-__export void				PopCameraDevice_AddOnNewFrameCallback(int32_t Instance, PopCameraDevice_OnNewFrame* Callback, void* Meta);
+//	register a callback function when a new frame is ready. This is expected to exist until released or removed.
+//	by default this is called on the device's capture thread, so should be quick. See AsyncCallbacks option
+//	Returns a handle for RemoveOnNewFrameCallback (0 on error). Safe to add/remove whilst streaming, or from inside a callback
+__export int32_t			PopCameraDevice_AddOnNewFrameCallback(int32_t Instance, PopCameraDevice_OnNewFrame* Callback, void* Meta);
+//	once this returns the callback isn't running (unless removed from inside a callback), so Meta can be freed
+__export void				PopCameraDevice_RemoveOnNewFrameCallback(int32_t Instance, int32_t CallbackHandle);
 
 //	returns -1 if no new frame
 //	Fills in meta with JSON about frame
 //	Next frame is not deleted. 
-//	Meta will list other frames buffered up, so to skip to latest frame, Pop without buffers
+//	Meta will list other frames buffered up, use PopLatestFrame to skip to the latest frame
+//	A null MetaJsonBuffer queries the meta's size for PopCameraDevice_GetRequiredBufferSize
 __export int32_t			PopCameraDevice_PeekNextFrame(int32_t Instance,char* MetaJsonBuffer,int32_t MetaJsonBufferSize);
 
 //	returns -1 if no new frame
 //	Deletes frame.
 __export int32_t			PopCameraDevice_PopNextFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size);
 
+//	fills FrameInfo (StructSize must be set) for the next frame without json. Next frame is not deleted.
+//	returns -1 if no new frame
+__export int32_t			PopCameraDevice_PeekNextFrameInfo(int32_t Instance, struct PopCameraDevice_FrameInfo* FrameInfo);
+
+//	PopNextFrame, filling FrameInfo (StructSize must be set) instead of json meta.
+//	MetaJsonBuffer is optional (may be null), the json is only built if it's provided.
+//	returns -1 if no new frame
+__export int32_t			PopCameraDevice_PopNextFrameInfo(int32_t Instance, struct PopCameraDevice_FrameInfo* FrameInfo, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size);
+
+//	PopNextFrameInfo, cropped to this area (in the image's pixels) instead of the Roi option.
+//	RoiWidth or RoiHeight of 0 pops the whole frame. The frame is still popped if the area is outside it, but errors (-2)
+__export int32_t			PopCameraDevice_PopNextFrameRoi(int32_t Instance, int32_t RoiX, int32_t RoiY, int32_t RoiWidth, int32_t RoiHeight, struct PopCameraDevice_FrameInfo* FrameInfo, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size);
+
+//	PopNextFrame, but also writes the frame's 64bit nanosecond timestamps (either pointer may be null).
+//	HostTimeNs is a monotonic (steady_clock) time from when the frame arrived from the device, comparable between devices in this process.
+//	DeviceTimeNs is from the device's own clock (KinectAzure, Freenect), 0 if the backend doesn't have one.
+//	The return value is still the 32bit millisecond frame time (-1 if no new frame)
+__export int32_t			PopCameraDevice_PopNextFrameWithTimestamps(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, uint64_t* HostTimeNs, uint64_t* DeviceTimeNs);
+
+//	pops the newest frame and discards all older ones in one call. Meta includes SkippedFrames (how many were discarded)
+//	returns -1 if no new frame
+__export int32_t			PopCameraDevice_PopLatestFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size);
+
+//	pops up to MaxFrames (oldest first) in one call, for recording every frame.
+//	Pixels of every plane of every frame are packed into Arena, described by Descriptors[0..return).
+//	Frames are sized (after any output conversion) before they're popped, and are only popped whilst they fit in the arena;
+//	if the next frame alone is too big, this errors (-2) and leaves it queued. Pixels are never truncated.
+//	PopCameraDevice_GetRequiredBufferSize then returns the arena size needed to also pop the next frame that didn't fit.
+//	A frame which can't be output (eg. more than PopCameraDevice_MaxPlanes planes) is popped when it's first in the batch, and dropped;
+//	that (or any frame failing to copy) only errors if no other frame in the batch could be returned.
+//	Meta is written as a json array, one object per frame.
+//	returns number of frames output (0 if none)
+__export int32_t			PopCameraDevice_PopFrames(int32_t Instance, int32_t MaxFrames, struct PopCameraDevice_FrameDescriptor* Descriptors, uint8_t* Arena, int32_t ArenaSize, char* MetaJsonBuffer, int32_t MetaJsonBufferSize);
+
+//	blocks until a frame is queued (without popping it), or TimeoutMs passes. Use instead of polling PeekNextFrame
+//	returns next frame's time, -1 on timeout, or if the device was freed whilst waiting
+__export int32_t			PopCameraDevice_WaitForNextFrame(int32_t Instance, int32_t TimeoutMs);
+
+//	PopNextFrame, but waits up to TimeoutMs for a frame to arrive. returns -1 on timeout
+__export int32_t			PopCameraDevice_PopNextFrameWithTimeout(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t* Plane0, int32_t Plane0Size, uint8_t* Plane1, int32_t Plane1Size, uint8_t* Plane2, int32_t Plane2Size, int32_t TimeoutMs);
+
+//	linux only; returns an eventfd (for epoll/poll/select) which becomes readable when a frame is queued, or -1 on error/other platforms.
+//	read() 8 bytes to reset it, then pop until there are no frames left. The fd belongs to the device and is closed by FreeCameraDevice
+__export int32_t			PopCameraDevice_GetFrameEventFd(int32_t Instance);
+
+//	zero-copy alternative to PopNextFrame. Pops the next frame and leaves its pixels locked,
+//	filling the first PlaneCount entries of PlanePixels/PlaneSizes/PlaneStrides (bytes per row) (null/0 for planes that don't exist).
+//	Pointers are valid until PopCameraDevice_UnlockFrame(LeaseId), which must be called for every frame locked.
+//	Locked frames still count towards MaxFrameBytes & the global byte budget until they're unlocked.
+//	If the pixels can't be locked, this errors and the frame stays queued.
+//	Returns frame time like PopNextFrame, -1 if no new frame (LeaseId is 0)
+__export int32_t			PopCameraDevice_LockNextFrame(int32_t Instance, char* MetaJsonBuffer, int32_t MetaJsonBufferSize, uint8_t** PlanePixels, int32_t* PlaneSizes, int32_t* PlaneStrides, int32_t PlaneCount, int32_t* LeaseId);
+__export void				PopCameraDevice_UnlockFrame(int32_t LeaseId);
+
+//	performance counters for the instance as json; input fps per stream, push-to-pop latency & callback duration
+//	percentiles (ms), StageLatency percentiles for each pipeline stage (see StageLatencyMeta), copy throughput,
+//	queued frames/bytes, and dropped frames by reason.
+//	returns the required size (see PopCameraDevice_GetRequiredBufferSize), a null buffer queries it. -2 on error
+__export int32_t			PopCameraDevice_GetStatsJson(int32_t Instance, char* JsonBuffer, int32_t JsonBufferSize);
+
+//	write the recent trace events (capture, queue, callbacks & copies, per thread) to a chrome trace-event json file,
+//	viewable in chrome://tracing or ui.perfetto.dev. Returns number of events written, -2 on error
+//	(0 if the library was built with DISABLE_TRACE)
+__export int32_t			PopCameraDevice_DumpTrace(const char* Filename);
+
 //	returns	version integer as A.BBB.CCCCCC (major, minor, patch. Divide by 10's to split)
 //	deprecated for GetVersionThousand where the version is AA.BBB.CCC (A maxes out at ~15)
 //	A=(X/1000/1000)%1000 b=(X/1000)%1000 c=X%1000
@@ -97,3 +237,7 @@ __export void				PopCameraDevice_UnitTests();
 //	for ARFrameProxy, you can pass in an ARFrame pointer, to read depth images immediately for queuing up
 __export void				PopCameraDevice_ReadNativeHandle(int32_t Instance,void* Handle);
 
+//	limit pixel data queued across all devices. When over budget, each device culls (or drops, depending on QueuePolicy) its own frames as new ones arrive.
+//	0 (default) is unlimited. Per-device limits are set with MaxFrameBytes
+__export void				PopCameraDevice_SetGlobalMaxFrameBytes(uint64_t MaxBytes);
+
@@ -2,6 +2,46 @@
 #include <SoyMedia.h>
 #include <magic_enum/include/magic_enum/magic_enum.hpp>
 #include "PopCameraDevice.h"
+#include "Trace.h"
+#include "PixelConvert.h"
+
+#if defined(TARGET_LINUX)
+#include <sys/eventfd.h>
+#include <string.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+
+#if defined(TARGET_LINUX)
+namespace PopCameraDevice
+{
+	void	SignalEventFd(int EventFd);	//	throws if the write fails
+}
+#endif
+
+namespace PopCameraDevice
+{
+	class TPixelBufferLock;
+}
+
+//	unlocks the pixel buffer however the scope is left
+class PopCameraDevice::TPixelBufferLock
+{
+public:
+	TPixelBufferLock(TPixelBuffer& PixelBuffer,ArrayBridge<SoyPixelsImpl*>&& Textures,float3x3& Transform) :
+		mPixelBuffer	( PixelBuffer )
+	{
+		mPixelBuffer.Lock( std::move(Textures), Transform );
+	}
+	~TPixelBufferLock()
+	{
+		mPixelBuffer.Unlock();
+	}
+
+private:
+	TPixelBuffer&	mPixelBuffer;
+};
 
 
 bool PopCameraDevice::TCaptureParams::Read(json11::Json& Options,const char* Name,size_t& ValueUnsigned)
@@ -9,14 +49,15 @@ bool PopCameraDevice::TCaptureParams::Read(json11::Json& Options,const char* Nam
 	auto& Handle = Options[Name];
 	if ( !Handle.is_number() )
 		return false;
-	auto Value = Handle.int_value();
+	//	number rather than int so byte counts over 2gb survive
+	auto Value = Handle.number_value();
 	if ( Value < 0 )
 	{
 		std::stringstream Error;
 		Error << "Value for " << Name << " is " << Value << ", not expecting negative";
 		throw Soy::AssertException(Error);
 	}
-	ValueUnsigned = Value;
+	ValueUnsigned = static_cast<size_t>(Value);
 	return true;
 }
 
@@ -81,6 +122,28 @@ json11::Json::object PopCameraDevice::TFrame::GetMetaJson()
 	return Object;
 }
 
+std::string PopCameraDevice::TFrame::GetMetaJson(const json11::Json::object& ExtraMeta)
+{
+	auto ExtraJson = json11::Json(ExtraMeta).dump();
+	auto MetaStart = mMeta.find('{');
+	auto MetaEnd = mMeta.rfind('}');
+	if ( MetaStart == std::string::npos || MetaEnd == std::string::npos || MetaEnd < MetaStart )
+		return ExtraJson;
+	if ( ExtraMeta.empty() )
+		return mMeta;
+
+	//	splice the extra object's keys onto the end of ours. If a key appears in both,
+	//	the extra one comes last, which parsers treat the same as it overwriting ours
+	auto MetaHasKeys = mMeta.find_first_not_of(" \t\r\n", MetaStart+1) != MetaEnd;
+	std::string Json;
+	Json.reserve( MetaEnd + ExtraJson.size() + 1 );
+	Json.append( mMeta, 0, MetaEnd );
+	if ( MetaHasKeys )
+		Json += ',';
+	Json.append( ExtraJson, 1, std::string::npos );
+	return Json;
+}
+
 std::string PopCameraDevice::GetFormatString(SoyPixelsMeta Meta, size_t FrameRate)
 {
 	std::stringstream Format;
@@ -143,43 +206,241 @@ PopCameraDevice::TDevice::TDevice(json11::Json& Params)
 {
 	if ( Params[POPCAMERADEVICE_KEY_SPLITPLANES].is_bool() )
 		mSplitPlanes = Params[POPCAMERADEVICE_KEY_SPLITPLANES].bool_value();
+
+	TCaptureParams CaptureParams;
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_STAGELATENCYMETA, mStageLatencyMeta );
+	if ( CaptureParams.Read( Params, POPCAMERADEVICE_KEY_OUTPUTFORMAT, mOutputParams.mFormat ) && !IsConvertOutputFormat(mOutputParams.mFormat) )
+	{
+		std::stringstream Error;
+		Error << POPCAMERADEVICE_KEY_OUTPUTFORMAT << " " << mOutputParams.mFormat << " not supported, expecting RGBA, BGRA, RGB or Greyscale";
+		throw Soy::AssertException(Error);
+	}
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_OUTPUTWIDTH, mOutputParams.mWidth );
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_OUTPUTHEIGHT, mOutputParams.mHeight );
+	std::string FilterName;
+	if ( CaptureParams.Read( Params, POPCAMERADEVICE_KEY_RESIZEFILTER, FilterName ) )
+	{
+		auto Filter = magic_enum::enum_cast<TResizeFilter::Type>(FilterName);
+		if ( !Filter.has_value() )
+		{
+			std::stringstream Error;
+			Error << "Unknown " << POPCAMERADEVICE_KEY_RESIZEFILTER << " " << FilterName << ", expecting Area or Bilinear";
+			throw Soy::AssertException(Error);
+		}
+		mOutputParams.mResizeFilter = *Filter;
+	}
+	//	check the length before reading, a longer array won't fit in Roi
+	auto& RoiJson = Params[POPCAMERADEVICE_KEY_ROI];
+	bool RoiLengthValid = !RoiJson.is_array() || RoiJson.array_items().size() == 4;
+	BufferArray<float,4> Roi;
+	if ( !RoiLengthValid || CaptureParams.Read( Params, POPCAMERADEVICE_KEY_ROI, GetArrayBridge(Roi) ) )
+	{
+		bool Valid = RoiLengthValid && Roi.GetSize() == 4;
+		for ( auto i=0;	i<Roi.GetSize();	i++ )
+			Valid = Valid && Roi[i] >= 0;
+		if ( !Valid )
+		{
+			std::stringstream Error;
+			Error << POPCAMERADEVICE_KEY_ROI << " should be [x,y,width,height] in pixels";
+			throw Soy::AssertException(Error);
+		}
+		mOutputParams.mRoi.mX = static_cast<size_t>(Roi[0]);
+		mOutputParams.mRoi.mY = static_cast<size_t>(Roi[1]);
+		mOutputParams.mRoi.mWidth = static_cast<size_t>(Roi[2]);
+		mOutputParams.mRoi.mHeight = static_cast<size_t>(Roi[3]);
+	}
+	std::string PolicyName;
+	if ( CaptureParams.Read( Params, POPCAMERADEVICE_KEY_QUEUEPOLICY, PolicyName ) )
+	{
+		auto Policy = magic_enum::enum_cast<TQueuePolicy::Type>(PolicyName);
+		if ( !Policy.has_value() )
+		{
+			std::stringstream Error;
+			Error << "Unknown " << POPCAMERADEVICE_KEY_QUEUEPOLICY << " " << PolicyName;
+			throw Soy::AssertException(Error);
+		}
+		mQueueParams.mPolicy = *Policy;
+	}
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_MAXFRAMEBUFFERS, mQueueParams.mMaxFrames );
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_QUEUETIMEOUTMS, mQueueParams.mBlockTimeoutMs );
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_MAXFRAMEBYTES, mQueueParams.mMaxBytes );
+	if ( mQueueParams.mMaxFrames == 0 )
+		throw Soy::AssertException( std::string(POPCAMERADEVICE_KEY_MAXFRAMEBUFFERS) + " must be at least 1");
+
+	mFrames = std::make_shared<TFrameQueue_Mutex>(mQueueParams);
+
+	bool AsyncCallbacks = false;
+	CaptureParams.Read( Params, POPCAMERADEVICE_KEY_ASYNCCALLBACKS, AsyncCallbacks );
+	if ( AsyncCallbacks )
+		mCallbackDispatcher = std::make_shared<TCallbackDispatcher>( [this]()	{	CallOnNewFrameCallbacks();	} );
+}
+
+
+PopCameraDevice::TDevice::~TDevice()
+{
+	//	stop callbacks before the rest of us goes away
+	mCallbackDispatcher.reset();
+
+#if defined(TARGET_LINUX)
+	int FrameEventFd = mFrameEventFd.exchange(-1);
+	if ( FrameEventFd != -1 )
+		close(FrameEventFd);
+#endif
 }
 
 
-void PopCameraDevice::TDevice::PushFrame(std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta)
+void PopCameraDevice::TDevice::EnableLockFreeFrameQueue()
 {
+	mFrames = std::make_shared<TFrameRing>(mQueueParams);
+}
+
+
+size_t PopCameraDevice::TDevice::GetTextureDataSize(const SoyPixelsImpl& Texture)
+{
+	//	sizes come from the layout cache, with the split the pop will use,
+	//	so the layout is only worked out for a new meta and is ready for the pop
+	auto SplitPlanes = mSplitPlanes || !mOutputParams.IsPassthrough();
+	auto TextureDataSize = Texture.GetPixelsArray().GetDataSize();
+	try
+	{
+		TPlaneLayout Layout;
+		mPlaneLayouts.GetLayout( Texture.GetMeta(), TextureDataSize, SplitPlanes, Layout );
+		return Layout.GetDataSize();
+	}
+	catch(std::exception&)
 	{
-		Soy::TScopeTimerPrint Timer("PopCameraDevice::TDevice::PushFrame Lock",5);
-		std::lock_guard<std::mutex> Lock(mFramesLock);
+		//	pixels don't match the meta; that errors when it's popped, here we just count what's held
+		return TextureDataSize;
+	}
+}
+
+
+size_t PopCameraDevice::TDevice::GetPushedDataSize(TFrame& Frame)
+{
+	//	budgets count what's held, the source pixels; output conversion happens at pop (PopFrames sizes that itself).
+	//	Locking a platform buffer (CVPixelBuffer, media foundation...) to size it is too costly for the
+	//	capture thread, so only buffers holding plain pixels are measured here. Others get their stream's
+	//	last size, which the consumer measures when it pops them (see LearnPixelBufferDataSize)
+	auto* DumbPixelBuffer = dynamic_cast<TDumbPixelBuffer*>( Frame.mPixelBuffer.get() );
+	if ( DumbPixelBuffer )
+		return GetTextureDataSize( DumbPixelBuffer->mPixels );
+
+	Frame.mDataSizeEstimated = true;
+	std::lock_guard<std::mutex> Lock(mStreamDataSizesLock);
+	auto StreamDataSize = mStreamDataSizes.find( Frame.mStreamName );
+	return ( StreamDataSize != mStreamDataSizes.end() ) ? StreamDataSize->second : 0;
+}
+
+
+void PopCameraDevice::TDevice::LearnPixelBufferDataSize(const TFrame& Frame)
+{
+	if ( !Frame.mDataSizeEstimated || !Frame.mPixelBuffer )
+		return;
+
+	size_t DataSize = 0;
+	try
+	{
+		BufferArray<SoyPixelsImpl*,10> Textures;
+		float3x3 Transform;
+		TPixelBufferLock PixelsLock( *Frame.mPixelBuffer, GetArrayBridge(Textures), Transform );
+		for ( auto t=0;	t<Textures.GetSize();	t++ )
+		{
+			if ( Textures[t] )
+				DataSize += GetTextureDataSize( *Textures[t] );
+		}
+	}
+	catch(std::exception&)
+	{
+		//	the pop's own lock will report the error
+		return;
+	}
+
+	std::lock_guard<std::mutex> Lock(mStreamDataSizesLock);
+	mStreamDataSizes[Frame.mStreamName] = DataSize;
+}
+
+
+uint64_t PopCameraDevice::GetHostTimeNs()
+{
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now).count();
+}
+
+
+void PopCameraDevice::TDevice::PushFrame(std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta,uint64_t DeviceTimeNs,uint64_t HostTimeNs,uint64_t CallbackTimeNs)
+{
+	//	without a host capture time, the earliest we saw the frame is the best guess
+	auto PushTimeNs = GetHostTimeNs();
+	if ( HostTimeNs == 0 )
+		HostTimeNs = CallbackTimeNs ? CallbackTimeNs : PushTimeNs;
+
+	{
+		TRACE_SCOPE("PopCameraDevice::TDevice::PushFrame Queue");
 
 		std::shared_ptr<TFrame> pNewFrame( new TFrame );
 		auto& NewFrame = *pNewFrame;
 		NewFrame.mPixelBuffer = FramePixelBuffer;
 		NewFrame.mMeta = json11::Json(FrameMeta).dump();
+		NewFrame.mFrameNumber = mFrameCounter++;
+		auto StreamName = FrameMeta.find("StreamName");
+		if ( StreamName != FrameMeta.end() )
+			NewFrame.mStreamName = StreamName->second.string_value();
 		NewFrame.mFrameTime = FrameTime;
-		mFrames.PushBack(pNewFrame);
+		NewFrame.mHostTimeNs = HostTimeNs;
+		NewFrame.mDeviceTimeNs = DeviceTimeNs;
+		NewFrame.mStageTimeNs[TFrameStage::Capture] = HostTimeNs;
+		NewFrame.mStageTimeNs[TFrameStage::BackendCallback] = CallbackTimeNs;
+		NewFrame.mStageTimeNs[TFrameStage::Enqueue] = PushTimeNs;
+		if ( FramePixelBuffer )
+			NewFrame.mDataSize = GetPushedDataSize( NewFrame );
+		mStats.OnFramePushed( NewFrame.mStreamName, NewFrame.mStageTimeNs );
+		auto CullCount = mFrames->Push(pNewFrame);
+		mStats.OnFramesDropped( GetDropReason(mQueueParams.mPolicy), CullCount );
 		
-		if (mFrames.GetSize() > mMaxFrameBuffers)
+		if ( CullCount > 0 )
 		{
-			auto CullCount = mFrames.GetSize() - mMaxFrameBuffers;
 			mCulledFrames += CullCount;
-			mFrames.RemoveBlock(0,CullCount);
-			std::Debug << __PRETTY_FUNCTION__ << "Culling " << CullCount << "/" << mFrames.GetSize() << " frames as over max " << mMaxFrameBuffers << " (total culled=" << mCulledFrames << ")" << std::endl;
+			//	other policies drop frames by design, so only report when we're unexpectedly backing up
+			if ( mQueueParams.mPolicy == TQueuePolicy::DropOldest )
+				std::Debug << __PRETTY_FUNCTION__ << "Culling " << CullCount << " frames as over max " << mQueueParams.mMaxFrames << " frames/" << mQueueParams.mMaxBytes << " bytes (total culled=" << mCulledFrames << ")" << std::endl;
 		}
 	}
 
-	for (auto i = 0; i < mOnNewFrameCallbacks.GetSize(); i++)
+	SignalFrameEventFd();
+
+	//	wake anyone in WaitForNextFrame. Take the lock so we can't notify between their check & wait
+	if ( mFrameWaiters > 0 )
 	{
-		try
 		{
-			Soy::TScopeTimerPrint Timer("PopCameraDevice::TDevice::PushFrame Callbacks",5);
-			auto& Callback = mOnNewFrameCallbacks[i];
-			Callback();
-		}
-		catch (std::exception& e)
-		{
-			std::Debug << "OnNewFrame callback exception; " << e.what() << std::endl;
+			std::lock_guard<std::mutex> Lock(mNewFrameLock);
 		}
+		mNewFrameCondition.notify_all();
+	}
+
+	if ( mCallbackDispatcher )
+		mCallbackDispatcher->Notify();
+	else
+		CallOnNewFrameCallbacks();
+}
+
+void PopCameraDevice::TDevice::CallOnNewFrameCallbacks()
+{
+	TRACE_SCOPE("PopCameraDevice::TDevice::PushFrame Callbacks");
+	auto StartNs = GetHostTimeNs();
+	mOnNewFrameCallbacks.Call();
+	mStats.OnCallbacks( GetHostTimeNs() - StartNs );
+}
+
+//	frames a queue drops are the old ones or the new one, depending on policy
+PopCameraDevice::TDropReason::Type PopCameraDevice::GetDropReason(TQueuePolicy::Type Policy)
+{
+	switch ( Policy )
+	{
+		case TQueuePolicy::DropNewest:		return TDropReason::Rejected;
+		case TQueuePolicy::LatestOnly:		return TDropReason::Replaced;
+		case TQueuePolicy::BlockProducer:	return TDropReason::BlockTimeout;
+		case TQueuePolicy::DropOldest:
+		default:							return TDropReason::Culled;
 	}
 }
 
@@ -188,32 +449,211 @@ void PopCameraDevice::TDevice::GetDeviceMeta(json11::Json::object& Meta)
 {
 	if (mCulledFrames > 0)
 		Meta["CulledFrames"] = static_cast<int>(mCulledFrames);
-	Meta["PendingFrames"] = static_cast<int>(this->mFrames.GetSize());
+	Meta["PendingFrames"] = static_cast<int>(mFrames->GetSize());
+	//	json11 numbers are doubles, so don't truncate to int
+	Meta["PendingBytes"] = static_cast<double>(mFrames->GetQueuedBytes());
+	Meta["GlobalPendingBytes"] = static_cast<double>(GetGlobalQueuedFrameBytes());
+	if ( mCallbackDispatcher )
+		mCallbackDispatcher->GetMeta(Meta);
+}
+
+
+void PopCameraDevice::TDevice::GetStats(json11::Json::object& Stats)
+{
+	mStats.GetJson(Stats);
+	Stats["QueuePolicy"] = std::string( magic_enum::enum_name(mQueueParams.mPolicy) );
+	Stats["QueuedFrames"] = static_cast<double>(mFrames->GetSize());
+	Stats["QueuedBytes"] = static_cast<double>(mFrames->GetQueuedBytes());
+	if ( mCallbackDispatcher )
+		mCallbackDispatcher->GetMeta(Stats);
 }
 
 
+//	explicit member copy, see TFrame
+void CopyFrame(PopCameraDevice::TFrame& Frame,const PopCameraDevice::TFrame& Frame0)
+{
+	Frame.mMeta = Frame0.mMeta;
+	Frame.mStreamName = Frame0.mStreamName;
+	Frame.mFrameNumber = Frame0.mFrameNumber;
+	Frame.mFrameTime = Frame0.mFrameTime;
+	Frame.mHostTimeNs = Frame0.mHostTimeNs;
+	Frame.mDeviceTimeNs = Frame0.mDeviceTimeNs;
+	Frame.mStageTimeNs = Frame0.mStageTimeNs;
+	Frame.mPixelBuffer = Frame0.mPixelBuffer;
+	Frame.mDataSize = Frame0.mDataSize;
+	Frame.mDataSizeEstimated = Frame0.mDataSizeEstimated;
+}
+
 bool PopCameraDevice::TDevice::GetNextFrame(TFrame& Frame,bool DeleteFrame)
 {
-	std::lock_guard<std::mutex> Lock(mFramesLock);
-	if (mFrames.IsEmpty())
+	auto pFrame0 = DeleteFrame ? mFrames->Pop() : mFrames->Peek();
+	if ( !pFrame0 )
 		return false;
 
-	auto pFrame0 = mFrames[0];
-	auto& Frame0 = *pFrame0;
-	auto Meta = Frame0.mMeta;
-	auto FrameTime = Frame0.mFrameTime;
-	auto PixelBuffer = Frame0.mPixelBuffer;
-	Frame.mMeta = Meta;
-	Frame.mFrameTime = FrameTime;
-	Frame.mPixelBuffer = PixelBuffer;
-
-	if (DeleteFrame)
+	LearnPixelBufferDataSize( *pFrame0 );
+	CopyFrame( Frame, *pFrame0 );
+	if ( DeleteFrame )
 	{
-		mFrames.RemoveBlock(0, 1);
+		Frame.mStageTimeNs[TFrameStage::Dequeue] = GetHostTimeNs();
+		mStats.OnFramePopped( Frame.mStageTimeNs );
 	}
 	return true;
 }
 
+bool PopCameraDevice::TDevice::PeekNextFrameTime(SoyTime& FrameTime)
+{
+	auto pFrame = mFrames->Peek();
+	if ( !pFrame )
+		return false;
+	FrameTime = pFrame->mFrameTime;
+	return true;
+}
+
+bool PopCameraDevice::TDevice::GetLatestFrame(TFrame& Frame,size_t& SkippedFrames)
+{
+	auto pFrame0 = mFrames->PopLatest(SkippedFrames);
+	if ( !pFrame0 )
+		return false;
+
+	LearnPixelBufferDataSize( *pFrame0 );
+	CopyFrame( Frame, *pFrame0 );
+	Frame.mStageTimeNs[TFrameStage::Dequeue] = GetHostTimeNs();
+	mStats.OnFramePopped( Frame.mStageTimeNs );
+	mStats.OnFramesDropped( TDropReason::Skipped, SkippedFrames );
+	return true;
+}
+
+void PopCameraDevice::TDevice::PopFrames(ArrayBridge<std::shared_ptr<TFrame>>&& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetFrameBytes)
+{
+	mFrames->PopMany( Frames, MaxFrames, MaxBytes, GetFrameBytes );
+
+	auto PopTimeNs = GetHostTimeNs();
+	for ( auto f=0;	f<Frames.GetSize();	f++ )
+	{
+		auto& Frame = *Frames[f];
+		LearnPixelBufferDataSize( Frame );
+		Frame.mStageTimeNs[TFrameStage::Dequeue] = PopTimeNs;
+		mStats.OnFramePopped( Frame.mStageTimeNs );
+	}
+}
+
+void PopCameraDevice::TDevice::OnFrameCopied(TFrame& Frame,size_t CopiedBytes,uint64_t CopyStartNs)
+{
+	auto CopiedTimeNs = GetHostTimeNs();
+	Frame.mStageTimeNs[TFrameStage::Copied] = CopiedTimeNs;
+	if ( CopiedBytes > 0 )
+		mStats.OnCopy( CopiedBytes, CopiedTimeNs - CopyStartNs );
+	mStats.OnFrameCopied( Frame.mStageTimeNs );
+}
+
+void PopCameraDevice::TDevice::GetFrameStageMeta(const TFrame& Frame,json11::Json::object& Meta)
+{
+	if ( !mStageLatencyMeta )
+		return;
+
+	json11::Json::object StageLatency;
+	for ( size_t s=TFrameStage::Capture+1;	s<TFrameStage::Count;	s++ )
+	{
+		auto Stage = static_cast<TFrameStage::Type>(s);
+		if ( Frame.mStageTimeNs[Stage] == 0 )
+			continue;
+		auto DurationNs = TDeviceStats::GetStageDuration( Frame.mStageTimeNs, Stage );
+		StageLatency[std::string(magic_enum::enum_name(Stage))] = static_cast<double>(DurationNs) / 1000000.0;
+	}
+	Meta["StageLatencyMs"] = StageLatency;
+}
+
+bool PopCameraDevice::TDevice::WaitForNextFrame(size_t TimeoutMs)
+{
+	auto HasFrame = [this]()	{	return mFrames->GetSize() > 0 || mReleasingFrameWaiters;	};
+
+	std::unique_lock<std::mutex> Lock(mNewFrameLock);
+	mFrameWaiters++;
+	mNewFrameCondition.wait_for( Lock, std::chrono::milliseconds(TimeoutMs), HasFrame );
+	mFrameWaiters--;
+	return mFrames->GetSize() > 0;
+}
+
+void PopCameraDevice::TDevice::ReleaseFrameWaiters()
+{
+	{
+		std::lock_guard<std::mutex> Lock(mNewFrameLock);
+		mReleasingFrameWaiters = true;
+	}
+	mNewFrameCondition.notify_all();
+}
+
+int PopCameraDevice::TDevice::GetFrameEventFd()
+{
+#if defined(TARGET_LINUX)
+	std::lock_guard<std::mutex> Lock(mFrameEventFdLock);
+	if ( mFrameEventFd != -1 )
+		return mFrameEventFd;
+
+	auto FrameEventFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+	if ( FrameEventFd == -1 )
+		throw Soy::AssertException( std::string("eventfd() failed; ") + strerror(errno) );
+
+	//	frames may already be waiting, so the caller doesn't miss them
+	if ( mFrames->GetSize() > 0 )
+	{
+		try
+		{
+			SignalEventFd( FrameEventFd );
+		}
+		catch(std::exception&)
+		{
+			close( FrameEventFd );
+			throw;
+		}
+	}
+	mFrameEventFd = FrameEventFd;
+	return FrameEventFd;
+#else
+	throw Soy::AssertException("Frame event fd only supported on linux");
+#endif
+}
+
+void PopCameraDevice::TDevice::SignalFrameEventFd()
+{
+#if defined(TARGET_LINUX)
+	int FrameEventFd = mFrameEventFd;
+	if ( FrameEventFd == -1 )
+		return;
+
+	//	called from the backend's push thread, so don't throw into it
+	try
+	{
+		SignalEventFd( FrameEventFd );
+	}
+	catch(std::exception& e)
+	{
+		std::Debug << __PRETTY_FUNCTION__ << e.what() << std::endl;
+	}
+#endif
+}
+
+#if defined(TARGET_LINUX)
+void PopCameraDevice::SignalEventFd(int EventFd)
+{
+	uint64_t One = 1;
+	while ( true )
+	{
+		auto Written = write( EventFd, &One, sizeof(One) );
+		if ( Written == sizeof(One) )
+			return;
+		if ( Written == -1 && errno == EINTR )
+			continue;
+		//	counter would overflow, so it's already signalled & readable
+		if ( Written == -1 && errno == EAGAIN )
+			return;
+
+		std::string Error = (Written == -1) ? strerror(errno) : "short write";
+		throw Soy::AssertException( std::string("Signalling frame eventfd failed; ") + Error );
+	}
+}
+#endif
+
 void PopCameraDevice::TDevice::ReadNativeHandle(void* Handle)
 {
 	throw Soy::AssertException("This device doesn't support ReadNativeHandle");
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <SoyPixels.h>
 #include "Json11/json11.hpp"
+#include "FrameQueue.h"
+#include "CallbackDispatcher.h"
+#include "DeviceStats.h"
+#include "FramePlanes.h"
 
 class TPixelBuffer;
 
@@ -18,6 +25,8 @@ namespace PopCameraDevice
 	void		DecodeFormatString(std::string FormatString, SoyPixelsMeta& Meta, size_t& FrameRate);
 	void		DecodeFormatString_UnitTests();
 	void		ReadNativeHandle(int32_t Instance,void* Handle);
+	uint64_t	GetHostTimeNs();	//	steady_clock now, the timeline of TFrame::mHostTimeNs
+	TDropReason::Type	GetDropReason(TQueuePolicy::Type Policy);
 
 	//	these features are currently all on/off.
 	//	but some cameras have options like ISO levels, which we should allow specific numbers of
@@ -60,11 +69,20 @@ class PopCameraDevice::TFrame
 {
 public:
 	//	on nvidia/linux, this seems to have some problems (seg fault) being copied
-	std::string						mMeta;
+	std::string						mMeta;			//	serialised once when pushed
+	std::string						mStreamName;	//	copy of meta's StreamName, so it can be read without parsing
+	uint64_t						mFrameNumber = 0;	//	per device, counts every frame pushed (including culled ones)
+
 	SoyTime							mFrameTime;
+	uint64_t						mHostTimeNs = 0;	//	steady_clock, the backend's capture time if it has one, otherwise its callback or push time
+	uint64_t						mDeviceTimeNs = 0;	//	device's own clock, 0 if the backend doesn't provide one
+	TFrameStageTimes				mStageTimeNs = {};	//	steady_clock as the frame passes through the pipeline, for latency stats
 	std::shared_ptr<TPixelBuffer>	mPixelBuffer;
+	size_t							mDataSize = 0;	//	bytes of pixel data held (before any output conversion), for queue memory budgets
+	bool							mDataSizeEstimated = false;	//	mDataSize is the stream's last measured size, the pixels couldn't be sized without locking them
 
 	json11::Json::object			GetMetaJson();
+	std::string						GetMetaJson(const json11::Json::object& ExtraMeta);	//	appends keys without re-parsing mMeta
 };
 
 class PopCameraDevice::TDevice
@@ -72,29 +90,71 @@ class PopCameraDevice::TDevice
 public:
 	TDevice(json11::Json& Params);
 	TDevice()	{};
+	virtual ~TDevice();
 	
 	bool							GetNextFrame(TFrame& Frame,bool DeleteFrame);
+	bool							GetLatestFrame(TFrame& Frame,size_t& SkippedFrames);	//	pops newest, discards the rest
+	void							PopFrames(ArrayBridge<std::shared_ptr<TFrame>>&& Frames,size_t MaxFrames,size_t MaxBytes,const TGetFrameBytes& GetFrameBytes=nullptr);
+	bool							WaitForNextFrame(size_t TimeoutMs);	//	returns false if no frame was queued in time
+	bool							PeekNextFrameTime(SoyTime& FrameTime);	//	time of the next frame without popping it, false if none
+	void							ReleaseFrameWaiters();				//	wake anyone blocked in WaitForNextFrame, before the device is freed
+	int								GetFrameEventFd();					//	linux only; eventfd signalled when a frame is pushed. Created on first call, throws on other platforms
 
 	virtual void					EnableFeature(TFeature::Type Feature,bool Enable)=0;	//	throws if unsupported
 	virtual void					ReadNativeHandle(void* Handle);
 	
 	//	get additional meta for output (debug mostly?)
 	virtual void					GetDeviceMeta(json11::Json::object& Meta);
+	void							GetStats(json11::Json::object& Stats);	//	performance counters, see TDeviceStats
+	void							OnFrameCopied(TFrame& Frame,size_t CopiedBytes,uint64_t CopyStartNs);	//	stamps the Copied stage & records copy stats
+	void							GetFrameStageMeta(const TFrame& Frame,json11::Json::object& Meta);	//	adds per-stage latency if StageLatencyMeta is enabled
 
 protected:
-	virtual void					PushFrame(std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta);
+	//	DeviceTimeNs is the camera's own clock if it has one. HostTimeNs must be on the steady_clock timeline, 0 stamps it now.
+	//	CallbackTimeNs is GetHostTimeNs() when the backend's capture callback was entered, before any processing (0 if unknown)
+	virtual void					PushFrame(std::shared_ptr<TPixelBuffer> FramePixelBuffer,SoyTime FrameTime,json11::Json::object& FrameMeta,uint64_t DeviceTimeNs=0,uint64_t HostTimeNs=0,uint64_t CallbackTimeNs=0);
+
+	//	call this in the constructor (before any frames are pushed) if the backend
+	//	only ever pushes frames from one thread, to use a lock-free queue
+	void							EnableLockFreeFrameQueue();
+
+private:
+	size_t							GetPushedDataSize(TFrame& Frame);				//	capture thread; never locks the pixels
+	void							LearnPixelBufferDataSize(const TFrame& Frame);	//	consumer side; locks the pixels of an estimated frame to measure its stream
+	size_t							GetTextureDataSize(const SoyPixelsImpl& Texture);
+	void							SignalFrameEventFd();
+	void							CallOnNewFrameCallbacks();
 
 public:
-	Array<std::function<void()>>	mOnNewFrameCallbacks;
+	TCallbackRegistry				mOnNewFrameCallbacks;
+	TDeviceStats					mStats;
+	TPlaneLayoutCache				mPlaneLayouts;	//	so popping doesn't split planes from scratch each frame
 
 public:
+	std::shared_ptr<TFrameQueue>	GetFrameQueue()	{	return mFrames;	}
+
 	//	some generic properties from params
 	bool			mSplitPlanes = true;
+	bool			mStageLatencyMeta = false;
+	TOutputParams	mOutputParams;
 
 private:
-	size_t			mCulledFrames = 0;	//	debug - running total of culled frames
-	std::mutex		mFramesLock;
-	Array<std::shared_ptr<TFrame>>	mFrames;		//	might be expensive to copy atm
-	size_t			mMaxFrameBuffers = 13;
+	std::atomic<size_t>				mCulledFrames = 0;	//	debug - running total of culled frames
+	std::atomic<uint64_t>			mFrameCounter = 0;
+	TFrameQueueParams				mQueueParams;
+	std::shared_ptr<TFrameQueue>	mFrames = std::make_shared<TFrameQueue_Mutex>(mQueueParams);
+
+	std::mutex						mNewFrameLock;
+	std::condition_variable			mNewFrameCondition;
+	std::atomic<int>				mFrameWaiters = 0;
+	bool							mReleasingFrameWaiters = false;
+
+	std::mutex						mStreamDataSizesLock;	//	never held while pixels are locked
+	std::map<std::string,size_t>	mStreamDataSizes;		//	last measured size of streams that can only be sized when locked
+
+	std::mutex						mFrameEventFdLock;	//	only guards creation
+	std::atomic<int>				mFrameEventFd = -1;
+
+	std::shared_ptr<TCallbackDispatcher>	mCallbackDispatcher;	//	null unless AsyncCallbacks, otherwise callbacks are called on the capture thread
 };
 
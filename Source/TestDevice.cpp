@@ -2,6 +2,7 @@
 #include "SoyLib/src/SoyMedia.h"
 #include "PopCameraDevice.h"
 #include "JsonFunctions.h"
+#include "Trace.h"
 
 #if defined (TARGET_LINUX)
 #include <math.h>
@@ -41,17 +42,24 @@ void TestDevice::EnumDeviceNames(std::function<void(const std::string&)> Enum)
 }
 
 TestDevice::TestDevice(json11::Json& Options) :
+	TDevice	( Options ),
 	mParams	( Options )
 {
+	//	all frames are generated on our thread (or here, before it starts)
+	EnableLockFreeFrameQueue();
+
 	GenerateFrame();
 
 	auto Iteration = [this]()
 	{
 		this->GenerateFrame();
 		
-		auto Sleepf = 1000.0f / static_cast<float>(this->mParams.mFrameRate);
-		auto Sleepms = static_cast<int>(Sleepf);
-		std::this_thread::sleep_for( std::chrono::milliseconds(Sleepms));
+		//	0 generates frames as fast as possible (for benchmarking)
+		if ( this->mParams.mFrameRate > 0 )
+		{
+			auto Sleepus = 1000000 / this->mParams.mFrameRate;
+			std::this_thread::sleep_for( std::chrono::microseconds(Sleepus) );
+		}
 		
 		return this->mRunning;
 	};
@@ -382,7 +390,7 @@ float4x4 MatrixInverse4x4(float4x4 Matrix)
 
 void TestDevice::GenerateSphereFrame(float x,float y,float z,float Radius)
 {
-	Soy::TScopeTimerPrint Timer(__PRETTY_FUNCTION__,10);
+	TRACE_SCOPE(__PRETTY_FUNCTION__);
 	SoyTime FrameTime = SoyTime::UpTime();
 
 
@@ -10,7 +10,7 @@ public:
 	TTestDeviceParams(json11::Json& Options);
 
 	SoyPixelsFormat::Type	mColourFormat = SoyPixelsFormat::Invalid;
-	size_t					mFrameRate = 30;
+	size_t					mFrameRate = 30;	//	0 = unthrottled
 	size_t					mWidth = 200;
 	size_t					mHeight = 100;
 	
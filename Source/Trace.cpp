@@ -0,0 +1,282 @@
+#include "Trace.h"
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include "Json11/json11.hpp"
+
+
+namespace PopCameraDevice
+{
+	//	same clock as GetHostTimeNs() so trace times line up with frame timestamps
+	uint64_t	GetTraceTimeNs();
+
+	class TThreadTraceEvent : public TTraceEvent
+	{
+	public:
+		uint32_t	mThreadId = 0;
+	};
+
+	//	released when the thread exits, so another thread can reuse the ring
+	class TThreadRingOwner
+	{
+	public:
+		~TThreadRingOwner()
+		{
+			if ( mRing )
+				mRing->Release();
+		}
+
+		std::shared_ptr<TTraceRing>	mRing;
+	};
+
+	//	rings are kept after their thread exits so its events can still be dumped, until another thread reuses it
+	std::mutex									TraceRingsLock;
+	std::vector<std::shared_ptr<TTraceRing>>	TraceRings;
+	uint32_t									TraceThreadCounter = 0;	//	every thread gets a new id, even on a reused ring
+
+	size_t		GetTraceRingCount();
+}
+
+
+uint64_t PopCameraDevice::GetTraceTimeNs()
+{
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now).count();
+}
+
+
+size_t PopCameraDevice::GetTraceRingCount()
+{
+	std::lock_guard<std::mutex> Lock(TraceRingsLock);
+	return TraceRings.size();
+}
+
+
+PopCameraDevice::TTraceRing& PopCameraDevice::TTraceRing::GetThreadRing()
+{
+	thread_local TThreadRingOwner ThreadRing;
+	if ( ThreadRing.mRing )
+		return *ThreadRing.mRing;
+
+	std::lock_guard<std::mutex> Lock(TraceRingsLock);
+	auto ThreadId = ++TraceThreadCounter;
+	for ( auto& Ring : TraceRings )
+	{
+		if ( !Ring->TryClaim(ThreadId) )
+			continue;
+		ThreadRing.mRing = Ring;
+		return *Ring;
+	}
+
+	ThreadRing.mRing = std::make_shared<TTraceRing>(ThreadId);
+	TraceRings.push_back(ThreadRing.mRing);
+	return *ThreadRing.mRing;
+}
+
+void PopCameraDevice::TTraceRing::Release()
+{
+	mInUse.store(false, std::memory_order_release);
+}
+
+bool PopCameraDevice::TTraceRing::TryClaim(uint32_t ThreadId)
+{
+	if ( mInUse.load(std::memory_order_acquire) )
+		return false;
+
+	//	the old thread's events are dropped from now on, rather than shown as the new thread's
+	mFirstEvent.store( mWritten.load(std::memory_order_relaxed), std::memory_order_relaxed );
+	mThreadId.store( ThreadId, std::memory_order_relaxed );
+	mInUse.store(true, std::memory_order_release);
+	return true;
+}
+
+void PopCameraDevice::TTraceRing::Push(const char* Name,uint64_t StartNs,uint64_t EndNs)
+{
+	auto Index = mWritten.load(std::memory_order_relaxed);
+	auto& Slot = mSlots[Index % EventCount];
+
+	//	odd sequence whilst writing
+	auto Sequence = Slot.mSequence.load(std::memory_order_relaxed);
+	Slot.mSequence.store(Sequence+1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	Slot.mName.store(Name, std::memory_order_relaxed);
+	Slot.mStartNs.store(StartNs, std::memory_order_relaxed);
+	Slot.mEndNs.store(EndNs, std::memory_order_relaxed);
+	Slot.mSequence.store(Sequence+2, std::memory_order_release);
+
+	mWritten.store(Index+1, std::memory_order_release);
+}
+
+void PopCameraDevice::TTraceRing::GetEvents(std::vector<TTraceEvent>& Events)
+{
+	uint64_t Written = mWritten.load(std::memory_order_acquire);
+	uint64_t First = (Written > EventCount) ? Written - EventCount : 0;
+	First = std::max<uint64_t>( First, mFirstEvent.load(std::memory_order_relaxed) );
+	for ( auto Index=First;	Index<Written;	Index++ )
+	{
+		auto& Slot = mSlots[Index % EventCount];
+		auto SequenceBefore = Slot.mSequence.load(std::memory_order_acquire);
+		if ( SequenceBefore & 1 )
+			continue;
+
+		TTraceEvent Event;
+		Event.mName = Slot.mName.load(std::memory_order_relaxed);
+		Event.mStartNs = Slot.mStartNs.load(std::memory_order_relaxed);
+		Event.mEndNs = Slot.mEndNs.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		//	overwritten whilst we read it
+		auto SequenceAfter = Slot.mSequence.load(std::memory_order_relaxed);
+		if ( SequenceAfter != SequenceBefore || !Event.mName )
+			continue;
+		Events.push_back(Event);
+	}
+}
+
+
+PopCameraDevice::TTraceScope::TTraceScope(const char* Name) :
+	mName		( Name ),
+	mStartNs	( GetTraceTimeNs() )
+{
+}
+
+PopCameraDevice::TTraceScope::~TTraceScope()
+{
+	auto EndNs = GetTraceTimeNs();
+	TTraceRing::GetThreadRing().Push( mName, mStartNs, EndNs );
+}
+
+
+std::string PopCameraDevice::GetTraceJson(size_t& EventCount)
+{
+	std::vector<std::shared_ptr<TTraceRing>> Rings;
+	{
+		std::lock_guard<std::mutex> Lock(TraceRingsLock);
+		Rings = TraceRings;
+	}
+
+	std::vector<TThreadTraceEvent> Events;
+	std::vector<TTraceEvent> RingEvents;
+	for ( auto& Ring : Rings )
+	{
+		RingEvents.clear();
+		Ring->GetEvents(RingEvents);
+		for ( auto& RingEvent : RingEvents )
+		{
+			TThreadTraceEvent Event;
+			static_cast<TTraceEvent&>(Event) = RingEvent;
+			Event.mThreadId = Ring->GetThreadId();
+			Events.push_back(Event);
+		}
+	}
+	std::sort( Events.begin(), Events.end(), [](const TThreadTraceEvent& a,const TThreadTraceEvent& b)	{	return a.mStartNs < b.mStartNs;	} );
+
+	//	written by hand rather than via json11 objects as a full dump is tens of thousands of events.
+	//	Times are microseconds from the first event, the unit chrome expects
+	uint64_t OriginNs = Events.empty() ? 0 : Events[0].mStartNs;
+	std::stringstream Json;
+	Json << std::fixed << std::setprecision(3);
+	Json << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for ( size_t e=0;	e<Events.size();	e++ )
+	{
+		auto& Event = Events[e];
+		auto DurationNs = (Event.mEndNs > Event.mStartNs) ? Event.mEndNs - Event.mStartNs : 0;
+		if ( e > 0 )
+			Json << ",\n";
+		Json << "{\"name\":" << json11::Json(Event.mName).dump();
+		Json << ",\"ph\":\"X\"";
+		Json << ",\"ts\":" << static_cast<double>(Event.mStartNs - OriginNs) / 1000.0;
+		Json << ",\"dur\":" << static_cast<double>(DurationNs) / 1000.0;
+		Json << ",\"pid\":1,\"tid\":" << Event.mThreadId << "}";
+	}
+	Json << "]}";
+
+	EventCount = Events.size();
+	return Json.str();
+}
+
+size_t PopCameraDevice::DumpTrace(const std::string& Filename)
+{
+	size_t EventCount = 0;
+	auto Json = GetTraceJson(EventCount);
+
+	std::ofstream File( Filename, std::ios::out | std::ios::trunc );
+	if ( !File.is_open() )
+		throw std::runtime_error( std::string("Failed to open trace file ") + Filename );
+	File << Json;
+	File.close();
+	if ( File.fail() )
+		throw std::runtime_error( std::string("Failed to write trace file ") + Filename );
+	return EventCount;
+}
+
+
+void PopCameraDevice::Trace_UnitTests()
+{
+	auto Expect = [](bool Condition,const char* Description)
+	{
+		if ( Condition )
+			return;
+		std::stringstream Error;
+		Error << "Trace test failed: " << Description;
+		throw std::runtime_error(Error.str());
+	};
+
+	//	ring keeps the newest events, oldest first
+	auto Ring = std::make_unique<TTraceRing>(1);
+	std::vector<TTraceEvent> Events;
+	Ring->GetEvents(Events);
+	Expect( Events.empty(), "new ring should be empty" );
+	const auto Overflow = 10;
+	for ( uint64_t i=0;	i<TTraceRing::EventCount+Overflow;	i++ )
+		Ring->Push( "Trace_UnitTests", i, i+1 );
+	Ring->GetEvents(Events);
+	Expect( Events.size() == TTraceRing::EventCount, "ring should hold EventCount events" );
+	Expect( Events.front().mStartNs == Overflow, "oldest events should be overwritten" );
+	Expect( Events.back().mEndNs == TTraceRing::EventCount+Overflow, "newest event missing" );
+
+	//	a ring in use can't be claimed, a released one is reused without its old events
+	Expect( !Ring->TryClaim(2), "ring in use shouldn't be claimable" );
+	Ring->Release();
+	Expect( Ring->TryClaim(2), "released ring should be claimable" );
+	Expect( Ring->GetThreadId() == 2, "claimed ring should take the new thread id" );
+	Events.clear();
+	Ring->GetEvents(Events);
+	Expect( Events.empty(), "claimed ring should drop the previous thread's events" );
+	Ring->Push( "Trace_UnitTests", 1, 2 );
+	Ring->GetEvents(Events);
+	Expect( Events.size() == 1, "claimed ring should keep new events" );
+
+	//	events from other threads get their own ring & thread id
+	static const char* ThreadEventName = "Trace_UnitTests Thread";
+	std::thread Thread( []
+	{
+		TRACE_SCOPE(ThreadEventName);
+	});
+	Thread.join();
+
+	size_t EventCount = 0;
+	auto Json = GetTraceJson(EventCount);
+#if defined(ENABLE_TRACE)
+	Expect( EventCount > 0, "thread's event missing" );
+	Expect( Json.find(ThreadEventName) != std::string::npos, "thread's event missing from json" );
+
+	//	threads which come & go reuse the exited threads' rings
+	auto RingCount = GetTraceRingCount();
+	for ( auto t=0;	t<4;	t++ )
+	{
+		std::thread ShortThread( []
+		{
+			TRACE_SCOPE(ThreadEventName);
+		});
+		ShortThread.join();
+	}
+	Expect( GetTraceRingCount() == RingCount, "exited threads' rings should be reused" );
+#endif
+	Expect( Json.find("\"traceEvents\"") != std::string::npos, "json missing traceEvents" );
+}
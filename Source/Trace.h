@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+//	tracing is compiled in unless DISABLE_TRACE is defined, in which case TRACE_SCOPE compiles to nothing
+#if !defined(DISABLE_TRACE)
+#define ENABLE_TRACE
+#endif
+
+
+namespace PopCameraDevice
+{
+	class TTraceEvent;
+	class TTraceRing;
+	class TTraceScope;
+
+	void		Trace_UnitTests();
+
+	//	write every thread's recent events as chrome trace-event json (load in chrome://tracing or perfetto).
+	//	returns number of events written
+	size_t		DumpTrace(const std::string& Filename);
+	std::string	GetTraceJson(size_t& EventCount);
+}
+
+#if defined(ENABLE_TRACE)
+#define TRACE_CONCAT_INNER(a,b)	a##b
+#define TRACE_CONCAT(a,b)		TRACE_CONCAT_INNER(a,b)
+//	Name must outlive the trace (a literal or __PRETTY_FUNCTION__), only the pointer is stored
+#define TRACE_SCOPE(Name)		PopCameraDevice::TTraceScope TRACE_CONCAT(TraceScope_,__LINE__)(Name)
+#else
+#define TRACE_SCOPE(Name)
+#endif
+
+
+class PopCameraDevice::TTraceEvent
+{
+public:
+	const char*		mName = nullptr;
+	uint64_t		mStartNs = 0;
+	uint64_t		mEndNs = 0;
+};
+
+
+//	fixed size ring of a thread's most recent events. Only the owning thread writes,
+//	readers (DumpTrace) can copy it at any time; each slot has a sequence number
+//	(odd whilst being written) so a reader skips a slot that's overwritten as it reads.
+//	When its thread exits the ring is released, keeping its events until a new thread claims it,
+//	so there are only ever as many rings as threads alive at once
+class PopCameraDevice::TTraceRing
+{
+public:
+	static constexpr size_t	EventCount = 4096;
+
+	TTraceRing(uint32_t ThreadId) :
+		mThreadId	( ThreadId )
+	{
+	}
+
+	void					Push(const char* Name,uint64_t StartNs,uint64_t EndNs);	//	owning thread only
+	void					GetEvents(std::vector<TTraceEvent>& Events);			//	oldest first
+
+	uint32_t				GetThreadId() const	{	return mThreadId;	}
+	static TTraceRing&		GetThreadRing();	//	claimed (or created) on a thread's first event
+	void					Release();			//	owning thread has exited
+	bool					TryClaim(uint32_t ThreadId);	//	false if another thread owns it. Call with the rings lock held
+
+private:
+	class TSlot
+	{
+	public:
+		std::atomic<uint64_t>		mSequence = 0;
+		std::atomic<const char*>	mName = nullptr;
+		std::atomic<uint64_t>		mStartNs = 0;
+		std::atomic<uint64_t>		mEndNs = 0;
+	};
+
+	std::atomic<uint32_t>	mThreadId = 0;
+	std::atomic<bool>		mInUse = true;
+	std::atomic<uint64_t>	mFirstEvent = 0;	//	events before this were the previous owner's
+	std::atomic<uint64_t>	mWritten = 0;	//	total events pushed, next slot is mWritten % EventCount
+	TSlot					mSlots[EventCount];
+};
+
+
+//	records one complete event (begin & duration) when it goes out of scope
+class PopCameraDevice::TTraceScope
+{
+public:
+	TTraceScope(const char* Name);
+	~TTraceScope();
+
+private:
+	const char*		mName = nullptr;
+	uint64_t		mStartNs = 0;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+//	counts every allocation in the process (the library is a shared object, so its allocations come through here too).
+//	Replaces the global operator new, so include this in exactly one file of each executable
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+
+namespace Bench
+{
+	std::atomic<uint64_t>	AllocationCount = 0;
+}
+
+void* operator new(size_t Size)
+{
+	Bench::AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	if ( auto* Pointer = std::malloc(Size ? Size : 1) )
+		return Pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* Pointer) noexcept
+{
+	std::free(Pointer);
+}
+
+void operator delete(void* Pointer,size_t) noexcept
+{
+	std::free(Pointer);
+}
@@ -0,0 +1,306 @@
+//	benchmark of the capture->queue->pop pipeline, driven by the Test device so it runs anywhere (eg. CI) without cameras.
+//	Sweeps resolution, format, queue depth, consumer count & plane splitting and writes results as json.
+//	usage: PopCameraDeviceBench [--quick] [--duration-ms N] [--output Filename]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "../Source/PopCameraDevice.h"
+#include "BenchAllocations.h"
+
+
+namespace Bench
+{
+	class TConfig;
+	class TResult;
+
+	uint64_t	GetTimeNs();
+	double		NanoSecondsToMs(uint64_t Ns)	{	return static_cast<double>(Ns) / 1000000.0;	}
+	TResult		Run(const TConfig& Config,size_t DurationMs);
+}
+
+class Bench::TConfig
+{
+public:
+	size_t		mWidth = 0;
+	size_t		mHeight = 0;
+	std::string	mFormat;
+	size_t		mQueueDepth = 0;
+	size_t		mConsumers = 0;
+	bool		mSplitPlanes = true;
+
+	std::string	GetOptionsJson() const;
+	std::string	GetJson() const;
+};
+
+class Bench::TResult
+{
+public:
+	uint64_t				mFramesPopped = 0;
+	uint64_t				mBytesCopied = 0;
+	uint64_t				mDurationNs = 0;
+	uint64_t				mAllocations = 0;
+	std::vector<uint64_t>	mLatencyNs;			//	capture (host time) to popped & copied, per frame
+	std::string				mDeviceStatsJson;	//	PopCameraDevice_GetStatsJson at the end of the run
+
+	std::string				GetJson();
+};
+
+
+uint64_t Bench::GetTimeNs()
+{
+	//	same clock as the frame's HostTimeNs
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now).count();
+}
+
+std::string Bench::TConfig::GetOptionsJson() const
+{
+	std::stringstream Json;
+	Json << "{";
+	Json << "\"Format\":\"" << mFormat << "\"";
+	Json << ",\"Width\":" << mWidth << ",\"Height\":" << mHeight;
+	Json << ",\"FrameRate\":0";
+	Json << ",\"MaxFrameBuffers\":" << mQueueDepth;
+	Json << ",\"SplitPlanes\":" << (mSplitPlanes ? "true" : "false");
+	Json << "}";
+	return Json.str();
+}
+
+std::string Bench::TConfig::GetJson() const
+{
+	std::stringstream Json;
+	Json << "\"Width\":" << mWidth << ",\"Height\":" << mHeight;
+	Json << ",\"Format\":\"" << mFormat << "\"";
+	Json << ",\"QueueDepth\":" << mQueueDepth;
+	Json << ",\"Consumers\":" << mConsumers;
+	Json << ",\"SplitPlanes\":" << (mSplitPlanes ? "true" : "false");
+	return Json.str();
+}
+
+std::string Bench::TResult::GetJson()
+{
+	std::sort( mLatencyNs.begin(), mLatencyNs.end() );
+	auto GetPercentileMs = [&](double Percentile)
+	{
+		if ( mLatencyNs.empty() )
+			return 0.0;
+		auto Index = static_cast<size_t>( Percentile * static_cast<double>(mLatencyNs.size()-1) );
+		return NanoSecondsToMs( mLatencyNs[Index] );
+	};
+
+	auto Seconds = static_cast<double>(mDurationNs) / 1000000000.0;
+	auto Frames = static_cast<double>(mFramesPopped);
+	std::stringstream Json;
+	Json << "\"FramesPopped\":" << mFramesPopped;
+	Json << ",\"FramesPerSecond\":" << (Seconds > 0 ? Frames / Seconds : 0.0);
+	Json << ",\"MBPerSecond\":" << (Seconds > 0 ? static_cast<double>(mBytesCopied) / (1024.0*1024.0) / Seconds : 0.0);
+	Json << ",\"LatencyMs\":{";
+	Json << "\"P50\":" << GetPercentileMs(0.50);
+	Json << ",\"P90\":" << GetPercentileMs(0.90);
+	Json << ",\"P99\":" << GetPercentileMs(0.99);
+	Json << ",\"Max\":" << GetPercentileMs(1.0);
+	Json << "}";
+	Json << ",\"AllocationsPerFrame\":" << (mFramesPopped ? static_cast<double>(mAllocations) / Frames : 0.0);
+	Json << ",\"DeviceStats\":" << (mDeviceStatsJson.empty() ? "null" : mDeviceStatsJson);
+	return Json.str();
+}
+
+
+Bench::TResult Bench::Run(const TConfig& Config,size_t DurationMs)
+{
+	auto Options = Config.GetOptionsJson();
+	char ErrorBuffer[1024] = {};
+	auto Instance = PopCameraDevice_CreateCameraDevice("Test", Options.c_str(), ErrorBuffer, std::size(ErrorBuffer));
+	if ( Instance <= 0 )
+		throw std::runtime_error( std::string("Failed to create test device ") + Options + "; " + ErrorBuffer );
+
+	//	everything each consumer needs is allocated up front, so allocations during the run are the pipeline's
+	class TConsumer
+	{
+	public:
+		std::vector<uint8_t>	mPlanes[3];
+		std::vector<uint64_t>	mLatencyNs;
+		uint64_t				mFrames = 0;
+		uint64_t				mBytes = 0;
+		uint64_t				mErrors = 0;
+	};
+	std::vector<TConsumer> Consumers(Config.mConsumers);
+	auto MaxPlaneSize = Config.mWidth * Config.mHeight * 4;
+	for ( auto& Consumer : Consumers )
+	{
+		for ( auto& Plane : Consumer.mPlanes )
+			Plane.resize(MaxPlaneSize);
+		Consumer.mLatencyNs.reserve(1<<18);
+	}
+
+	std::atomic<bool> Running = true;
+	auto ConsumerLoop = [&](TConsumer& Consumer)
+	{
+		auto& Planes = Consumer.mPlanes;
+		PopCameraDevice_FrameInfo FrameInfo = {};
+		while ( Running )
+		{
+			if ( PopCameraDevice_WaitForNextFrame(Instance, 100) < 0 )
+				continue;
+
+			//	another consumer may have beaten us to it
+			FrameInfo.StructSize = sizeof(FrameInfo);
+			auto FrameTime = PopCameraDevice_PopNextFrameInfo( Instance, &FrameInfo, nullptr, 0, Planes[0].data(), static_cast<int32_t>(Planes[0].size()), Planes[1].data(), static_cast<int32_t>(Planes[1].size()), Planes[2].data(), static_cast<int32_t>(Planes[2].size()) );
+			if ( FrameTime == -1 )
+				continue;
+			//	any other failure is a broken pipeline, which would otherwise just look like a slow one
+			if ( FrameTime < 0 )
+			{
+				Consumer.mErrors++;
+				continue;
+			}
+
+			auto NowNs = GetTimeNs();
+			Consumer.mFrames++;
+			//	planes are truncated to our buffers, and only the first 3 have one
+			for ( auto p=0;	p<FrameInfo.PlaneCount && p<std::size(Planes);	p++ )
+				Consumer.mBytes += std::min<uint64_t>( FrameInfo.Planes[p].DataSize, Planes[p].size() );
+			if ( NowNs > FrameInfo.HostTimeNs && Consumer.mLatencyNs.size() < Consumer.mLatencyNs.capacity() )
+				Consumer.mLatencyNs.push_back( NowNs - FrameInfo.HostTimeNs );
+		}
+	};
+
+	std::vector<std::thread> Threads;
+	Threads.reserve(Consumers.size());
+	auto StartAllocations = AllocationCount.load();
+	auto StartNs = GetTimeNs();
+	for ( auto& Consumer : Consumers )
+		Threads.emplace_back( ConsumerLoop, std::ref(Consumer) );
+
+	std::this_thread::sleep_for( std::chrono::milliseconds(DurationMs) );
+	Running = false;
+	for ( auto& Thread : Threads )
+		Thread.join();
+
+	TResult Result;
+	uint64_t Errors = 0;
+	Result.mDurationNs = GetTimeNs() - StartNs;
+	Result.mAllocations = AllocationCount.load() - StartAllocations;
+	for ( auto& Consumer : Consumers )
+	{
+		Result.mFramesPopped += Consumer.mFrames;
+		Result.mBytesCopied += Consumer.mBytes;
+		Errors += Consumer.mErrors;
+		Result.mLatencyNs.insert( Result.mLatencyNs.end(), Consumer.mLatencyNs.begin(), Consumer.mLatencyNs.end() );
+	}
+
+	auto StatsSize = PopCameraDevice_GetStatsJson(Instance, nullptr, 0);
+	if ( StatsSize > 0 )
+	{
+		std::vector<char> StatsJson(StatsSize);
+		if ( PopCameraDevice_GetStatsJson(Instance, StatsJson.data(), StatsSize) > 0 )
+			Result.mDeviceStatsJson = StatsJson.data();
+	}
+
+	PopCameraDevice_FreeCameraDevice(Instance);
+	if ( Errors > 0 )
+		throw std::runtime_error( std::to_string(Errors) + " frame pops failed with " + Options );
+	return Result;
+}
+
+
+int main(int argc,const char* argv[])
+{
+	size_t DurationMs = 1000;
+	bool Quick = false;
+	std::string OutputFilename;
+	for ( int a=1;	a<argc;	a++ )
+	{
+		std::string Arg = argv[a];
+		if ( Arg == "--quick" )
+			Quick = true;
+		else if ( Arg == "--duration-ms" && a+1 < argc )
+			DurationMs = std::strtoul( argv[++a], nullptr, 10 );
+		else if ( Arg == "--output" && a+1 < argc )
+			OutputFilename = argv[++a];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--quick] [--duration-ms N] [--output Filename]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<std::pair<size_t,size_t>> Resolutions = { {640,480}, {1280,720}, {1920,1080} };
+	std::vector<std::string> Formats = { "RGBA", "Yuv_8_88", "Greyscale" };
+	std::vector<size_t> QueueDepths = { 1, 4, 13 };
+	std::vector<size_t> ConsumerCounts = { 1, 2, 4 };
+	std::vector<bool> SplitPlanes = { true, false };
+	if ( Quick )
+	{
+		Resolutions = { {1280,720} };
+		Formats = { "RGBA", "Yuv_8_88" };
+		QueueDepths = { 4 };
+		ConsumerCounts = { 1, 2 };
+		SplitPlanes = { true };
+	}
+
+	std::vector<Bench::TConfig> Configs;
+	for ( auto& Resolution : Resolutions )
+		for ( auto& Format : Formats )
+			for ( auto QueueDepth : QueueDepths )
+				for ( auto Consumers : ConsumerCounts )
+					for ( auto Split : SplitPlanes )
+					{
+						Bench::TConfig Config;
+						Config.mWidth = Resolution.first;
+						Config.mHeight = Resolution.second;
+						Config.mFormat = Format;
+						Config.mQueueDepth = QueueDepth;
+						Config.mConsumers = Consumers;
+						Config.mSplitPlanes = Split;
+						Configs.push_back(Config);
+					}
+
+	std::stringstream Json;
+	Json << "{\"Version\":" << PopCameraDevice_GetVersionThousand();
+	Json << ",\"DurationMs\":" << DurationMs;
+	Json << ",\"HardwareThreads\":" << std::thread::hardware_concurrency();
+	Json << ",\"Results\":[";
+	try
+	{
+		for ( size_t c=0;	c<Configs.size();	c++ )
+		{
+			auto& Config = Configs[c];
+			std::cerr << "[" << (c+1) << "/" << Configs.size() << "] " << Config.GetOptionsJson() << " consumers=" << Config.mConsumers << std::endl;
+			auto Result = Bench::Run(Config, DurationMs);
+			if ( c > 0 )
+				Json << ",\n";
+			Json << "{" << Config.GetJson() << "," << Result.GetJson() << "}";
+		}
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	Json << "]}\n";
+
+	if ( OutputFilename.empty() )
+	{
+		std::cout << Json.str();
+		return 0;
+	}
+
+	std::ofstream File( OutputFilename, std::ios::out | std::ios::trunc );
+	File << Json.str();
+	if ( !File )
+	{
+		std::cerr << "Failed to write " << OutputFilename << std::endl;
+		return 1;
+	}
+	std::cerr << "Wrote " << OutputFilename << std::endl;
+	return 0;
+}
@@ -0,0 +1,577 @@
+//	micro benchmarks of the helpers which run per frame (or per call), with fixed inputs so results are comparable between builds.
+//	Calls internal functions directly, so links against the shared library's (default visibility) symbols.
+//	usage: PopCameraDeviceMicroBench [--filter Substring] [--min-ms N] [--output Filename]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <SoyMedia.h>
+#include "../Source/PopCameraDevice.h"
+#include "../Source/TCameraDevice.h"
+#include "../Source/FramePlanes.h"
+#include "../Source/PixelCopy.h"
+#include "../Source/PixelConvert.h"
+#include "../Source/PixelResize.h"
+#include "BenchAllocations.h"
+
+
+namespace Bench
+{
+	class TMicroBench;
+
+	uint64_t	GetTimeNs();
+
+	//	results are accumulated here so the compiler can't discard the work
+	std::atomic<size_t>	Sink = 0;
+
+	std::shared_ptr<TPixelBuffer>	MakePixelBuffer(size_t Width,size_t Height,SoyPixelsFormat::Type Format);
+	json11::Json::object			GetKinectAzureMeta();
+	json11::Json::object			GetFreenectMeta();
+}
+
+
+class Bench::TMicroBench
+{
+public:
+	TMicroBench(const std::string& Filter,size_t MinDurationMs) :
+		mFilter			( Filter ),
+		mMinDurationNs	( MinDurationMs * 1000000 )
+	{
+	}
+
+	template<typename FUNC>
+	void				Run(const std::string& Name,FUNC Function);
+	std::string			GetJson();
+
+private:
+	std::string			mFilter;
+	uint64_t			mMinDurationNs = 0;
+	std::vector<std::string>	mResults;
+};
+
+
+uint64_t Bench::GetTimeNs()
+{
+	auto Now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(Now).count();
+}
+
+template<typename FUNC>
+void Bench::TMicroBench::Run(const std::string& Name,FUNC Function)
+{
+	if ( !mFilter.empty() && Name.find(mFilter) == std::string::npos )
+		return;
+
+	//	warm up caches & any lazy allocations, and estimate how many calls fill a batch
+	const size_t BatchCount = 10;
+	auto WarmupStartNs = GetTimeNs();
+	Function();
+	auto OneCallNs = std::max<uint64_t>( 1, GetTimeNs() - WarmupStartNs );
+	auto BatchIterations = std::max<uint64_t>( 1, (mMinDurationNs / BatchCount) / OneCallNs );
+
+	//	median of batches is robust against the odd preemption
+	std::vector<double> BatchNsPerCall;
+	uint64_t Iterations = 0;
+	uint64_t TotalNs = 0;
+	auto StartAllocations = AllocationCount.load();
+	while ( BatchNsPerCall.size() < BatchCount || TotalNs < mMinDurationNs )
+	{
+		auto StartNs = GetTimeNs();
+		for ( uint64_t i=0;	i<BatchIterations;	i++ )
+			Function();
+		auto BatchNs = GetTimeNs() - StartNs;
+		BatchNsPerCall.push_back( static_cast<double>(BatchNs) / static_cast<double>(BatchIterations) );
+		Iterations += BatchIterations;
+		TotalNs += BatchNs;
+	}
+	//	the results vector itself may have grown, which is at most a handful over the whole run
+	auto Allocations = AllocationCount.load() - StartAllocations;
+
+	std::sort( BatchNsPerCall.begin(), BatchNsPerCall.end() );
+	auto MedianNs = BatchNsPerCall[BatchNsPerCall.size()/2];
+	auto MinNs = BatchNsPerCall.front();
+
+	std::stringstream Json;
+	Json << "{\"Name\":\"" << Name << "\"";
+	Json << ",\"Iterations\":" << Iterations;
+	Json << ",\"NsPerCall\":" << MedianNs;
+	Json << ",\"MinNsPerCall\":" << MinNs;
+	Json << ",\"AllocationsPerCall\":" << static_cast<double>(Allocations) / static_cast<double>(Iterations);
+	Json << "}";
+	mResults.push_back(Json.str());
+	std::cerr << Name << ": " << MedianNs << "ns" << std::endl;
+}
+
+std::string Bench::TMicroBench::GetJson()
+{
+	std::stringstream Json;
+	Json << "{\"Version\":" << PopCameraDevice_GetVersionThousand();
+	Json << ",\"MinDurationMs\":" << (mMinDurationNs / 1000000);
+	Json << ",\"Results\":[";
+	for ( size_t r=0;	r<mResults.size();	r++ )
+	{
+		if ( r > 0 )
+			Json << ",\n";
+		Json << mResults[r];
+	}
+	Json << "]}\n";
+	return Json.str();
+}
+
+
+std::shared_ptr<TPixelBuffer> Bench::MakePixelBuffer(size_t Width,size_t Height,SoyPixelsFormat::Type Format)
+{
+	std::shared_ptr<TPixelBuffer> pPixelBuffer( new TDumbPixelBuffer() );
+	auto& Pixels = dynamic_cast<TDumbPixelBuffer&>(*pPixelBuffer).mPixels;
+	Pixels.mMeta = SoyPixelsMeta( Width, Height, Format );
+	Pixels.mArray.SetSize( Pixels.mMeta.GetDataSize() );
+	for ( auto i=0;	i<Pixels.mArray.GetSize();	i++ )
+		Pixels.mArray[i] = static_cast<uint8_t>(i);
+	return pPixelBuffer;
+}
+
+//	same shape as KinectAzure::TPixelReader::OnFrame's meta with brown-conrady calibration
+json11::Json::object Bench::GetKinectAzureMeta()
+{
+	json11::Json::object Meta;
+	Meta["Temperature"] = 31.25;
+	Meta["Accelerometer"] = json11::Json::array{ -0.123, -9.801, 0.456 };
+	Meta["Gyro"] = json11::Json::array{ 0.001, -0.002, 0.003 };
+	Meta["SyncInCable"] = false;
+	Meta["SyncOutCable"] = true;
+	Meta["MaxFov"] = 1.7;
+	Meta["LocalToLensTransform"] = json11::Json::array{};
+	const char* Params[] = { "cx","cy","fx","fy","k1","k2","k3","k4","k5","k6","codx","cody","p1","p2","metric_radius" };
+	for ( size_t p=0;	p<std::size(Params);	p++ )
+		Meta[Params[p]] = 100.0 + static_cast<double>(p) * 1.125;
+	Meta["StreamName"] = "Colour";
+	return Meta;
+}
+
+//	same shape as Freenect::TSource::OnFrame's depth meta
+json11::Json::object Bench::GetFreenectMeta()
+{
+	json11::Json::object Camera;
+	Camera["HorizontalFov"] = 58.5;
+	Camera["VerticalFov"] = 46.6;
+	Camera["Intrinsics"] = json11::Json::array{ 368.096588, 0, 261.696594, 0, 368.096588, 202.522202, 0, 0, 0 };
+
+	json11::Json::object Meta;
+	Meta["StreamName"] = "Depth";
+	Meta["DepthMax"] = 10000;
+	Meta["DepthInvalid"] = 0;
+	Meta["Camera"] = Camera;
+	return Meta;
+}
+
+
+int main(int argc,const char* argv[])
+{
+	std::string Filter;
+	size_t MinDurationMs = 200;
+	std::string OutputFilename;
+	for ( int a=1;	a<argc;	a++ )
+	{
+		std::string Arg = argv[a];
+		if ( Arg == "--filter" && a+1 < argc )
+			Filter = argv[++a];
+		else if ( Arg == "--min-ms" && a+1 < argc )
+			MinDurationMs = std::strtoul( argv[++a], nullptr, 10 );
+		else if ( Arg == "--output" && a+1 < argc )
+			OutputFilename = argv[++a];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--filter Substring] [--min-ms N] [--output Filename]" << std::endl;
+			return 1;
+		}
+	}
+
+	using namespace PopCameraDevice;
+	Bench::TMicroBench MicroBench( Filter, MinDurationMs );
+	auto& Sink = Bench::Sink;
+
+	try
+	{
+		//	CopyPlanes, both overloads, for typical colour & depth formats.
+		//	Destination buffers are allocated once, like a caller reusing its buffers every frame
+		class TImage
+		{
+		public:
+			const char*				mName;
+			size_t					mWidth;
+			size_t					mHeight;
+			SoyPixelsFormat::Type	mFormat;
+		};
+		TImage Images[] =
+		{
+			{ "Rgba1920x1080", 1920, 1080, SoyPixelsFormat::RGBA },
+			{ "Nv12_1280x720", 1280, 720, SoyPixelsFormat::Yuv_8_88 },
+			{ "Depth16_640x576", 640, 576, SoyPixelsFormat::Depth16mm },
+			{ "Bgra3840x2160", 3840, 2160, SoyPixelsFormat::BGRA },
+		};
+		for ( auto& Image : Images )
+		{
+			auto pPixelBuffer = Bench::MakePixelBuffer( Image.mWidth, Image.mHeight, Image.mFormat );
+			auto& PixelBuffer = *pPixelBuffer;
+			Array<uint8_t> Dst0, Dst1, Dst2;
+			auto DataSize = SoyPixelsMeta( Image.mWidth, Image.mHeight, Image.mFormat ).GetDataSize();
+			Dst0.SetSize(DataSize);
+			Dst1.SetSize(DataSize);
+			Dst2.SetSize(DataSize);
+
+			TPlaneLayoutCache LayoutCache;
+			for ( auto SplitPlanes : { true, false } )
+			{
+				for ( auto WithMeta : { true, false } )
+				{
+					std::string Name = std::string("CopyPlanes(PixelBuffer) ") + Image.mName + (SplitPlanes ? " Split" : " NoSplit") + (WithMeta ? " Meta" : "");
+					MicroBench.Run( Name, [&]()
+					{
+						auto Remote0 = GetRemoteArray( Dst0.GetArray(), Dst0.GetDataSize() );
+						auto Remote1 = GetRemoteArray( Dst1.GetArray(), Dst1.GetDataSize() );
+						auto Remote2 = GetRemoteArray( Dst2.GetArray(), Dst2.GetDataSize() );
+						auto Bridge0 = GetArrayBridge(Remote0);
+						auto Bridge1 = GetArrayBridge(Remote1);
+						auto Bridge2 = GetArrayBridge(Remote2);
+						BufferArray<ArrayBridge<uint8_t>*,3> Dsts;
+						Dsts.PushBack(&Bridge0);
+						Dsts.PushBack(&Bridge1);
+						Dsts.PushBack(&Bridge2);
+						auto DstsBridge = GetArrayBridge(Dsts);
+						json11::Json::object Meta;
+						PopCameraDevice_FrameInfo FrameInfo = {};
+						Sink += CopyPlanes( PixelBuffer, DstsBridge, WithMeta ? &Meta : nullptr, WithMeta ? &FrameInfo : nullptr, SplitPlanes, &LayoutCache );
+					});
+				}
+			}
+
+			//	splitting planes; the old heap allocating split against views, with & without the layout cache
+			auto& Pixels = dynamic_cast<TDumbPixelBuffer&>(PixelBuffer).mPixels;
+			SoyPixelsImpl* Texture = &Pixels;
+			auto Textures = GetRemoteArray( &Texture, 1 );
+			auto TexturesBridge = GetArrayBridge(Textures);
+			MicroBench.Run( std::string("SoyPixelsImpl::SplitPlanes ") + Image.mName, [&]()
+			{
+				BufferArray<std::shared_ptr<SoyPixelsImpl>,10> SplitPlanes;
+				Pixels.SplitPlanes( GetArrayBridge(SplitPlanes) );
+				Sink += SplitPlanes.GetSize();
+			});
+			for ( auto* Cache : { static_cast<TPlaneLayoutCache*>(nullptr), &LayoutCache } )
+			{
+				MicroBench.Run( std::string("GetPlaneViews ") + Image.mName + (Cache ? " Cached" : ""), [&]()
+				{
+					BufferArray<TPlaneView,10> Planes;
+					GetPlaneViews( TexturesBridge, true, Cache, GetArrayBridge(Planes) );
+					Sink += Planes.GetSize();
+				});
+			}
+
+			//	planes already locked & split, so this is just the copy (+meta)
+			BufferArray<TPlaneView,10> PlaneViews;
+			GetPlaneViews( TexturesBridge, true, &LayoutCache, GetArrayBridge(PlaneViews) );
+			for ( auto WithMeta : { true, false } )
+			{
+				std::string Name = std::string("CopyPlanes(Planes) ") + Image.mName + (WithMeta ? " Meta" : "");
+				MicroBench.Run( Name, [&]()
+				{
+					auto Remote0 = GetRemoteArray( Dst0.GetArray(), Dst0.GetDataSize() );
+					auto Remote1 = GetRemoteArray( Dst1.GetArray(), Dst1.GetDataSize() );
+					auto Bridge0 = GetArrayBridge(Remote0);
+					auto Bridge1 = GetArrayBridge(Remote1);
+					BufferArray<ArrayBridge<uint8_t>*,2> Dsts;
+					Dsts.PushBack(&Bridge0);
+					Dsts.PushBack(&Bridge1);
+					auto DstsBridge = GetArrayBridge(Dsts);
+					json11::Json::object Meta;
+					Sink += CopyPlanes( GetArrayBridge(PlaneViews), DstsBridge, WithMeta ? &Meta : nullptr, nullptr );
+				});
+			}
+
+			//	plane meta
+			MicroBench.Run( std::string("GetObjectJson(Plane) ") + Image.mName, [&]()
+			{
+				json11::Json::object Json;
+				GetObjectJson( Json, Pixels.GetMeta() );
+				Sink += Json.size();
+			});
+			MicroBench.Run( std::string("GetJson(Planes) ") + Image.mName, [&]()
+			{
+				json11::Json::object Json;
+				GetJson( Json, Pixels.GetMeta() );
+				Sink += Json.size();
+			});
+		}
+
+		//	plane copy kernels against the ArrayBridge::Copy that CopyPlanes used before,
+		//	packed (as SoyPixels planes are) and with padded rows (eg. a sub-rectangle of a bigger image)
+		TImage CopyImages[] =
+		{
+			{ "Depth16_640x576", 640, 576, SoyPixelsFormat::Depth16mm },
+			{ "Bgra3840x2160", 3840, 2160, SoyPixelsFormat::BGRA },
+		};
+		TPixelCopyKernel::Type Kernels[] = { TPixelCopyKernel::Scalar, TPixelCopyKernel::Sse2, TPixelCopyKernel::Avx2, TPixelCopyKernel::Neon };
+		for ( auto& Image : CopyImages )
+		{
+			SoyPixelsMeta Meta( Image.mWidth, Image.mHeight, Image.mFormat );
+			auto RowBytes = Meta.GetRowDataSize();
+			auto PaddedStride = RowBytes + 64;
+			std::vector<uint8_t> Src( PaddedStride * Image.mHeight, 0x12 );
+			std::vector<uint8_t> Dst( PaddedStride * Image.mHeight );
+
+			MicroBench.Run( std::string("PlaneCopy ArrayBridge::Copy ") + Image.mName, [&]()
+			{
+				auto DstArray = GetRemoteArray( Dst.data(), Meta.GetDataSize() );
+				auto SrcArray = GetRemoteArray( Src.data(), Meta.GetDataSize() );
+				GetArrayBridge(DstArray).Copy(SrcArray);
+				Sink += Dst[0];
+			});
+			for ( auto Kernel : Kernels )
+			{
+				if ( !IsPixelCopyKernelSupported(Kernel) )
+					continue;
+				SetPixelCopyKernel(Kernel);
+				MicroBench.Run( std::string("PlaneCopy ") + GetPixelCopyKernelName(Kernel) + " " + Image.mName, [&]()
+				{
+					CopyPixels( Dst.data(), Src.data(), Meta.GetDataSize() );
+					Sink += Dst[0];
+				});
+				MicroBench.Run( std::string("PlaneCopy ") + GetPixelCopyKernelName(Kernel) + " " + Image.mName + " Strided", [&]()
+				{
+					CopyPixelRows( Dst.data(), PaddedStride, Src.data(), PaddedStride, RowBytes, Image.mHeight );
+					Sink += Dst[0];
+				});
+			}
+			SetPixelCopyKernel(TPixelCopyKernel::Auto);
+		}
+
+		//	OutputFormat conversion straight into the caller's buffer, per simd kernel
+		class TConvert
+		{
+		public:
+			const char*				mName;
+			TImage					mImage;
+			SoyPixelsFormat::Type	mOutputFormat;
+		};
+		TConvert Converts[] =
+		{
+			{ "Nv12_1280x720 to RGBA", { "", 1280, 720, SoyPixelsFormat::Yuv_8_88 }, SoyPixelsFormat::RGBA },
+			{ "Nv12_1920x1080 to BGRA", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, SoyPixelsFormat::BGRA },
+			{ "Yuv_8_8_8_1920x1080 to RGBA", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_8_8 }, SoyPixelsFormat::RGBA },
+			{ "Nv12_1920x1080 to Greyscale", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, SoyPixelsFormat::Greyscale },
+			{ "Bgra1920x1080 to RGBA", { "", 1920, 1080, SoyPixelsFormat::BGRA }, SoyPixelsFormat::RGBA },
+		};
+		for ( auto& Convert : Converts )
+		{
+			auto& Image = Convert.mImage;
+			auto pPixelBuffer = Bench::MakePixelBuffer( Image.mWidth, Image.mHeight, Image.mFormat );
+			SoyPixelsImpl* Texture = &dynamic_cast<TDumbPixelBuffer&>(*pPixelBuffer).mPixels;
+			auto Textures = GetRemoteArray( &Texture, 1 );
+			auto TexturesBridge = GetArrayBridge(Textures);
+			BufferArray<TPlaneView,10> Planes;
+			GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(Planes) );
+			auto PlanesBridge = GetArrayBridge(Planes);
+
+			auto OutputMeta = GetConvertedMeta( PlanesBridge, Convert.mOutputFormat );
+			std::vector<uint8_t> Dst( OutputMeta.GetDataSize() );
+			for ( auto Kernel : Kernels )
+			{
+				if ( !IsPixelCopyKernelSupported(Kernel) )
+					continue;
+				SetPixelCopyKernel(Kernel);
+				MicroBench.Run( std::string("ConvertPixels ") + GetPixelCopyKernelName(Kernel) + " " + Convert.mName, [&]()
+				{
+					ConvertPixels( PlanesBridge, Convert.mOutputFormat, Dst.data(), OutputMeta.GetRowDataSize(), OutputMeta.GetHeight() );
+					Sink += Dst[0];
+				});
+			}
+			SetPixelCopyKernel(TPixelCopyKernel::Auto);
+		}
+
+		//	OutputWidth/OutputHeight; every plane resized, per simd kernel & with/without the worker threads
+		class TResize
+		{
+		public:
+			const char*				mName;
+			TImage					mImage;
+			size_t					mWidth;
+			size_t					mHeight;
+			TResizeFilter::Type		mFilter;
+		};
+		TResize Resizes[] =
+		{
+			{ "Nv12_1920x1080 to 960x540 Area", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, 960, 540, TResizeFilter::Area },
+			{ "Nv12_1920x1080 to 480x270 Area", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, 480, 270, TResizeFilter::Area },
+			{ "Nv12_1920x1080 to 1280x720 Area", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, 1280, 720, TResizeFilter::Area },
+			{ "Nv12_1920x1080 to 1280x720 Bilinear", { "", 1920, 1080, SoyPixelsFormat::Yuv_8_88 }, 1280, 720, TResizeFilter::Bilinear },
+			{ "Bgra3840x2160 to 960x540 Area", { "", 3840, 2160, SoyPixelsFormat::BGRA }, 960, 540, TResizeFilter::Area },
+			{ "Bgra3840x2160 to 1920x1080 Bilinear", { "", 3840, 2160, SoyPixelsFormat::BGRA }, 1920, 1080, TResizeFilter::Bilinear },
+		};
+		for ( auto& Resize : Resizes )
+		{
+			auto& Image = Resize.mImage;
+			auto pPixelBuffer = Bench::MakePixelBuffer( Image.mWidth, Image.mHeight, Image.mFormat );
+			SoyPixelsImpl* Texture = &dynamic_cast<TDumbPixelBuffer&>(*pPixelBuffer).mPixels;
+			auto Textures = GetRemoteArray( &Texture, 1 );
+			auto TexturesBridge = GetArrayBridge(Textures);
+			BufferArray<TPlaneView,10> Planes;
+			GetPlaneViews( TexturesBridge, true, nullptr, GetArrayBridge(Planes) );
+
+			auto ResizedImageMeta = GetResizedMeta( Planes[0].mMeta, Resize.mWidth, Resize.mHeight );
+			BufferArray<SoyPixelsMeta,10> ResizedMetas;
+			std::vector<std::vector<uint8_t>> Dsts;
+			for ( auto p=0;	p<Planes.GetSize();	p++ )
+			{
+				ResizedMetas.PushBack( GetResizedPlaneMeta( Planes[0].mMeta, ResizedImageMeta, Planes[p].mMeta ) );
+				Dsts.emplace_back( ResizedMetas[p].GetDataSize() );
+			}
+
+			auto ResizeAllPlanes = [&](bool AllowThreads)
+			{
+				for ( auto p=0;	p<Planes.GetSize();	p++ )
+				{
+					auto& Meta = ResizedMetas[p];
+					ResizePlane( Planes[p], Meta, Dsts[p].data(), Meta.GetRowDataSize(), Meta.GetHeight(), Resize.mFilter, AllowThreads );
+					Sink += Dsts[p][0];
+				}
+			};
+			for ( auto Kernel : Kernels )
+			{
+				if ( !IsPixelCopyKernelSupported(Kernel) )
+					continue;
+				SetPixelCopyKernel(Kernel);
+				MicroBench.Run( std::string("ResizePlane ") + GetPixelCopyKernelName(Kernel) + " " + Resize.mName, [&]()
+				{
+					ResizeAllPlanes(false);
+				});
+			}
+			SetPixelCopyKernel(TPixelCopyKernel::Auto);
+			MicroBench.Run( std::string("ResizePlane Threaded ") + Resize.mName, [&]()
+			{
+				ResizeAllPlanes(true);
+			});
+		}
+
+		//	the whole pop path for a typical ML input; resized & converted straight into the caller's buffer
+		{
+			auto pPixelBuffer = Bench::MakePixelBuffer( 1920, 1080, SoyPixelsFormat::Yuv_8_88 );
+			TPlaneLayoutCache LayoutCache;
+			TOutputParams Output;
+			Output.mFormat = SoyPixelsFormat::RGBA;
+			Output.mWidth = 960;
+			std::vector<uint8_t> Dst( SoyPixelsMeta( 960, 540, SoyPixelsFormat::RGBA ).GetDataSize() );
+			MicroBench.Run( "CopyPlanes(PixelBuffer) Nv12_1920x1080 to RGBA 960x540", [&]()
+			{
+				auto Remote = GetRemoteArray( Dst.data(), Dst.size() );
+				auto Bridge = GetArrayBridge(Remote);
+				BufferArray<ArrayBridge<uint8_t>*,1> Dsts;
+				Dsts.PushBack(&Bridge);
+				auto DstsBridge = GetArrayBridge(Dsts);
+				Sink += CopyPlanes( *pPixelBuffer, DstsBridge, nullptr, nullptr, true, &LayoutCache, &Output );
+			});
+		}
+
+		//	Roi readout; a fifth of the frame copied against the whole frame
+		{
+			auto pPixelBuffer = Bench::MakePixelBuffer( 1920, 1080, SoyPixelsFormat::Yuv_8_88 );
+			TPlaneLayoutCache LayoutCache;
+			std::vector<uint8_t> Dst0( 1920*1080 );
+			std::vector<uint8_t> Dst1( 1920*1080/2 );
+			TOutputParams Whole;
+			TOutputParams Crop;
+			Crop.mRoi.mX = 760;
+			Crop.mRoi.mY = 300;
+			Crop.mRoi.mWidth = 400;
+			Crop.mRoi.mHeight = 540;
+			for ( auto* Output : { &Whole, &Crop } )
+			{
+				std::string Name = std::string("CopyPlanes(PixelBuffer) Roi ") + (Output == &Crop ? "400x540" : "Whole") + " Nv12_1920x1080";
+				MicroBench.Run( Name, [&]()
+				{
+					auto Remote0 = GetRemoteArray( Dst0.data(), Dst0.size() );
+					auto Remote1 = GetRemoteArray( Dst1.data(), Dst1.size() );
+					auto Bridge0 = GetArrayBridge(Remote0);
+					auto Bridge1 = GetArrayBridge(Remote1);
+					BufferArray<ArrayBridge<uint8_t>*,2> Dsts;
+					Dsts.PushBack(&Bridge0);
+					Dsts.PushBack(&Bridge1);
+					auto DstsBridge = GetArrayBridge(Dsts);
+					Sink += CopyPlanes( *pPixelBuffer, DstsBridge, nullptr, nullptr, true, &LayoutCache, Output );
+				});
+			}
+		}
+
+		//	frame meta is serialised once on push, then extended with device/plane meta on every pop
+		auto KinectMeta = Bench::GetKinectAzureMeta();
+		auto FreenectMeta = Bench::GetFreenectMeta();
+		MicroBench.Run( "json11 dump KinectAzure meta", [&]()
+		{
+			Sink += json11::Json(KinectMeta).dump().size();
+		});
+		MicroBench.Run( "json11 dump Freenect meta", [&]()
+		{
+			Sink += json11::Json(FreenectMeta).dump().size();
+		});
+
+		TFrame Frame;
+		Frame.mMeta = json11::Json(KinectMeta).dump();
+		json11::Json::object ExtraMeta;
+		ExtraMeta["HostTimeNs"] = 123456789012.0;
+		ExtraMeta["DeviceTimeNs"] = 98765432.0;
+		GetJson( ExtraMeta, SoyPixelsMeta( 1280, 720, SoyPixelsFormat::Yuv_8_88 ) );
+		MicroBench.Run( "TFrame::GetMetaJson(ExtraMeta)", [&]()
+		{
+			Sink += Frame.GetMetaJson(ExtraMeta).size();
+		});
+		MicroBench.Run( "TFrame::GetMetaJson()", [&]()
+		{
+			Sink += Frame.GetMetaJson().size();
+		});
+
+		//	format strings
+		MicroBench.Run( "DecodeFormatString", [&]()
+		{
+			SoyPixelsMeta Meta;
+			size_t FrameRate = 0;
+			DecodeFormatString( "Yuv_8_88^1280x720@30", Meta, FrameRate );
+			Sink += FrameRate;
+		});
+		MicroBench.Run( "GetFormatString", [&]()
+		{
+			Sink += GetFormatString( SoyPixelsMeta( 1280, 720, SoyPixelsFormat::Yuv_8_88 ), 30 ).size();
+		});
+
+		//	size query then fill, as callers do
+		std::vector<char> EnumBuffer(64*1024);
+		MicroBench.Run( "EnumCameraDevicesJson", [&]()
+		{
+			auto Size = PopCameraDevice_EnumCameraDevicesJson( nullptr, 0 );
+			Sink += PopCameraDevice_EnumCameraDevicesJson( EnumBuffer.data(), std::min<int32_t>( Size, static_cast<int32_t>(EnumBuffer.size()) ) );
+		});
+	}
+	catch(std::exception& e)
+	{
+		std::cerr << "Micro benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+
+	auto Json = MicroBench.GetJson();
+	if ( OutputFilename.empty() )
+	{
+		std::cout << Json;
+		return 0;
+	}
+
+	std::ofstream File( OutputFilename, std::ios::out | std::ios::trunc );
+	File << Json;
+	if ( !File )
+	{
+		std::cerr << "Failed to write " << OutputFilename << std::endl;
+		return 1;
+	}
+	std::cerr << "Wrote " << OutputFilename << std::endl;
+	return 0;
+}
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <thread>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 #include "../Source/PopCameraDevice.h"
 #pragma comment(lib, "PopCameraDevice.lib")
 
@@ -70,11 +72,11 @@ void TestDeviceInstance(const std::string& Name,const std::string& OptionsJson,s
 		//DebugPrint("Pop Frame:");
 		uint8_t Plane0[100 * 100 * 4];
 		char MetaJson[1024*10] = {0};
-		auto FrameTime = PopCameraDevice_PopNextFrame(Instance, MetaJson, std::size(MetaJson), Plane0, std::size(Plane0), nullptr, 0, nullptr, 0);
+		auto TimeoutMs = 100;
+		auto FrameTime = PopCameraDevice_PopNextFrameWithTimeout(Instance, MetaJson, std::size(MetaJson), Plane0, std::size(Plane0), nullptr, 0, nullptr, 0, TimeoutMs);
 		if (FrameTime == -1)
 		{
-			//DebugPrint("No frame, waiting...");
-			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			//DebugPrint("No frame after timeout");
 			//i--;
 			continue;
 		}
@@ -118,12 +120,14 @@ int main()
 	PopCameraDevice_UnitTests();
 
 	DebugPrint("PopCameraDevice_EnumCameraDevicesJson");	
-	char EnumJson[1024*10];
-	PopCameraDevice_EnumCameraDevicesJson(EnumJson, std::size(EnumJson));
+	//	query the size, then fetch
+	auto EnumJsonSize = PopCameraDevice_EnumCameraDevicesJson(nullptr, 0);
+	std::vector<char> EnumJson( std::max(EnumJsonSize,1) );
+	PopCameraDevice_EnumCameraDevicesJson(EnumJson.data(), static_cast<int32_t>(EnumJson.size()));
 	
 	//	at least one of these should be the test device
 	DebugPrint("Devices and formats:");
-	DebugPrint(EnumJson);
+	DebugPrint(EnumJson.data());
 
 	TestDeviceInstance("Freenect:A00364A03915112A", "{\"Format\":\"Yuv_8_88\",\"DepthFormat\":\"Depth16mm\"}", 100);
 	
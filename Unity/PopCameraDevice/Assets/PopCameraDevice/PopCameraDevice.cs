@@ -23,8 +23,9 @@ public static class PopCameraDevice
 #endif
 	
 	//	use byte as System.Char is a unicode char (2 bytes), then convert to Unicode Char
+	//	returns size required, pass null to query
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
-	private static extern void PopCameraDevice_EnumCameraDevicesJson([In, Out] byte[] StringBuffer,int StringBufferLength);
+	private static extern Int32 PopCameraDevice_EnumCameraDevicesJson([In, Out] byte[] StringBuffer,int StringBufferLength);
 	
 	//	returns instance id
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
@@ -45,7 +46,16 @@ public static class PopCameraDevice
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern Int32 PopCameraDevice_PopNextFrame(Int32 Instance, [In, Out] byte[] JsonBuffer, int JsonBufferLength, byte[] Plane0, Int32 Plane0Size, byte[] Plane1, Int32 Plane1Size, byte[] Plane2, Int32 Plane2Size);
 
+	//	returns -1 if no new frame
+	//	Fills in Info (StructSize must be set) without any json. Next frame is not deleted.
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern Int32 PopCameraDevice_PeekNextFrameInfo(Int32 Instance, ref FrameInfo Info);
+
 	//	returns	version integer as A.BBB.CCCCCC
+	//	returns required size, pass null to query
+	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
+	private static extern Int32 PopCameraDevice_GetStatsJson(Int32 Instance, [In, Out] byte[] JsonBuffer, Int32 JsonBufferLength);
+
 	[DllImport(PluginName, CallingConvention = CallingConvention.Cdecl)]
 	private static extern Int32 PopCameraDevice_GetVersion();
 	
@@ -87,6 +97,7 @@ public static class PopCameraDevice
 		public int			Height;
 		public int			DataSize;
 		public int			Channels;
+		public int[]		Roi;		//	x,y,width,height of the plane this was cropped to (Roi option), empty if not cropped
 	};
 
 	[System.Serializable]
@@ -96,6 +107,44 @@ public static class PopCameraDevice
 		public List<PlaneMeta>	Planes;
 	};
 
+	//	matches PopCameraDevice_PlaneInfo
+	[StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+	public struct PlaneInfo
+	{
+		public PixelFormat	PixelFormat { get { return (PixelFormat)Enum.Parse(typeof(PixelFormat), FormatName); } }
+		public Int32		Width;
+		public Int32		Height;
+		public Int32		Channels;
+		public Int32		DataSize;
+		public Int32		RowStride;
+		public Int32		Format;		//	c++ SoyPixelsFormat value, use PixelFormat
+		[MarshalAs(UnmanagedType.ByValTStr, SizeConst = MaxNameLength)]
+		public string		FormatName;
+	};
+
+	//	matches PopCameraDevice_FrameInfo
+	[StructLayout(LayoutKind.Sequential, CharSet = CharSet.Ansi)]
+	public struct FrameInfo
+	{
+		public UInt32		StructSize;
+		public UInt32		Version;
+		public UInt64		FrameNumber;
+		public UInt64		HostTimeNs;
+		public UInt64		DeviceTimeNs;
+		public Int32		FrameTime;
+		public Int32		PlaneCount;
+		[MarshalAs(UnmanagedType.ByValArray, SizeConst = MaxPlanes)]
+		public PlaneInfo[]	Planes;
+		[MarshalAs(UnmanagedType.ByValTStr, SizeConst = MaxNameLength)]
+		public string		StreamName;
+		public Int32		RoiX;		//	area of the image the planes were cropped to, all 0 if not cropped
+		public Int32		RoiY;
+		public Int32		RoiWidth;
+		public Int32		RoiHeight;
+	};
+	const int MaxPlanes = 4;
+	const int MaxNameLength = 32;
+
 	[System.Serializable]
 	public struct DeviceMeta
 	{
@@ -121,6 +170,11 @@ public static class PopCameraDevice
 		public string	DepthFormat = "Depth16mm";	//	see Pop.PixelFormat
 		public bool		Debug = false;
 		public bool		SplitPlanes = true;
+		public string	QueuePolicy = "DropOldest";	//	DropOldest, DropNewest, LatestOnly, BlockProducer
+		public int		MaxFrameBuffers = 13;
+		public int		QueueTimeoutMs = 1000;	//	BlockProducer only
+		public long		MaxFrameBytes = 0;	//	0 = unlimited
+		public bool		AsyncCallbacks = false;
 		
 		//	arkit
 		public bool		HdrColour = false;
@@ -146,7 +200,8 @@ public static class PopCameraDevice
 
 	public static List<DeviceMeta> EnumCameraDevices()
 	{
-		var JsonStringBuffer = new byte[1000];
+		var JsonSize = PopCameraDevice_EnumCameraDevicesJson(null, 0);
+		var JsonStringBuffer = new byte[Math.Max(JsonSize,1)];
 		PopCameraDevice_EnumCameraDevicesJson(JsonStringBuffer, JsonStringBuffer.Length );
 		var JsonString = GetString(JsonStringBuffer);
 		var Metas = JsonUtility.FromJson<DeviceMetas>(JsonString);
@@ -243,18 +298,17 @@ public static class PopCameraDevice
 		//	returns value if we changed the texture[s]
 		public int? GetNextFrame(ref List<Texture2D> Planes,ref List<PixelFormat> PixelFormats)
 		{
-			var JsonBuffer = new Byte[1000];
-			var NextFrameTime = PopCameraDevice_PeekNextFrame( Instance.Value, JsonBuffer, JsonBuffer.Length );
+			//	fixed struct rather than parsing json every frame
+			var Info = new FrameInfo();
+			Info.StructSize = (UInt32)Marshal.SizeOf(typeof(FrameInfo));
+			Info.Planes = new PlaneInfo[MaxPlanes];
+			var NextFrameTime = PopCameraDevice_PeekNextFrameInfo( Instance.Value, ref Info );
 			
 			//	no frame pending
 			if (NextFrameTime < 0)
 				return null;
 
-			var Json = GetString(JsonBuffer);
-			//Debug.Log("PopCameraDevice_PeekNextFrame:" + Json);
-			var Meta = JsonUtility.FromJson<FrameMeta>(Json);
-
-			var PlaneCount = Meta.Planes.Count;
+			var PlaneCount = Info.PlaneCount;
 			//	throw here? should there ALWAYS be a plane?
 			if (PlaneCount <= 0)
 				throw new System.Exception("Not expecting zero planes");
@@ -265,7 +319,7 @@ public static class PopCameraDevice
 
 			for (var p = 0; p < PlaneCount; p++)
 			{
-				var PlaneMeta = Meta.Planes[p];
+				var PlaneMeta = Info.Planes[p];
 				PixelFormats[p] = PlaneMeta.PixelFormat;
 				//	alloc textures so we have data to write to
 				var OldTexture = Planes[p];
@@ -304,6 +358,18 @@ public static class PopCameraDevice
 			return NextFrameTime;
 		}
 
+		//	performance counters (fps, latency, drops etc) as json
+		public string GetStatsJson()
+		{
+			var Size = PopCameraDevice_GetStatsJson( Instance.Value, null, 0 );
+			if ( Size < 0 )
+				throw new System.Exception("PopCameraDevice_GetStatsJson failed");
+			//	counters may grow between the calls
+			var JsonBuffer = new byte[Size + 256];
+			PopCameraDevice_GetStatsJson( Instance.Value, JsonBuffer, JsonBuffer.Length );
+			return GetString(JsonBuffer);
+		}
+
 		//	todo: be more strict c# side!
 		public void ReadNativeHandle(System.IntPtr Handle)
 		{